@@ -0,0 +1,191 @@
+#ifndef AUTO_EXPOSURE_H
+#define AUTO_EXPOSURE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/render_graph.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Exposure that follows the average brightness of the HDR frame.
+// The frame's log luminance is written to a SIZE x SIZE target and glGenerateMipmap averages it down to the
+// 1x1 mip, which is the log of the geometric mean luminance. That single texel is copied into one of FRAMES pixel
+// buffers and fenced; the value is read a couple of frames later, only once its fence has signaled, so the frame
+// never waits on the GPU. Exposure() then adapts to key / mean luminance with an exponential falloff.
+class AutoExposure
+{
+public:
+    static const int SIZE = 256;
+    static const int LEVELS = 9;
+    static const int FRAMES = 3;
+
+    // the mean luminance is mapped to this value before tone mapping
+    float key = 0.5f;
+    // how fast the exposure follows, per second
+    float speed = 1.5f;
+    float minExposure = 0.05f, maxExposure = 20.0f;
+
+    AutoExposure() : luminanceShader("resources/shaders/fullscreen.vs", "resources/shaders/luminance.fs")
+    {
+        glGenTextures(1, &luminance);
+        glBindTexture(GL_TEXTURE_2D, luminance);
+        for (int level = 0, size = SIZE; level < LEVELS; level++, size /= 2)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R16F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVELS - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, luminance, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Luminance framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(FRAMES, readback);
+        for (int i = 0; i < FRAMES; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glGenVertexArrays(1, &emptyVAO);
+
+        luminanceShader.use();
+        luminanceShader.setInt("source", 0);
+        luminanceShader.setVec2("footprint", glm::vec2(1.0f / SIZE));
+    }
+
+    ~AutoExposure()
+    {
+        for (GLsync &fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+        glDeleteBuffers(FRAMES, readback);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &luminance);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    AutoExposure(const AutoExposure &) = delete;
+    AutoExposure &operator=(const AutoExposure &) = delete;
+
+    // adapts the exposure to the newest finished readback, then declares the pass that reduces `hdrColor` and
+    // queues its readback; the readback is a side effect, so the pass always runs
+    void AddPass(RenderGraph &graph, RenderGraph::Resource hdrColor, float deltaTime)
+    {
+        collect();
+        if (measured) {
+            float target = glm::clamp(key / std::max(averageLuminance, 1e-4f), minExposure, maxExposure);
+            // adapt in log space, so brightening and darkening take the same time
+            float blend = 1.0f - std::exp(-deltaTime * speed);
+            exposure = std::exp(glm::mix(std::log(exposure), std::log(target), blend));
+        }
+
+        graph.AddPass("Ekspozicija", { hdrColor }, {}, [this, &graph, hdrColor]() {
+            GLint polygonMode[2];
+            glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glBindVertexArray(emptyVAO);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, SIZE, SIZE);
+            luminanceShader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(hdrColor));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            glBindTexture(GL_TEXTURE_2D, luminance);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            // a slot whose fence hasn't signaled in FRAMES frames is skipped rather than waited for
+            int slot = frame % FRAMES;
+            if (!fences[slot]) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[slot]);
+                glGetTexImage(GL_TEXTURE_2D, LEVELS - 1, GL_RED, GL_FLOAT, nullptr);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                issued[slot] = frame;
+            } else {
+                skipped++;
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+            frame++;
+
+            glBindVertexArray(0);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+            glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        }, true);
+    }
+
+    float Exposure() const
+    {
+        return exposure;
+    }
+
+    // geometric mean luminance of the frame the exposure adapts to, Latency() frames old
+    float AverageLuminance() const
+    {
+        return averageLuminance;
+    }
+
+    int Latency() const
+    {
+        return latency;
+    }
+
+    // readbacks dropped because the GPU was more than FRAMES frames behind
+    int Skipped() const
+    {
+        return skipped;
+    }
+
+private:
+    Shader luminanceShader;
+    unsigned int luminance = 0, fbo = 0, emptyVAO = 0;
+    unsigned int readback[FRAMES] = {};
+    GLsync fences[FRAMES] = {};
+    int issued[FRAMES] = {};
+    int frame = 0, latency = 0, skipped = 0;
+    bool measured = false;
+    float averageLuminance = 1.0f;
+    float exposure = 1.0f;
+
+    // reads every finished readback, oldest first, without waiting for the unfinished ones
+    void collect()
+    {
+        for (int i = 0; i < FRAMES; i++) {
+            int slot = (frame + i) % FRAMES;
+            if (!fences[slot])
+                continue;
+            GLenum status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue;
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[slot]);
+            const float *logLuminance = (const float *) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float),
+                                                                          GL_MAP_READ_BIT);
+            if (logLuminance) {
+                if (std::isfinite(*logLuminance)) {
+                    averageLuminance = std::exp(*logLuminance);
+                    measured = true;
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            latency = frame - issued[slot];
+        }
+    }
+};
+
+#endif
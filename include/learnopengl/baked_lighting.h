@@ -0,0 +1,63 @@
+#ifndef BAKED_LIGHTING_H
+#define BAKED_LIGHTING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// bundled skyboxes in resources/textures/skybox, ProgramState::skybox indexes them
+static const char *SKYBOXES[] = { "space2", "voda", "voda2" };
+static const int SKYBOX_COUNT = 3;
+
+// The lighting a lightmap holds: the directional light (the sun) and the skybox the sky light comes from.
+// The baker takes it from resources/program_state.txt, LightmapFile keeps it, and Lightmap::Matches() only accepts
+// the bake while the renderer lights the scene the same way.
+struct BakedLighting {
+    glm::vec3 sunDirection = glm::vec3(-0.2f, -1.0f, -0.3f);
+    // diffuse of the directional light, black when it is off
+    glm::vec3 sunColor = glm::vec3(0.5f);
+    // ambient of the directional light, the sky light when the skybox has no cached harmonics
+    glm::vec3 flatAmbient = glm::vec3(0.2f);
+    std::string skybox = SKYBOXES[0];
+
+    // the same light up to the precision program_state.txt is written with
+    bool Same(const BakedLighting &other) const
+    {
+        return glm::dot(glm::normalize(sunDirection), glm::normalize(other.sunDirection)) > 0.9999f
+               && glm::length(sunColor - other.sunColor) < 1e-3f && glm::length(flatAmbient - other.flatAmbient) < 1e-3f
+               && skybox == other.skybox;
+    }
+
+    // ProgramState::SaveToFile() writes one value a line in a fixed order and only ever appends new settings, so
+    // the directional light and the skybox stay at these positions. Settings the file is too old to have keep
+    // their defaults, like ProgramState::LoadFromFile() does; false without a file.
+    bool ReadProgramState(const std::string &path)
+    {
+        const size_t DIRECTION = 15, AMBIENT = 18, DIFFUSE = 21, DIR_LIGHT_ENABLED = 46, SKYBOX = 48;
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::vector<float> values;
+        float value;
+        while (values.size() <= SKYBOX && in >> value)
+            values.push_back(value);
+
+        auto vec3At = [&](size_t index, const glm::vec3 &fallback) {
+            return index + 2 < values.size() ? glm::vec3(values[index], values[index + 1], values[index + 2])
+                                             : fallback;
+        };
+        sunDirection = vec3At(DIRECTION, sunDirection);
+        flatAmbient = vec3At(AMBIENT, flatAmbient);
+        sunColor = vec3At(DIFFUSE, sunColor);
+        if (DIR_LIGHT_ENABLED < values.size() && values[DIR_LIGHT_ENABLED] == 0.0f)
+            sunColor = glm::vec3(0.0f);
+        if (SKYBOX < values.size())
+            skybox = SKYBOXES[std::max(0, std::min((int) values[SKYBOX], SKYBOX_COUNT - 1))];
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/render_graph.h>
+#include <learnopengl/target_format.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Progressive downsample/upsample bloom over a chain of half, quarter, ... resolution targets.
+// The bright pass writes level 0 straight from the HDR scene color: a 13-tap downsample with Karis weighted boxes
+// and a soft knee threshold, so the scene pass doesn't need a second color attachment. Each further level is
+// reduced with the same 13-tap filter (four overlapping 2x2 box samples, made from bilinear taps) and the chain
+// is then walked back up, each level adding a 3x3 tent filtered copy of the level below to itself. Level 0 ends
+// up holding the sum of all blur radii at half resolution; no pass touches a full resolution target.
+// The levels are RenderGraph transients, so they share the pool with the post chain intermediates.
+class Bloom
+{
+public:
+    static const int MAX_LEVELS = 6;
+
+    int levels = MAX_LEVELS;
+    // brightness where bloom starts, with a quadratic ramp over +-knee around it
+    float threshold = 1.0f;
+    float knee = 0.5f;
+    // tent radius of the upsample in texels of the level being read
+    float filterRadius = 1.0f;
+
+    Bloom(int width, int height)
+        : brightPassShader("resources/shaders/fullscreen.vs", "resources/shaders/bloomBrightPass.fs"),
+          downsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloomDownsample.fs"),
+          upsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloomUpsample.fs")
+    {
+        glGenVertexArrays(1, &emptyVAO);
+        Resize(width, height);
+
+        brightPassShader.use();
+        brightPassShader.setInt("source", 0);
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        upsampleShader.use();
+        upsampleShader.setInt("source", 0);
+    }
+
+    ~Bloom()
+    {
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    Bloom(const Bloom &) = delete;
+    Bloom &operator=(const Bloom &) = delete;
+
+    // the chain's color format
+    void SetFormat(const TargetFormat &newFormat)
+    {
+        format = &newFormat;
+    }
+
+    void Resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        for (int i = 0; i < MAX_LEVELS; i++)
+            sizes[i] = glm::ivec2(std::max(1, width >> (i + 1)), std::max(1, height >> (i + 1)));
+    }
+
+    // declares the passes that extract and blur the bright parts of `hdrColor` (full resolution) through the
+    // chain, the levels are graph transients; returns level 0, the result. Culled when nothing reads it.
+    RenderGraph::Resource AddPasses(RenderGraph &graph, RenderGraph::Resource hdrColor)
+    {
+        levels = std::max(1, std::min(levels, MAX_LEVELS));
+        RenderGraph::Resource chain[MAX_LEVELS];
+        for (int i = 0; i < levels; i++)
+            chain[i] = graph.Create("Bloom " + std::to_string(i), sizes[i].x, sizes[i].y, *format);
+
+        graph.AddPass("Bloom prag", { hdrColor }, { chain[0] }, [this, &graph, hdrColor, chain0 = chain[0]]() {
+            begin();
+            brightPassShader.use();
+            brightPassShader.setVec2("sourceTexel", glm::vec2(1.0f / width, 1.0f / height));
+            float softKnee = std::max(knee, 1e-4f);
+            brightPassShader.setFloat("threshold", threshold);
+            brightPassShader.setVec3("curve", glm::vec3(threshold - softKnee, 2.0f * softKnee, 0.25f / softKnee));
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(hdrColor));
+            draw(graph, chain0);
+            end();
+        });
+        if (levels == 1)
+            return chain[0];
+
+        std::vector<RenderGraph::Resource> upper(chain, chain + levels - 1), lower(chain + 1, chain + levels);
+        graph.AddPass("Bloom dole", upper, lower, [this, &graph, upper, lower]() {
+            begin();
+            downsampleShader.use();
+            for (size_t i = 0; i < lower.size(); i++) {
+                downsampleShader.setVec2("sourceTexel", glm::vec2(1.0f / sizes[i].x, 1.0f / sizes[i].y));
+                glBindTexture(GL_TEXTURE_2D, graph.Texture(upper[i]));
+                draw(graph, lower[i]);
+            }
+            end();
+        });
+
+        // blending reads every level it adds to as well
+        std::vector<RenderGraph::Resource> all(chain, chain + levels);
+        graph.AddPass("Bloom gore", all, upper, [this, &graph, upper, lower]() {
+            begin();
+            upsampleShader.use();
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            for (int i = (int) upper.size() - 1; i >= 0; i--) {
+                upsampleShader.setVec2("sourceTexel", filterRadius * glm::vec2(1.0f / sizes[i + 1].x,
+                                                                               1.0f / sizes[i + 1].y));
+                glBindTexture(GL_TEXTURE_2D, graph.Texture(lower[i]));
+                draw(graph, upper[i]);
+            }
+            glDisable(GL_BLEND);
+            end();
+        });
+        return chain[0];
+    }
+
+    // every level adds its energy once, the composite divides it back out
+    float Strength() const
+    {
+        return 1.0f / levels;
+    }
+
+    // estimated bytes the passes read and write, every access of a target counted once (texture caches take
+    // the overlapping taps); sceneBytes is the size of the HDR color the bright pass reads
+    size_t Traffic(size_t sceneBytes) const
+    {
+        size_t bytes = sceneBytes;
+        for (int i = 0; i < levels; i++) {
+            size_t level = (size_t) sizes[i].x * sizes[i].y * format->bytesPerPixel;
+            // written going down, read by the next level down
+            bytes += level * (i + 1 < levels ? 2 : 1);
+            // read by the level above on the way up, and blended into (read and written) itself
+            if (i > 0)
+                bytes += level;
+            if (i + 1 < levels)
+                bytes += 2 * level;
+        }
+        return bytes;
+    }
+
+    // bytes of the levels in use, before the graph aliases them
+    size_t Bytes() const
+    {
+        size_t bytes = 0;
+        for (int i = 0; i < levels; i++)
+            bytes += (size_t) sizes[i].x * sizes[i].y * format->bytesPerPixel;
+        return bytes;
+    }
+
+private:
+    Shader brightPassShader, downsampleShader, upsampleShader;
+    glm::ivec2 sizes[MAX_LEVELS];
+    const TargetFormat *format = &TargetFormat::Get(TargetFormat::RGBA16F);
+    unsigned int emptyVAO = 0;
+    int width = 0, height = 0;
+
+    GLint polygonMode[2] = { GL_FILL, GL_FILL };
+
+    void begin()
+    {
+        glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void end()
+    {
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+    }
+
+    static void draw(const RenderGraph &graph, RenderGraph::Resource level)
+    {
+        graph.BindTarget(level);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+};
+
+#endif
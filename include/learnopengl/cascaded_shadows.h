@@ -0,0 +1,332 @@
+#ifndef CASCADED_SHADOWS_H
+#define CASCADED_SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "imgui.h"
+
+#include <learnopengl/shader.h>
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/static_scene.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Cascaded shadow maps of the directional light with cached static cascades.
+// Every cascade covers a slice of the view frustum through the slice's bounding sphere, but its map is rendered
+// with some padding around the sphere and kept while the sphere stays inside: the static geometry is only drawn
+// again when the light turns, the static objects move, or the camera leaves the padded area of that cascade (near
+// cascades move out sooner than far ones). Moving casters (the trees) go into a smaller dynamic map of the first
+// DYNAMIC_CASCADES cascades that is redrawn every frame with the same matrices, the lighting shaders take the
+// darker of both; far moving casters can go in as impostors facing the light. Rendering uses depth clamping, so casters outside the light's depth range still cast.
+class CascadedShadows
+{
+public:
+    static const int CASCADES = 3;
+    static const int DYNAMIC_CASCADES = 2;
+    static const int STATIC_SIZE = 2048;
+    static const int DYNAMIC_SIZE = 1024;
+    static const int STATIC_UNIT = 14;
+    static const int DYNAMIC_UNIT = 15;
+
+    float shadowDistance = 80.0f;
+    // blend between uniform (0) and logarithmic (1) cascade splits
+    float splitLambda = 0.75f;
+    // extra map around a cascade's sphere, relative to its radius: how far the camera moves before a re-render
+    float cachePadding = 0.5f;
+    // off re-renders every static cascade every frame, for comparison
+    bool caching = true;
+
+    Shader casterShader;
+    Shader instancedCasterShader;
+    Shader impostorCasterShader;
+
+    CascadedShadows()
+        : casterShader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs"),
+          instancedCasterShader("resources/shaders/shadowInstanced.vs", "resources/shaders/depthPrepass.fs"),
+          impostorCasterShader("resources/shaders/impostor.vs", "resources/shaders/impostorShadow.fs", nullptr,
+                               { "SHADOW_CASTER" })
+    {
+        staticMaps = createArray(STATIC_SIZE);
+        dynamicMaps = createArray(DYNAMIC_SIZE);
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~CascadedShadows()
+    {
+        glDeleteTextures(1, &staticMaps);
+        glDeleteTextures(1, &dynamicMaps);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    // world space bounds of everything that casts, the light's depth range is fitted to them
+    void SetSceneBounds(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        if (boundsMin != sceneMin || boundsMax != sceneMax)
+            invalidateAll();
+        sceneMin = boundsMin;
+        sceneMax = boundsMax;
+    }
+
+    // places the cascades for this frame's camera and marks the static ones that have to be redrawn
+    void Update(const glm::vec3 &cameraPosition, const glm::vec3 &cameraFront, float fovY, float aspect,
+                float cameraNear, const glm::vec3 &lightDirection, const std::vector<StaticObject> &objects)
+    {
+        glm::vec3 direction = glm::normalize(lightDirection);
+        if (direction != cachedDirection) {
+            cachedDirection = direction;
+            glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+            invalidateAll();
+        }
+        if (!sameObjects(objects)) {
+            cachedObjects = objects;
+            invalidateAll();
+        }
+
+        // depth range of the scene along the light
+        float minZ = 1e30f, maxZ = -1e30f;
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner((i & 1) ? sceneMax.x : sceneMin.x, (i & 2) ? sceneMax.y : sceneMin.y,
+                             (i & 4) ? sceneMax.z : sceneMin.z);
+            float z = (lightView * glm::vec4(corner, 1.0f)).z;
+            minZ = std::min(minZ, z);
+            maxZ = std::max(maxZ, z);
+        }
+
+        float tanHalfFov = std::tan(fovY * 0.5f);
+        float k2 = tanHalfFov * tanHalfFov * (1.0f + aspect * aspect);
+        float sliceNear = cameraNear;
+        for (int i = 0; i < CASCADES; i++) {
+            Cascade &cascade = cascades[i];
+            float t = (float) (i + 1) / CASCADES;
+            float logarithmic = cameraNear * std::pow(shadowDistance / cameraNear, t);
+            float uniform = cameraNear + (shadowDistance - cameraNear) * t;
+            float sliceFar = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+            cascade.splitFar = sliceFar;
+
+            // smallest sphere around the slice, it doesn't change when the camera turns
+            float centerDistance = std::min(sliceFar, 0.5f * (sliceNear + sliceFar) * (1.0f + k2));
+            float radius = std::sqrt((sliceFar - centerDistance) * (sliceFar - centerDistance) + sliceFar * sliceFar * k2);
+            glm::vec3 center = glm::vec3(lightView * glm::vec4(cameraPosition + cameraFront * centerDistance, 1.0f));
+            sliceNear = sliceFar;
+
+            float reach = cascade.extent - radius;
+            bool inside = cascade.valid && reach >= 0.0f && std::abs(center.x - cascade.center.x) <= reach
+                          && std::abs(center.y - cascade.center.y) <= reach;
+            // a much larger map than needed wastes resolution (e.g. after zooming in)
+            bool tooLarge = cascade.extent > radius * (1.0f + cachePadding) * 1.5f;
+            if (inside && !tooLarge && caching)
+                continue;
+
+            cascade.extent = radius * (1.0f + cachePadding);
+            // texel aligned so a re-centered map rasterizes the same edges
+            float texel = 2.0f * cascade.extent / STATIC_SIZE;
+            cascade.center = glm::vec2(std::floor(center.x / texel) * texel, std::floor(center.y / texel) * texel);
+            // the view looks down -z, so the nearest geometry has the largest z
+            glm::mat4 projection = glm::ortho(cascade.center.x - cascade.extent, cascade.center.x + cascade.extent,
+                                              cascade.center.y - cascade.extent, cascade.center.y + cascade.extent,
+                                              -maxZ - 1.0f, -minZ + 1.0f);
+            cascade.lightSpace = projection * lightView;
+            cascade.texelSize = texel;
+            cascade.valid = true;
+            cascade.dirty = true;
+        }
+    }
+
+    // redraws the static cascades marked by Update(), drawStatic(shader) draws the static geometry depth only
+    template<typename DrawStatic>
+    void RenderStatic(GpuProfiler &profiler, DrawStatic drawStatic)
+    {
+        for (int i = 0; i < CASCADES; i++) {
+            Cascade &cascade = cascades[i];
+            if (!cascade.dirty)
+                continue;
+            std::string scope = "Senke staticke k" + std::to_string(i);
+            profiler.Begin(scope);
+            beginCascade(staticMaps, i, STATIC_SIZE);
+            casterShader.use();
+            casterShader.setMat4("projection", cascade.lightSpace);
+            casterShader.setMat4("view", glm::mat4(1.0f));
+            drawStatic(casterShader);
+            endCascade();
+            profiler.End();
+            cascade.dirty = false;
+            cascade.updates++;
+        }
+        frames++;
+    }
+
+    // light volume of the dynamic cascades, for culling the dynamic casters before RenderDynamic()
+    Frustum DynamicFrustum() const
+    {
+        glm::vec2 low(1e30f), high(-1e30f);
+        for (int i = 0; i < DYNAMIC_CASCADES; i++) {
+            low = glm::min(low, cascades[i].center - glm::vec2(cascades[i].extent));
+            high = glm::max(high, cascades[i].center + glm::vec2(cascades[i].extent));
+        }
+        // an unbounded depth range, the maps are rendered with depth clamping
+        return Frustum(glm::ortho(low.x, high.x, low.y, high.y, -1e4f, 1e4f) * lightView);
+    }
+
+    // redraws the dynamic maps, drawDynamic(shader) draws the moving casters depth only, drawImpostors(shader) the
+    // far ones through Impostor::Draw()
+    template<typename DrawDynamic, typename DrawImpostors>
+    void RenderDynamic(GpuProfiler &profiler, DrawDynamic drawDynamic, DrawImpostors drawImpostors)
+    {
+        profiler.Begin("Senke dinamicke");
+        for (int i = 0; i < DYNAMIC_CASCADES; i++) {
+            beginCascade(dynamicMaps, i, DYNAMIC_SIZE);
+            instancedCasterShader.use();
+            instancedCasterShader.setMat4("projection", cascades[i].lightSpace);
+            instancedCasterShader.setMat4("view", glm::mat4(1.0f));
+            drawDynamic(instancedCasterShader);
+            impostorCasterShader.use();
+            impostorCasterShader.setMat4("projection", cascades[i].lightSpace);
+            impostorCasterShader.setMat4("view", glm::mat4(1.0f));
+            impostorCasterShader.setVec3("lightDirection", cachedDirection);
+            drawImpostors(impostorCasterShader);
+            endCascade();
+        }
+        profiler.End();
+    }
+
+    // maps and matrices for a lighting shader with the SHADOWS define
+    void Bind(Shader &shader, const glm::vec3 &cameraFront) const
+    {
+        shader.setInt("shadowStatic", STATIC_UNIT);
+        shader.setInt("shadowDynamic", DYNAMIC_UNIT);
+        glm::vec3 splits, normalOffsets;
+        for (int i = 0; i < CASCADES; i++) {
+            shader.setMat4("lightSpace[" + std::to_string(i) + "]", cascades[i].lightSpace);
+            splits[i] = cascades[i].splitFar;
+            // about one texel along the normal keeps acne away without visible peter panning
+            normalOffsets[i] = cascades[i].texelSize * 1.5f;
+        }
+        shader.setVec3("cascadeSplits", splits);
+        shader.setVec3("normalOffsets", normalOffsets);
+        shader.setVec3("cameraForward", cameraFront);
+        shader.setInt("dynamicCascades", DYNAMIC_CASCADES);
+        shader.setVec2("shadowTexel", glm::vec2(1.0f / STATIC_SIZE, 1.0f / DYNAMIC_SIZE));
+        glActiveTexture(GL_TEXTURE0 + STATIC_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, staticMaps);
+        glActiveTexture(GL_TEXTURE0 + DYNAMIC_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, dynamicMaps);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // update counts and the GPU time of each cascade's last redraw
+    void DrawImGui(const GpuProfiler &profiler) const
+    {
+        ImGui::Text("%-8s %8s %10s %10s %10s", "kaskada", "do [m]", "azuriranja", "po frejmu", "cena");
+        for (int i = 0; i < CASCADES; i++)
+            ImGui::Text("%-8d %8.1f %10d %9.1f%% %7.3f ms", i, cascades[i].splitFar, cascades[i].updates,
+                        frames ? 100.0f * cascades[i].updates / frames : 0.0f,
+                        profiler.LastMilliseconds("Senke staticke k" + std::to_string(i)));
+        ImGui::Text("dinamicke (%d kaskade, %dpx): %.3f ms", DYNAMIC_CASCADES, DYNAMIC_SIZE,
+                    profiler.Milliseconds("Senke dinamicke"));
+        ImGui::Text("memorija: %.1f MB", (CASCADES * STATIC_SIZE * STATIC_SIZE * 4.0f
+                                          + DYNAMIC_CASCADES * DYNAMIC_SIZE * DYNAMIC_SIZE * 4.0f) / (1024.0f * 1024.0f));
+    }
+
+private:
+    struct Cascade {
+        glm::mat4 lightSpace = glm::mat4(1.0f);
+        // light space center and half size of the rendered map
+        glm::vec2 center = glm::vec2(0.0f);
+        float extent = 0.0f;
+        float texelSize = 0.0f;
+        float splitFar = 0.0f;
+        bool valid = false;
+        bool dirty = false;
+        int updates = 0;
+    };
+
+    Cascade cascades[CASCADES];
+    unsigned int staticMaps = 0, dynamicMaps = 0, fbo = 0;
+    glm::mat4 lightView = glm::mat4(1.0f);
+    glm::vec3 cachedDirection = glm::vec3(0.0f);
+    std::vector<StaticObject> cachedObjects;
+    glm::vec3 sceneMin = glm::vec3(-100.0f), sceneMax = glm::vec3(100.0f);
+    // for the share of frames each cascade was redrawn in
+    int frames = 0;
+    GLint previousViewport[4];
+    GLint polygonMode[2];
+    GLboolean cullingEnabled = GL_FALSE;
+
+    static unsigned int createArray(int size)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, size == STATIC_SIZE ? CASCADES : DYNAMIC_CASCADES,
+                     0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        // hardware compare + linear filtering gives 2x2 PCF per tap
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    void invalidateAll()
+    {
+        for (Cascade &cascade : cascades)
+            cascade.valid = false;
+    }
+
+    bool sameObjects(const std::vector<StaticObject> &objects) const
+    {
+        if (objects.size() != cachedObjects.size())
+            return false;
+        for (size_t i = 0; i < objects.size(); i++)
+            if (objects[i].model != cachedObjects[i].model || objects[i].transform != cachedObjects[i].transform)
+                return false;
+        return true;
+    }
+
+    void beginCascade(unsigned int maps, int layer, int size)
+    {
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        cullingEnabled = glIsEnabled(GL_CULL_FACE);
+        glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps, 0, layer);
+        glViewport(0, 0, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_DEPTH_CLAMP);
+        // the city isn't closed everywhere, both sides cast
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 4.0f);
+    }
+
+    void endCascade()
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glDisable(GL_DEPTH_CLAMP);
+        if (cullingEnabled)
+            glEnable(GL_CULL_FACE);
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+};
+
+#endif
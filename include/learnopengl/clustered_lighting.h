@@ -0,0 +1,396 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define CLUSTERED_LIGHTING_SSE
+#endif
+
+// Point light as the lighting shaders use it, the colors already include the light color.
+struct PointLightSource {
+    glm::vec3 position;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// Point lights in structure of arrays form, as LightStore keeps them.
+struct PointLightArrays {
+    size_t count = 0;
+    const float *x = nullptr, *y = nullptr, *z = nullptr;
+    const float *radius = nullptr;
+    // 3 per light: ambient + constant, diffuse + linear, specular + quadratic
+    const glm::vec4 *terms = nullptr;
+};
+
+// Clustered forward shading.
+// The view frustum is split into TILES_X x TILES_Y screen tiles and SLICES exponentially spaced depth slices.
+// Every frame Update() transforms the lights to view space, tests each light's influence sphere against the
+// view space AABB of every cluster its depth range touches (four lights per SSE test, depth slices spread
+// over a ThreadPool) and uploads three texture buffers: the lights, an (offset, count) pair per cluster and
+// the light indices those pairs point into. The fragment shader finds its cluster from gl_FragCoord and
+// only shades the lights listed there.
+// Objects registered with SetObjects() additionally get a list of the lights touching their world space bounds,
+// appended to the same index buffer. Both lists hold every light that can reach a fragment of the object, so
+// the shader walks whichever is shorter: small objects in busy clusters and far clusters (which grow with
+// depth) shade fewer lights.
+class ClusteredLighting
+{
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    static const int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    // the three buffers use units FIRST_TEXTURE_UNIT .. FIRST_TEXTURE_UNIT + 2, above the material textures
+    static const int FIRST_TEXTURE_UNIT = 10;
+
+    // a light reaches as far as its strongest channel stays above this
+    float lightThreshold = 2.0f / 256.0f;
+    // slice 0 covers everything up to here, spending slices on the first few centimetres is wasteful
+    float clusterNear = 1.0f;
+
+    // statistics of the last Update()
+    float assignMilliseconds = 0.0f;
+    unsigned int visibleLights = 0;
+    unsigned int indexCount = 0;
+    unsigned int maxLightsPerCluster = 0;
+    unsigned int objectIndexCount = 0;
+
+    explicit ClusteredLighting(ThreadPool &threadPool) : threadPool(threadPool)
+    {
+        glGenBuffers(1, &lightBuffer);
+        glGenBuffers(1, &gridBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glGenTextures(1, &lightTexture);
+        glGenTextures(1, &gridTexture);
+        glGenTextures(1, &indexTexture);
+        // texture buffers need storage before they can be attached
+        upload(lightBuffer, lightTexture, GL_RGBA32F, nullptr, 16);
+        upload(gridBuffer, gridTexture, GL_RG32UI, nullptr, 8);
+        upload(indexBuffer, indexTexture, GL_R32UI, nullptr, 4);
+        sliceLights.resize(SLICES);
+        sliceIndices.resize(SLICES);
+        sliceCounts.resize(SLICES);
+        sliceScratch.resize(SLICES);
+    }
+
+    ~ClusteredLighting()
+    {
+        unsigned int buffers[3] = { lightBuffer, gridBuffer, indexBuffer };
+        unsigned int textures[3] = { lightTexture, gridTexture, indexTexture };
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+    }
+
+    // distance at which the light's strongest channel drops below threshold
+    static float InfluenceRadius(const PointLightSource &light, float threshold)
+    {
+        glm::vec3 strongest = glm::max(light.diffuse, light.specular);
+        float intensity = std::max(strongest.x, std::max(strongest.y, strongest.z));
+        float k = intensity / threshold;
+        if (k <= light.constant)
+            return 0.0f;
+        if (light.quadratic > 0.0f) {
+            float c = light.constant - k;
+            return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+        }
+        if (light.linear > 0.0f)
+            return (k - light.constant) / light.linear;
+        return std::numeric_limits<float>::max();
+    }
+
+    // world space bounds of the objects that get their own light lists in the next Update(), see BindObject()
+    void SetObjects(const std::vector<glm::vec3> &boundsMin, const std::vector<glm::vec3> &boundsMax)
+    {
+        objectMin = boundsMin;
+        objectMax = boundsMax;
+    }
+
+    // assigns the lights to clusters for a perspective camera and uploads the result
+    void Update(const PointLightArrays &lights, const glm::mat4 &view, float fovY, float aspect,
+                float cameraNear, float cameraFar, int width, int height)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        setupClusters(fovY, aspect, cameraNear, cameraFar, width, height);
+
+        // view space (x, y, depth) and radius of every light, bucketed by the slices it touches
+        viewLights.clear();
+        lightData.clear();
+        for (std::vector<uint32_t> &bucket : sliceLights)
+            bucket.clear();
+        for (size_t i = 0; i < lights.count; i++) {
+            float radius = std::min(lights.radius[i], cameraFar);
+            if (radius <= 0.0f)
+                continue;
+            glm::vec3 position(lights.x[i], lights.y[i], lights.z[i]);
+            glm::vec4 viewPosition = view * glm::vec4(position, 1.0f);
+            float depth = -viewPosition.z;
+            if (depth + radius < cameraNear || depth - radius > cameraFar)
+                continue;
+
+            uint32_t index = viewLights.size();
+            viewLights.push_back(glm::vec4(viewPosition.x, viewPosition.y, depth, radius));
+            int firstSlice = slice(depth - radius), lastSlice = slice(depth + radius);
+            for (int s = firstSlice; s <= lastSlice; s++)
+                sliceLights[s].push_back(index);
+
+            lightData.push_back(glm::vec4(position, radius));
+            lightData.insert(lightData.end(), lights.terms + i * 3, lights.terms + i * 3 + 3);
+        }
+        visibleLights = viewLights.size();
+
+        threadPool.ParallelFor(SLICES, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int s = begin; s < end; s++)
+                assignSlice(s);
+        });
+
+        // concatenate the per slice lists into one index buffer
+        grid.resize(CLUSTER_COUNT * 2);
+        indices.clear();
+        maxLightsPerCluster = 0;
+        for (int s = 0; s < SLICES; s++) {
+            uint32_t sliceOffset = indices.size();
+            uint32_t clusterOffset = 0;
+            for (int t = 0; t < TILES_X * TILES_Y; t++) {
+                uint32_t count = sliceCounts[s][t];
+                int cluster = s * TILES_X * TILES_Y + t;
+                grid[cluster * 2] = sliceOffset + clusterOffset;
+                grid[cluster * 2 + 1] = count;
+                clusterOffset += count;
+                maxLightsPerCluster = std::max(maxLightsPerCluster, count);
+            }
+            indices.insert(indices.end(), sliceIndices[s].begin(), sliceIndices[s].end());
+        }
+        indexCount = indices.size();
+
+        // per object lists after the cluster lists, tested in world space against the objects' boxes
+        objectLists.resize(objectMin.size() * 2);
+        for (size_t o = 0; o < objectMin.size(); o++) {
+            uint32_t offset = indices.size();
+            for (size_t i = 0; i < viewLights.size(); i++) {
+                const glm::vec4 &light = lightData[i * 4];
+                glm::vec3 outside = glm::max(glm::max(objectMin[o] - glm::vec3(light), glm::vec3(light) - objectMax[o]),
+                                             glm::vec3(0.0f));
+                if (glm::dot(outside, outside) <= light.w * light.w)
+                    indices.push_back(i);
+            }
+            objectLists[o * 2] = offset;
+            objectLists[o * 2 + 1] = indices.size() - offset;
+        }
+        objectIndexCount = indices.size() - indexCount;
+
+        upload(lightBuffer, lightTexture, GL_RGBA32F, lightData.empty() ? nullptr : &lightData[0],
+               std::max<size_t>(16, lightData.size() * sizeof(glm::vec4)));
+        upload(gridBuffer, gridTexture, GL_RG32UI, &grid[0], grid.size() * sizeof(uint32_t));
+        upload(indexBuffer, indexTexture, GL_R32UI, indices.empty() ? nullptr : &indices[0],
+               std::max<size_t>(4, indices.size() * sizeof(uint32_t)));
+
+        auto end = std::chrono::high_resolution_clock::now();
+        assignMilliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+    // binds the buffers and sets the cluster uniforms on an active shader
+    void Bind(Shader &shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + FIRST_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        glActiveTexture(GL_TEXTURE0 + FIRST_TEXTURE_UNIT + 1);
+        glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+        glActiveTexture(GL_TEXTURE0 + FIRST_TEXTURE_UNIT + 2);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setInt("lightData", FIRST_TEXTURE_UNIT);
+        shader.setInt("clusterGrid", FIRST_TEXTURE_UNIT + 1);
+        shader.setInt("lightIndices", FIRST_TEXTURE_UNIT + 2);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterDims"), TILES_X, TILES_Y, SLICES);
+        shader.setVec2("clusterTileSize", tileSize);
+        shader.setFloat("clusterNear", sliceNear);
+        shader.setFloat("clusterSliceScale", sliceScale);
+        shader.setFloat("cameraNear", params[2]);
+        shader.setFloat("cameraFar", params[3]);
+        // no object list until BindObject(), the cluster list is always shorter
+        glUniform2ui(glGetUniformLocation(shader.ID, "objectLights"), 0, std::numeric_limits<uint32_t>::max());
+    }
+
+    // selects the light list of registered object `index` for the next draws with the active shader
+    void BindObject(Shader &shader, size_t index) const
+    {
+        if (index * 2 + 1 >= objectLists.size())
+            return;
+        glUniform2ui(glGetUniformLocation(shader.ID, "objectLights"), objectLists[index * 2], objectLists[index * 2 + 1]);
+    }
+
+    // number of lights in object `index`'s list
+    unsigned int ObjectLightCount(size_t index) const
+    {
+        return index * 2 + 1 < objectLists.size() ? objectLists[index * 2 + 1] : 0;
+    }
+
+private:
+    ThreadPool &threadPool;
+
+    unsigned int lightBuffer = 0, gridBuffer = 0, indexBuffer = 0;
+    unsigned int lightTexture = 0, gridTexture = 0, indexTexture = 0;
+
+    // fovY, aspect, near, far, width, height the cluster bounds were built for
+    float params[6] = {};
+    glm::vec2 tileSize;
+    float sliceNear = 1.0f, sliceScale = 1.0f;
+    // view space bounds (x, y, depth) of every cluster, slice major
+    std::vector<glm::vec3> clusterMin, clusterMax;
+
+    std::vector<glm::vec4> viewLights; // x, y, depth, radius
+    std::vector<glm::vec4> lightData;
+    std::vector<std::vector<uint32_t>> sliceLights;
+    std::vector<std::vector<uint32_t>> sliceIndices;
+    std::vector<std::vector<uint32_t>> sliceCounts;
+    // x, y, depth and squared radius of a slice's lights, one array after the other
+    std::vector<std::vector<float>> sliceScratch;
+    std::vector<uint32_t> grid, indices;
+    // world space boxes from SetObjects() and their (offset, count) into indices
+    std::vector<glm::vec3> objectMin, objectMax;
+    std::vector<uint32_t> objectLists;
+
+    int slice(float depth) const
+    {
+        if (depth <= sliceNear)
+            return 0;
+        return std::min(SLICES - 1, (int)(std::log(depth / sliceNear) * sliceScale));
+    }
+
+    void setupClusters(float fovY, float aspect, float cameraNear, float cameraFar, int width, int height)
+    {
+        float current[6] = { fovY, aspect, cameraNear, cameraFar, (float)width, (float)height };
+        if (std::equal(current, current + 6, params) && !clusterMin.empty())
+            return;
+        std::copy(current, current + 6, params);
+
+        sliceNear = std::max(clusterNear, cameraNear);
+        sliceScale = SLICES / std::log(cameraFar / sliceNear);
+        tileSize = glm::vec2(std::ceil(width / (float)TILES_X), std::ceil(height / (float)TILES_Y));
+
+        float tanY = std::tan(fovY * 0.5f);
+        float tanX = tanY * aspect;
+        clusterMin.resize(CLUSTER_COUNT);
+        clusterMax.resize(CLUSTER_COUNT);
+        for (int s = 0; s < SLICES; s++) {
+            float near = s == 0 ? cameraNear : sliceNear * std::exp(s / sliceScale);
+            float far = s == SLICES - 1 ? cameraFar : sliceNear * std::exp((s + 1) / sliceScale);
+            for (int y = 0; y < TILES_Y; y++) {
+                float y0 = (y * tileSize.y) / height * 2.0f - 1.0f;
+                float y1 = ((y + 1) * tileSize.y) / height * 2.0f - 1.0f;
+                for (int x = 0; x < TILES_X; x++) {
+                    float x0 = (x * tileSize.x) / width * 2.0f - 1.0f;
+                    float x1 = ((x + 1) * tileSize.x) / width * 2.0f - 1.0f;
+                    // the tile's side planes fan out with depth, so the box spans both end caps
+                    int cluster = (s * TILES_Y + y) * TILES_X + x;
+                    clusterMin[cluster] = glm::vec3(std::min(x0 * tanX * near, x0 * tanX * far),
+                                                    std::min(y0 * tanY * near, y0 * tanY * far), near);
+                    clusterMax[cluster] = glm::vec3(std::max(x1 * tanX * near, x1 * tanX * far),
+                                                    std::max(y1 * tanY * near, y1 * tanY * far), far);
+                }
+            }
+        }
+    }
+
+    // tests every tile of one slice against the lights touching the slice
+    void assignSlice(unsigned int s)
+    {
+        const std::vector<uint32_t> &candidates = sliceLights[s];
+        std::vector<uint32_t> &out = sliceIndices[s];
+        std::vector<uint32_t> &counts = sliceCounts[s];
+        out.clear();
+        counts.assign(TILES_X * TILES_Y, 0);
+        if (candidates.empty())
+            return;
+
+        // structure of arrays, padded to a multiple of 4 with lights that can't touch anything
+        size_t padded = (candidates.size() + 3) & ~(size_t)3;
+        std::vector<float> &scratch = sliceScratch[s];
+        scratch.resize(padded * 4);
+        float *x = &scratch[0], *y = x + padded, *d = y + padded, *r2 = d + padded;
+        for (size_t i = 0; i < padded; i++) {
+            if (i < candidates.size()) {
+                const glm::vec4 &light = viewLights[candidates[i]];
+                x[i] = light.x;
+                y[i] = light.y;
+                d[i] = light.z;
+                r2[i] = light.w * light.w;
+            } else {
+                x[i] = y[i] = d[i] = 0.0f;
+                r2[i] = -1.0f;
+            }
+        }
+
+        for (int t = 0; t < TILES_X * TILES_Y; t++) {
+            int cluster = s * TILES_X * TILES_Y + t;
+            const glm::vec3 &boxMin = clusterMin[cluster];
+            const glm::vec3 &boxMax = clusterMax[cluster];
+            uint32_t count = 0;
+#ifdef CLUSTERED_LIGHTING_SSE
+            __m128 zero = _mm_setzero_ps();
+            __m128 minX = _mm_set1_ps(boxMin.x), maxX = _mm_set1_ps(boxMax.x);
+            __m128 minY = _mm_set1_ps(boxMin.y), maxY = _mm_set1_ps(boxMax.y);
+            __m128 minD = _mm_set1_ps(boxMin.z), maxD = _mm_set1_ps(boxMax.z);
+            for (size_t i = 0; i < padded; i += 4) {
+                // squared distance from each sphere center to the box
+                __m128 lx = _mm_loadu_ps(x + i), ly = _mm_loadu_ps(y + i), ld = _mm_loadu_ps(d + i);
+                __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, lx), _mm_sub_ps(lx, maxX)), zero);
+                __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, ly), _mm_sub_ps(ly, maxY)), zero);
+                __m128 dd = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minD, ld), _mm_sub_ps(ld, maxD)), zero);
+                __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dd, dd));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(distance2, _mm_loadu_ps(r2 + i)));
+                for (; mask; mask &= mask - 1) {
+                    out.push_back(candidates[i + __builtin_ctz(mask)]);
+                    count++;
+                }
+            }
+#else
+            for (size_t i = 0; i < candidates.size(); i++) {
+                float dx = std::max(std::max(boxMin.x - x[i], x[i] - boxMax.x), 0.0f);
+                float dy = std::max(std::max(boxMin.y - y[i], y[i] - boxMax.y), 0.0f);
+                float dd = std::max(std::max(boxMin.z - d[i], d[i] - boxMax.z), 0.0f);
+                if (dx * dx + dy * dy + dd * dd <= r2[i]) {
+                    out.push_back(candidates[i]);
+                    count++;
+                }
+            }
+#endif
+            counts[t] = count;
+        }
+    }
+
+    // replaces the buffer contents, orphaning the old storage so draws in flight keep theirs
+    static void upload(unsigned int buffer, unsigned int texture, GLenum format, const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        if (data)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef COLOR_GRADING_H
+#define COLOR_GRADING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Color grading through one 3D LUT applied after tone mapping (the ColorLut post stage).
+// A look is a table of display colors: the built-in ones are baked on the CPU from what used to be shader math,
+// others come from .cube files in resources/luts/. Bake() composes the selected look with the contrast/saturation
+// grade into a single size^3 texture, so any combination costs one trilinear fetch per pixel, and switching looks
+// only uploads a new table instead of compiling a shader.
+class ColorGrading
+{
+public:
+    struct Look {
+        std::string name;
+        int size;
+        // size^3 entries, red changing fastest (the .cube order)
+        std::vector<glm::vec3> table;
+        // input colors the table spans (.cube DOMAIN_MIN/DOMAIN_MAX), its entries are output colors as they are
+        glm::vec3 domainMin = glm::vec3(0.0f), domainMax = glm::vec3(1.0f);
+    };
+
+    ColorGrading()
+    {
+        looks.push_back(bake("Neutralni", 2, [](const glm::vec3 &color) { return color; }));
+        // the old "Ruzicasti" effect: luma tinted pink
+        looks.push_back(bake("Ruzicasti", 32, [](const glm::vec3 &color) {
+            float average = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+            return glm::vec3(1.0f, 0.43f, 0.78f) * average;
+        }));
+        glGenTextures(1, &texture);
+    }
+
+    ~ColorGrading()
+    {
+        glDeleteTextures(1, &texture);
+    }
+
+    // adds every .cube file of a directory as a look
+    void LoadDirectory(const std::string &directory)
+    {
+        DIR *dir = opendir(directory.c_str());
+        if (!dir)
+            return;
+        std::vector<std::string> files;
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 5 && name.substr(name.size() - 5) == ".cube")
+                files.push_back(name);
+        }
+        closedir(dir);
+        std::sort(files.begin(), files.end());
+        for (const std::string &file : files) {
+            Look look;
+            if (LoadCube(directory + "/" + file, look))
+                looks.push_back(look);
+        }
+    }
+
+    // a 3D .cube file (Adobe/Resolve): LUT_3D_SIZE, optional DOMAIN_MIN/DOMAIN_MAX, then size^3 "r g b" lines
+    static bool LoadCube(const std::string &path, Look &look)
+    {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "ColorGrading: can't open " << path << std::endl;
+            return false;
+        }
+        look.name = path.substr(path.find_last_of('/') + 1);
+        look.name = look.name.substr(0, look.name.size() - 5);
+        look.size = 0;
+        look.table.clear();
+        look.domainMin = glm::vec3(0.0f);
+        look.domainMax = glm::vec3(1.0f);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string first;
+            if (!(fields >> first) || first[0] == '#' || first == "TITLE")
+                continue;
+            if (first == "LUT_3D_SIZE") {
+                fields >> look.size;
+            } else if (first == "DOMAIN_MIN") {
+                fields >> look.domainMin.x >> look.domainMin.y >> look.domainMin.z;
+            } else if (first == "DOMAIN_MAX") {
+                fields >> look.domainMax.x >> look.domainMax.y >> look.domainMax.z;
+            } else if (first == "LUT_1D_SIZE") {
+                std::cout << "ColorGrading: " << path << " is a 1D LUT" << std::endl;
+                return false;
+            } else {
+                glm::vec3 value;
+                std::istringstream numbers(line);
+                if (!(numbers >> value.x >> value.y >> value.z)) {
+                    std::cout << "ColorGrading: " << path << " can't read '" << line << "'" << std::endl;
+                    return false;
+                }
+                look.table.push_back(value);
+            }
+        }
+        if (look.size < 2 || look.table.size() != (size_t) look.size * look.size * look.size) {
+            std::cout << "ColorGrading: " << path << " has " << look.table.size() << " entries for size "
+                      << look.size << std::endl;
+            return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (look.domainMax[i] <= look.domainMin[i]) {
+                std::cout << "ColorGrading: " << path << " has an empty domain" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<Look> &Looks() const
+    {
+        return looks;
+    }
+
+    // composes look `index` with the grade into the texture, only when something changed
+    void Bake(int index, int size, bool grade, float contrast, float saturation)
+    {
+        index = std::max(0, std::min(index, (int) looks.size() - 1));
+        size = std::max(2, std::min(size, 64));
+        if (baked && index == bakedIndex && size == bakedSize && grade == bakedGrade
+            && (!grade || (contrast == bakedContrast && saturation == bakedSaturation)))
+            return;
+        bakedIndex = index;
+        bakedSize = size;
+        bakedGrade = grade;
+        bakedContrast = contrast;
+        bakedSaturation = saturation;
+        baked = true;
+
+        const Look &look = looks[index];
+        std::vector<glm::vec3> table((size_t) size * size * size);
+        for (int b = 0; b < size; b++)
+            for (int g = 0; g < size; g++)
+                for (int r = 0; r < size; r++) {
+                    glm::vec3 color = glm::vec3(r, g, b) / (float) (size - 1);
+                    if (grade) {
+                        // contrast around mid grey, saturation around the luma
+                        color = (color - 0.5f) * contrast + 0.5f;
+                        float luma = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                        color = glm::clamp(glm::mix(glm::vec3(luma), color, saturation), 0.0f, 1.0f);
+                    }
+                    table[((size_t) b * size + g) * size + r] = sample(look, color);
+                }
+
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, &table[0]);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        bakes++;
+    }
+
+    // binds the baked table for the ColorLut stage
+    void Bind(int unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    int Size() const
+    {
+        return bakedSize;
+    }
+
+    // how often the table was rebuilt, for the overlay
+    int Bakes() const
+    {
+        return bakes;
+    }
+
+private:
+    std::vector<Look> looks;
+    unsigned int texture = 0;
+    bool baked = false, bakedGrade = false;
+    int bakedIndex = 0, bakedSize = 0;
+    float bakedContrast = 0.0f, bakedSaturation = 0.0f;
+    int bakes = 0;
+
+    static Look bake(const std::string &name, int size, const std::function<glm::vec3(const glm::vec3 &)> &look)
+    {
+        Look result{ name, size, std::vector<glm::vec3>((size_t) size * size * size) };
+        for (int b = 0; b < size; b++)
+            for (int g = 0; g < size; g++)
+                for (int r = 0; r < size; r++)
+                    result.table[((size_t) b * size + g) * size + r] = look(glm::vec3(r, g, b) / (float) (size - 1));
+        return result;
+    }
+
+    // trilinear lookup of a color in a look of any size, through the look's input domain
+    static glm::vec3 sample(const Look &look, const glm::vec3 &color)
+    {
+        glm::vec3 coords = (color - look.domainMin) / (look.domainMax - look.domainMin);
+        glm::vec3 position = glm::clamp(coords, 0.0f, 1.0f) * (float) (look.size - 1);
+        int lowR = std::min((int) position.x, look.size - 2);
+        int lowG = std::min((int) position.y, look.size - 2);
+        int lowB = std::min((int) position.z, look.size - 2);
+        glm::vec3 f = position - glm::vec3(lowR, lowG, lowB);
+        auto at = [&](int r, int g, int b) {
+            return look.table[((size_t) (lowB + b) * look.size + (lowG + g)) * look.size + (lowR + r)];
+        };
+        glm::vec3 x00 = glm::mix(at(0, 0, 0), at(1, 0, 0), f.x), x10 = glm::mix(at(0, 1, 0), at(1, 1, 0), f.x);
+        glm::vec3 x01 = glm::mix(at(0, 0, 1), at(1, 0, 1), f.x), x11 = glm::mix(at(0, 1, 1), at(1, 1, 1), f.x);
+        return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/sh_ambient.h>
+#include <learnopengl/clustered_lighting.h>
+
+#include <iostream>
+
+// Deferred shading path, the alternative to shading the city in cityShader.fs.
+// The geometry pass writes a compact G-buffer: albedo + specular intensity (RGBA8), an octahedral encoded
+// normal (RG16) and depth, the position is reconstructed from depth so it costs no storage. Lighting then
+// runs as fullscreen passes into the scene framebuffer: one for the directional light and the spotlight and one
+// that adds the point lights of each pixel's cluster (tiled/clustered deferred, the clusters are shared with
+// the forward path). 12 bytes per pixel are written and read back, instead of every overdrawn fragment
+// running the full lighting.
+class DeferredRenderer
+{
+public:
+    static const int BYTES_PER_PIXEL = 4 + 4 + 4;
+
+    unsigned int gBuffer = 0;
+    unsigned int albedoSpecular = 0, normals = 0, depth = 0;
+    int width = 0, height = 0;
+    // the G-buffer stores no material exponent, the whole scene uses this one like the forward path
+    float shininess = 30.0f;
+
+    Shader geometryShader;
+    // permutations with DIR_LIGHT / SPOT_LIGHT, same defines as cityShader.fs
+    ShaderVariants directionalShaders;
+    // permutations with SSAO
+    ShaderVariants pointShaders;
+
+    DeferredRenderer(int width, int height)
+        : geometryShader("resources/shaders/gbuffer.vs", "resources/shaders/gbuffer.fs"),
+          directionalShaders("resources/shaders/fullscreen.vs", "resources/shaders/deferredDirectional.fs"),
+          pointShaders("resources/shaders/fullscreen.vs", "resources/shaders/deferredPoint.fs")
+    {
+        glGenFramebuffers(1, &gBuffer);
+        glGenTextures(1, &albedoSpecular);
+        glGenTextures(1, &normals);
+        glGenTextures(1, &depth);
+        // the fullscreen passes make their triangle from gl_VertexID, the VAO stays empty
+        glGenVertexArrays(1, &emptyVAO);
+        Resize(width, height);
+
+        geometryShader.use();
+        geometryShader.setInt("material.diffuse", 0);
+        geometryShader.setInt("material.specular", 1);
+        directionalShaders.onCreate = setupLightingProgram;
+        pointShaders.onCreate = setupLightingProgram;
+        directionalShaders.fragmentLibrary = "resources/shaders/shared.glsl";
+        pointShaders.fragmentLibrary = "resources/shaders/shared.glsl";
+    }
+
+    ~DeferredRenderer()
+    {
+        unsigned int textures[3] = { albedoSpecular, normals, depth };
+        glDeleteTextures(3, textures);
+        glDeleteFramebuffers(1, &gBuffer);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    void Resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        allocate(albedoSpecular, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        allocate(normals, GL_RG16, GL_RG, GL_UNSIGNED_SHORT);
+        allocate(depth, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normals, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // binds and clears the G-buffer, the caller draws the opaque geometry with geometryShader
+    void BeginGeometryPass(const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        geometryShader.use();
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+    }
+
+    // copies the G-buffer depth into the scene framebuffer (same size, DEPTH24_STENCIL8) so forward drawn
+    // objects and the skybox are still depth tested against the deferred geometry
+    void CopyDepth(unsigned int targetFramebuffer)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                          GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
+    }
+
+    // directional light + spotlight into the bound framebuffer. shader is the permutation of directionalShaders
+    // in use, its light uniforms have to be set by the caller beforehand (setLights()).
+    void DrawDirectional(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view,
+                         const glm::vec3 &viewPosition)
+    {
+        beginLightPass(shader, projection, view, viewPosition);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        endLightPass();
+    }
+
+    // clustered point lights, added on top of the directional pass. shader is the permutation of pointShaders in
+    // use, with the occlusion bound by the caller beforehand when it has SSAO (Ssao::Bind()).
+    void DrawPointLights(Shader &shader, const ClusteredLighting &lighting, const glm::mat4 &projection,
+                         const glm::mat4 &view, const glm::vec3 &viewPosition)
+    {
+        beginLightPass(shader, projection, view, viewPosition);
+        lighting.Bind(shader);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glDisable(GL_BLEND);
+        endLightPass();
+    }
+
+private:
+    unsigned int emptyVAO = 0;
+
+    static void setupLightingProgram(Shader &shader)
+    {
+        SkyboxAmbient::BindBlock(shader);
+        shader.setInt("gAlbedoSpecular", 0);
+        shader.setInt("gNormal", 1);
+        shader.setInt("gDepth", 2);
+    }
+
+    void allocate(unsigned int texture, GLint internalFormat, GLenum format, GLenum type)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        // read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void beginLightPass(Shader &shader, const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &viewPosition)
+    {
+        shader.use();
+        shader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        shader.setVec3("viewPosition", viewPosition);
+        shader.setFloat("material.shininess", shininess);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoSpecular);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normals);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, depth);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+    }
+
+    void endLightPass()
+    {
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+};
+
+#endif
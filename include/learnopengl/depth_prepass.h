@@ -0,0 +1,131 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include "imgui.h"
+
+// Optional depth-only pass in front of the forward city pass.
+// The city is first drawn from its position only vertex buffers with depthPrepass.vs/fs and color writes off,
+// then the color pass runs with GL_EQUAL and depth writes off so cityShader.fs runs once per visible pixel
+// instead of once per overdrawn fragment.
+// GL 3.3 has no pipeline statistics, so the fragments that reach the city shader are counted with a
+// GL_SAMPLES_PASSED query around the color pass (with early depth testing that is the number of fragment
+// shader invocations that count). The queries are read FRAMES frames later so nothing stalls.
+class DepthPrepass
+{
+public:
+    static const int FRAMES = 4;
+
+    Shader shader;
+
+    // smoothed results
+    float shadedFragments = 0.0f;
+    // shaded fragments per screen pixel
+    float overdraw = 0.0f;
+    // averages with the pre-pass on [1] and off [0], so both can be compared after toggling
+    float frameMilliseconds[2] = { 0.0f, 0.0f };
+    float sceneMilliseconds[2] = { 0.0f, 0.0f };
+
+    DepthPrepass(int width, int height)
+        : shader("resources/shaders/depthPrepass.vs", "resources/shaders/depthPrepass.fs")
+    {
+        glGenQueries(FRAMES, queries);
+        Resize(width, height);
+    }
+
+    ~DepthPrepass()
+    {
+        glDeleteQueries(FRAMES, queries);
+    }
+
+    void Resize(int width, int height)
+    {
+        pixels = (float) width * height;
+    }
+
+    // the caller draws the opaque geometry with DrawDepth() between BeginDepthPass() and EndDepthPass()
+    void BeginDepthPass(const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    void EndDepthPass()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // wraps the color pass of the same geometry, counts its fragments either way
+    void BeginColorPass(bool prepassDone)
+    {
+        enabled = prepassDone;
+        if (prepassDone) {
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+        pending[current] = true;
+    }
+
+    void EndColorPass()
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    // call once per frame after the color pass with this frame's timings
+    void EndFrame(float frameMs, float sceneMs)
+    {
+        current = (current + 1) % FRAMES;
+        if (pending[current]) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint samples = 0;
+                glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT, &samples);
+                shadedFragments += (samples - shadedFragments) * 0.1f;
+                overdraw = shadedFragments / pixels;
+            }
+            pending[current] = false;
+        }
+
+        // the GPU timings lag a few frames, skip them after a toggle so the modes don't mix
+        if (enabled != lastEnabled) {
+            lastEnabled = enabled;
+            framesSinceToggle = 0;
+        }
+        if (++framesSinceToggle <= FRAMES + 2)
+            return;
+        int mode = enabled ? 1 : 0;
+        frameMilliseconds[mode] += (frameMs - frameMilliseconds[mode]) * 0.05f;
+        sceneMilliseconds[mode] += (sceneMs - sceneMilliseconds[mode]) * 0.05f;
+    }
+
+    void DrawImGui()
+    {
+        ImGui::Text("Osencenih fragmenata: %.0f (%.2f po pikselu)", shadedFragments, overdraw);
+        ImGui::Text("%-12s %10s %10s", "", "frejm", "GPU scena");
+        ImGui::Text("%-12s %7.2f ms %7.2f ms", "pre-pass on", frameMilliseconds[1], sceneMilliseconds[1]);
+        ImGui::Text("%-12s %7.2f ms %7.2f ms", "pre-pass off", frameMilliseconds[0], sceneMilliseconds[0]);
+    }
+
+private:
+    unsigned int queries[FRAMES];
+    bool pending[FRAMES] = {};
+    int current = 0;
+    float pixels = 1.0f;
+    bool enabled = false, lastEnabled = false;
+    int framesSinceToggle = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Picks the render scale (RenderTargets::SetScale()) that holds the GPU frame time at targetMilliseconds.
+// It is fed the "Frejm" GpuProfiler scope, which arrives a few frames late without ever blocking. The cost is
+// taken to follow the pixel count, so dropSamples frames in a row over the target drop the scale at once by
+// sqrt(target / time). Going up is slower: only after raiseSamples samples in a row under
+// target * (1 - headroom), one step at a time. Between the two thresholds nothing changes, and after every
+// change the controller waits settleSeconds for the targets to be reallocated and for timings of the new size
+// to arrive, so it doesn't oscillate.
+class DynamicResolution
+{
+public:
+    static const int HISTORY = 240;
+
+    float targetMilliseconds = 16.6f;
+    float minScale = 0.5f, maxScale = 1.0f;
+    // scales are multiples of step, so small corrections don't reallocate the targets
+    float step = 0.05f;
+    float headroom = 0.15f;
+    int dropSamples = 3;
+    int raiseSamples = 30;
+    double settleSeconds = 0.5;
+
+    // a new frame time sample (skip repeats of the last one), returns the scale to render at
+    float Update(float frameMilliseconds, double time)
+    {
+        history[next] = frameMilliseconds;
+        scaleHistory[next] = scale;
+        next = (next + 1) % HISTORY;
+        count = std::min(count + 1, HISTORY);
+
+        scale = std::max(minScale, std::min(scale, maxScale));
+        if (time - changedAt < settleSeconds)
+            return scale;
+        if (frameMilliseconds > targetMilliseconds) {
+            fastSamples = 0;
+            if (++slowSamples >= dropSamples) {
+                // fewer pixels in proportion, rounded down to a step
+                float wanted = scale * std::sqrt(targetMilliseconds / frameMilliseconds);
+                change(std::floor(wanted / step) * step, time);
+                slowSamples = 0;
+            }
+        } else if (frameMilliseconds < targetMilliseconds * (1.0f - headroom)) {
+            slowSamples = 0;
+            if (++fastSamples >= raiseSamples) {
+                change(scale + step, time);
+                fastSamples = 0;
+            }
+        } else {
+            slowSamples = fastSamples = 0;
+        }
+        return scale;
+    }
+
+    // restarts at `start`, e.g. when the controller is switched on
+    void Reset(float start, double time)
+    {
+        scale = std::max(minScale, std::min(start, maxScale));
+        changedAt = time;
+        slowSamples = fastSamples = 0;
+    }
+
+    float Scale() const
+    {
+        return scale;
+    }
+
+    int Changes() const
+    {
+        return changes;
+    }
+
+    // frame time against the target and the scale over the last HISTORY samples
+    void DrawImGui() const
+    {
+        float frames[HISTORY], scales[HISTORY];
+        for (int i = 0; i < count; i++) {
+            int at = (next - count + i + HISTORY) % HISTORY;
+            frames[i] = history[at];
+            scales[i] = scaleHistory[at];
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "%.2f ms (cilj %.1f)", count ? frames[count - 1] : 0.0f, targetMilliseconds);
+        ImGui::PlotLines("GPU frejm", frames, count, 0, label, 0.0f, targetMilliseconds * 2.0f, ImVec2(0, 60));
+        snprintf(label, sizeof(label), "%.2f, %d promena", scale, changes);
+        ImGui::PlotLines("Skala", scales, count, 0, label, 0.0f, 1.0f, ImVec2(0, 60));
+    }
+
+private:
+    float scale = 1.0f;
+    double changedAt = 0.0;
+    int slowSamples = 0, fastSamples = 0;
+    int changes = 0;
+    float history[HISTORY] = {}, scaleHistory[HISTORY] = {};
+    int next = 0, count = 0;
+
+    void change(float wanted, double time)
+    {
+        // the float steps don't add up exactly, snap to the grid
+        wanted = std::round(wanted / step) * step;
+        wanted = std::max(minScale, std::min(wanted, maxScale));
+        if (std::fabs(wanted - scale) < step * 0.5f)
+            return;
+        scale = wanted;
+        changedAt = time;
+        changes++;
+    }
+};
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/instance_data.h>
+#include <common.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Instance culling on the GPU with transform feedback, GL 3.3 only.
+// All instances live in a static buffer that is uploaded only when the set changes. Every frame cull.vs tests
+// one point per instance against the frustum with the rasterizer discarded, cull.gs emits only the survivors
+// and transform feedback packs them into a compact output buffer. The number written is read back from a
+// GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query a frame or two later (glDrawTransformFeedbackInstanced
+// needs GL 4.2), so the results rotate through SLOTS output buffers and the draw always uses the newest slot
+// whose query already finished.
+class GpuCuller
+{
+public:
+    static const int SLOTS = 3;
+
+    // world space distance added to every bounding sphere, hides the frame the results lag behind
+    float cullMargin = 1.0f;
+
+    GpuCuller(const glm::vec3 &boundsCenter, float boundsRadius)
+        : boundsCenter(boundsCenter), boundsRadius(boundsRadius)
+    {
+        nearProgram = buildProgram(false);
+        farProgram = buildProgram(true);
+
+        glGenBuffers(1, &instanceBuffer);
+        instanceVAO = Format().CreateVAO({ instanceBuffer });
+
+        for (Slot &slot : slots) {
+            glGenBuffers(1, &slot.nearBuffer);
+            glGenBuffers(1, &slot.farBuffer);
+            glGenQueries(1, &slot.nearQuery);
+            glGenQueries(1, &slot.farQuery);
+        }
+    }
+
+    // uploads all the instances, only needed when the instance set changed
+    void Upload(const std::vector<InstanceData> &instances)
+    {
+        instanceCount = instances.size();
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData),
+                     instances.empty() ? nullptr : &instances[0], GL_STATIC_DRAW);
+        // worst case every instance survives
+        size_t outputSize = std::max<size_t>(1, instanceCount) * sizeof(InstanceData);
+        for (Slot &slot : slots) {
+            glBindBuffer(GL_ARRAY_BUFFER, slot.nearBuffer);
+            glBufferData(GL_ARRAY_BUFFER, outputSize, nullptr, GL_STREAM_COPY);
+            glBindBuffer(GL_ARRAY_BUFFER, slot.farBuffer);
+            glBufferData(GL_ARRAY_BUFFER, outputSize, nullptr, GL_STREAM_COPY);
+            // results in flight were computed from the old instances
+            slot.pending = false;
+            slot.valid = false;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // culls every instance into the next slot. Instances closer than lodDistance go to the near buffer,
+    // with farPass the rest go to the far buffer. Both hold InstanceData.
+    void Cull(const Frustum &frustum, const glm::vec3 &cameraPosition, float lodDistance, bool farPass)
+    {
+        collectResults();
+        // the newest finished result is what gets drawn until a newer one finishes, even when the GPU is so far
+        // behind that every other slot is still waiting on its queries
+        current = (current + 1) % SLOTS;
+        if (current == latest)
+            current = (current + 1) % SLOTS;
+        Slot &slot = slots[current];
+        slot.pending = false;
+        slot.valid = false;
+        slot.hasFar = farPass;
+        slot.frame = ++frame;
+        if (instanceCount == 0)
+            return;
+
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(instanceVAO);
+        cullPass(nearProgram, slot.nearBuffer, slot.nearQuery, frustum, cameraPosition, lodDistance);
+        if (farPass)
+            cullPass(farProgram, slot.farBuffer, slot.farQuery, frustum, cameraPosition, lodDistance);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        slot.pending = true;
+    }
+
+    // newest finished result, false until the first one is available
+    bool NearResult(unsigned int &buffer, unsigned int &count)
+    {
+        collectResults();
+        if (latest < 0)
+            return false;
+        buffer = slots[latest].nearBuffer;
+        count = slots[latest].nearCount;
+        return true;
+    }
+
+    bool FarResult(unsigned int &buffer, unsigned int &count)
+    {
+        collectResults();
+        if (latest < 0 || !slots[latest].hasFar)
+            return false;
+        buffer = slots[latest].farBuffer;
+        count = slots[latest].farCount;
+        return true;
+    }
+
+    // one point per instance, scale and yaw stay packed since the culling shader only passes them through
+    static const VertexFormat &Format()
+    {
+        static const VertexFormat format = VertexFormat("cull")
+                .Stream(sizeof(InstanceData))
+                .Attribute("aPosition", 0, 3, GL_FLOAT, offsetof(InstanceData, position))
+                .IntegerAttribute("aScaleYaw", 1, 1, GL_UNSIGNED_INT, offsetof(InstanceData, scale));
+        return format;
+    }
+
+private:
+    struct Slot {
+        unsigned int nearBuffer = 0, farBuffer = 0;
+        unsigned int nearQuery = 0, farQuery = 0;
+        unsigned int nearCount = 0, farCount = 0;
+        bool hasFar = false;
+        bool pending = false;
+        bool valid = false;
+        // when it was culled, the newest finished slot wins
+        unsigned int frame = 0;
+    };
+
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+
+    unsigned int nearProgram, farProgram;
+    unsigned int instanceBuffer = 0, instanceVAO = 0;
+    unsigned int instanceCount = 0;
+
+    Slot slots[SLOTS];
+    int current = 0;
+    int latest = -1;
+    unsigned int frame = 0;
+
+    void cullPass(unsigned int program, unsigned int outputBuffer, unsigned int query,
+                  const Frustum &frustum, const glm::vec3 &cameraPosition, float lodDistance)
+    {
+        glUseProgram(program);
+        glUniform4fv(glGetUniformLocation(program, "frustumPlanes"), 6, &frustum.planes[0][0]);
+        glUniform3fv(glGetUniformLocation(program, "viewPosition"), 1, &cameraPosition[0]);
+        glUniform1f(glGetUniformLocation(program, "lodDistance"), lodDistance);
+        glUniform3fv(glGetUniformLocation(program, "boundsCenter"), 1, &boundsCenter[0]);
+        glUniform1f(glGetUniformLocation(program, "boundsRadius"), boundsRadius);
+        glUniform1f(glGetUniformLocation(program, "cullMargin"), cullMargin);
+
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, outputBuffer);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, instanceCount);
+        glEndTransformFeedback();
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    }
+
+    // picks up the counts of every slot whose queries finished, without ever waiting for the GPU
+    void collectResults()
+    {
+        for (Slot &slot : slots) {
+            if (!slot.pending)
+                continue;
+
+            GLuint available = 0;
+            glGetQueryObjectuiv(slot.hasFar ? slot.farQuery : slot.nearQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            glGetQueryObjectuiv(slot.nearQuery, GL_QUERY_RESULT, &slot.nearCount);
+            if (slot.hasFar)
+                glGetQueryObjectuiv(slot.farQuery, GL_QUERY_RESULT, &slot.farCount);
+            slot.pending = false;
+            slot.valid = true;
+        }
+
+        latest = -1;
+        for (int i = 0; i < SLOTS; i++)
+            if (slots[i].valid && (latest < 0 || slots[i].frame > slots[latest].frame))
+                latest = i;
+    }
+
+    static unsigned int buildProgram(bool farPass)
+    {
+        std::string defines = farPass ? "#define FAR_PASS\n" : "";
+        unsigned int vertex = compile(GL_VERTEX_SHADER, "resources/shaders/cull.vs", defines);
+        unsigned int geometry = compile(GL_GEOMETRY_SHADER, "resources/shaders/cull.gs", defines);
+
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, geometry);
+        // the captured outputs have to be declared before linking, interleaved they match InstanceData
+        const char *varyings[] = { "outPosition", "outScaleYaw" };
+        glTransformFeedbackVaryings(program, 2, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(program);
+
+        GLint success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[1024];
+            glGetProgramInfoLog(program, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: CULL\n" << infoLog << std::endl;
+        }
+        Format().Validate(program, farPass ? "cull (far)" : "cull");
+        glDeleteShader(vertex);
+        glDeleteShader(geometry);
+        return program;
+    }
+
+    // defines go right after the #version line
+    static unsigned int compile(GLenum type, const std::string &path, const std::string &defines)
+    {
+        std::string source = readFileContents(path);
+        size_t lineEnd = source.find('\n');
+        source.insert(lineEnd == std::string::npos ? source.size() : lineEnd + 1, defines);
+        const char *code = source.c_str();
+
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &code, NULL);
+        glCompileShader(shader);
+        GLint success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[1024];
+            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR in: " << path << "\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include "imgui.h"
+
+#include <string>
+#include <vector>
+
+// GPU timings of named, nestable scopes.
+// Every Begin()/End() pair puts a GL_TIMESTAMP query on each side of the scope (GL_TIME_ELAPSED queries can't
+// nest). The queries of a frame are read FRAMES frames later when the GPU is long done with them, so
+// profiling never stalls the pipeline; a frame whose queries still aren't ready is simply dropped.
+class GpuProfiler
+{
+public:
+    static const int FRAMES = 4;
+
+    // how much every new sample moves the displayed average
+    float smoothing = 0.1f;
+
+    ~GpuProfiler()
+    {
+        for (Frame &frame : frames)
+            if (!frame.queries.empty())
+                glDeleteQueries(frame.queries.size(), &frame.queries[0]);
+    }
+
+    // call once per frame before the first Begin(), collects the results of FRAMES frames ago
+    void BeginFrame()
+    {
+        current = (current + 1) % FRAMES;
+        collect(frames[current]);
+        frames[current].scopes.clear();
+        frames[current].usedQueries = 0;
+        depth = 0;
+    }
+
+    void Begin(const std::string &name)
+    {
+        Frame &frame = frames[current];
+        Scope scope;
+        scope.name = name;
+        scope.depth = depth++;
+        scope.beginQuery = query(frame);
+        scope.endQuery = 0;
+        glQueryCounter(scope.beginQuery, GL_TIMESTAMP);
+        open.push_back(frame.scopes.size());
+        frame.scopes.push_back(scope);
+    }
+
+    void End()
+    {
+        Frame &frame = frames[current];
+        Scope &scope = frame.scopes[open.back()];
+        open.pop_back();
+        depth--;
+        scope.endQuery = query(frame);
+        glQueryCounter(scope.endQuery, GL_TIMESTAMP);
+    }
+
+    // smoothed milliseconds of a scope, 0 until its first result arrives
+    float Milliseconds(const std::string &name) const
+    {
+        for (const Timing &timing : timings)
+            if (timing.name == name)
+                return timing.milliseconds;
+        return 0.0f;
+    }
+
+    // last raw (unsmoothed) sample of a scope
+    float LastMilliseconds(const std::string &name) const
+    {
+        for (const Timing &timing : timings)
+            if (timing.name == name)
+                return timing.last;
+        return 0.0f;
+    }
+
+    // how many results of a scope arrived so far, tells a new LastMilliseconds() from the one seen before
+    int Samples(const std::string &name) const
+    {
+        for (const Timing &timing : timings)
+            if (timing.name == name)
+                return timing.samples;
+        return 0;
+    }
+
+    // table of every scope seen so far, indented by nesting
+    void DrawImGui()
+    {
+        ImGui::Begin("GPU vreme");
+        for (const Timing &timing : timings)
+            ImGui::Text("%*s%-20s %6.3f ms", timing.depth * 2, "", timing.name.c_str(), timing.milliseconds);
+        ImGui::End();
+    }
+
+private:
+    struct Scope {
+        std::string name;
+        int depth;
+        unsigned int beginQuery, endQuery;
+    };
+
+    struct Frame {
+        std::vector<Scope> scopes;
+        std::vector<unsigned int> queries;
+        unsigned int usedQueries = 0;
+    };
+
+    struct Timing {
+        std::string name;
+        int depth;
+        float milliseconds;
+        float last;
+        int samples;
+    };
+
+    Frame frames[FRAMES];
+    int current = 0;
+    int depth = 0;
+    std::vector<size_t> open;
+    // in the order the scopes were first seen, which is the order they run in
+    std::vector<Timing> timings;
+
+    unsigned int query(Frame &frame)
+    {
+        if (frame.usedQueries == frame.queries.size()) {
+            unsigned int id;
+            glGenQueries(1, &id);
+            frame.queries.push_back(id);
+        }
+        return frame.queries[frame.usedQueries++];
+    }
+
+    void collect(Frame &frame)
+    {
+        if (frame.scopes.empty())
+            return;
+        // the last query issued finishes last
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        for (const Scope &scope : frame.scopes) {
+            if (!scope.endQuery)
+                continue;
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(scope.beginQuery, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(scope.endQuery, GL_QUERY_RESULT, &end);
+            record(scope, (float)((end - begin) / 1.0e6));
+        }
+    }
+
+    void record(const Scope &scope, float milliseconds)
+    {
+        for (Timing &timing : timings) {
+            if (timing.name == scope.name) {
+                timing.milliseconds += (milliseconds - timing.milliseconds) * smoothing;
+                timing.last = milliseconds;
+                timing.samples++;
+                return;
+            }
+        }
+        timings.push_back(Timing{ scope.name, scope.depth, milliseconds, milliseconds, 1 });
+    }
+};
+
+#endif
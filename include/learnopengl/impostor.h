@@ -0,0 +1,234 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <learnopengl/instancing.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Octahedral impostor of a model.
+// At load time the model is rendered from framesPerSide x framesPerSide view directions laid out on an
+// octahedron into two atlases: albedo (alpha = coverage) and model space normal (xyz) + linear depth (w). Far
+// away instances are then drawn as a single camera facing quad that blends the frames closest to the
+// current view direction, so a whole tree costs 4 vertices instead of the full mesh. The normals are turned by
+// the instance yaw for the skybox ambient, so far trees are lit like the near ones.
+class Impostor
+{
+public:
+    unsigned int albedoAtlas = 0;
+    unsigned int normalDepthAtlas = 0;
+    int framesPerSide;
+    int frameResolution;
+
+    // bounding sphere of the model in model space
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+
+    Impostor(Model &model, int framesPerSide = 8, int frameResolution = 128)
+        : framesPerSide(framesPerSide), frameResolution(frameResolution)
+    {
+        glm::vec3 boundsMin, boundsMax;
+        model.GetBounds(boundsMin, boundsMax);
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+        bake(model);
+        setupQuad();
+    }
+
+    // uploads the instances drawn as impostors
+    void UpdateInstances(const vector<InstanceData> &instances)
+    {
+        instanceCount = instances.size();
+        void *out = stream.Map(instances.size() * sizeof(InstanceData));
+        if (out)
+            std::memcpy(out, &instances[0], instances.size() * sizeof(InstanceData));
+        stream.Unmap();
+    }
+
+    // draws all the uploaded instances with a single call; projection, view and viewPosition
+    // have to be set on the shader by the caller
+    void Draw(Shader &shader)
+    {
+        Draw(shader, stream.ID, stream.Offset(), instanceCount);
+        stream.Fence();
+    }
+
+    // draws `count` instances read from any buffer in the same format (e.g. written by GPU culling)
+    void Draw(Shader &shader, unsigned int buffer, size_t offset, unsigned int count)
+    {
+        if (count == 0)
+            return;
+
+        shader.setInt("albedoAtlas", 0);
+        shader.setInt("normalDepthAtlas", 1);
+        shader.setInt("framesPerSide", framesPerSide);
+        shader.setVec3("boundsCenter", boundsCenter);
+        shader.setFloat("boundsRadius", boundsRadius);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, albedoAtlas);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normalDepthAtlas);
+
+        glBindVertexArray(quadVAO);
+        Format().BindStream(1, buffer, offset);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // maps a unit direction to [-1, 1]^2, y is the up axis of the octahedron
+    static glm::vec2 OctahedralEncode(glm::vec3 n)
+    {
+        n /= (std::abs(n.x) + std::abs(n.y) + std::abs(n.z));
+        glm::vec2 p(n.x, n.z);
+        if (n.y < 0.0f)
+            p = glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                          (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+        return p;
+    }
+
+    static glm::vec3 OctahedralDecode(glm::vec2 p)
+    {
+        glm::vec3 n(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+        if (n.y < 0.0f) {
+            float x = n.x, z = n.z;
+            n.x = (1.0f - std::abs(z)) * (x >= 0.0f ? 1.0f : -1.0f);
+            n.z = (1.0f - std::abs(x)) * (z >= 0.0f ? 1.0f : -1.0f);
+        }
+        return glm::normalize(n);
+    }
+
+    // quad corners + InstanceData, the impostor has no mesh so the instance stream can start at location 1
+    static const VertexFormat &Format()
+    {
+        static const VertexFormat format = VertexFormat("impostor")
+                .Stream(2 * sizeof(float))
+                .Attribute("aCorner", 0, 2, GL_FLOAT, 0)
+                .Stream(sizeof(InstanceData), 1)
+                .Attribute("instancePosition", 1, 3, GL_FLOAT, offsetof(InstanceData, position))
+                .Attribute("instanceScaleYaw", 2, 2, GL_HALF_FLOAT, offsetof(InstanceData, scale));
+        return format;
+    }
+
+private:
+    unsigned int quadVAO = 0, quadVBO = 0;
+    unsigned int instanceCount = 0;
+    StreamBuffer stream;
+
+    // renders every octahedral frame of the model into the atlases
+    void bake(Model &model)
+    {
+        int atlasSize = framesPerSide * frameResolution;
+
+        glGenTextures(1, &albedoAtlas);
+        glBindTexture(GL_TEXTURE_2D, albedoAtlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glGenTextures(1, &normalDepthAtlas);
+        glBindTexture(GL_TEXTURE_2D, normalDepthAtlas);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        unsigned int fbo, depthRbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepthAtlas, 0);
+        glGenRenderbuffers(1, &depthRbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbo);
+        unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Impostor atlas framebuffer is not complete!" << std::endl;
+
+        // both atlases start fully transparent so the gaps between frames never show up
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        GLint previousViewport[4];
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        GLboolean cullingEnabled = glIsEnabled(GL_CULL_FACE);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+
+        Shader bakeShader("resources/shaders/impostorBake.vs", "resources/shaders/impostorBake.fs");
+        MeshVertexFormat().Validate(bakeShader.ID, "impostorBake");
+        bakeShader.use();
+        float r = boundsRadius;
+        glm::mat4 projection = glm::ortho(-r, r, -r, r, 0.0f, 2.0f * r);
+        bakeShader.setMat4("projection", projection);
+        bakeShader.setFloat("depthRange", 2.0f * r);
+
+        for (int y = 0; y < framesPerSide; y++) {
+            for (int x = 0; x < framesPerSide; x++) {
+                glm::vec3 direction = frameDirection(x, y);
+                glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::mat4 view = glm::lookAt(boundsCenter + direction * r, boundsCenter, up);
+                bakeShader.setMat4("view", view);
+
+                glViewport(x * frameResolution, y * frameResolution, frameResolution, frameResolution);
+                model.Draw(bakeShader);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        if (cullingEnabled)
+            glEnable(GL_CULL_FACE);
+        glDeleteRenderbuffers(1, &depthRbo);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteProgram(bakeShader.ID);
+
+        // only a few mip levels, below that neighbouring frames start bleeding into each other
+        int maxLevel = std::max(0, (int)std::log2((float)frameResolution) - 3);
+        unsigned int atlases[2] = { albedoAtlas, normalDepthAtlas };
+        for (unsigned int atlas : atlases) {
+            glBindTexture(GL_TEXTURE_2D, atlas);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // the frames cover the octahedron edge to edge, frame (0, 0) looks from (-1, -1) in octahedral space
+    glm::vec3 frameDirection(int x, int y) const
+    {
+        glm::vec2 p = glm::vec2((float)x, (float)y) / (float)(framesPerSide - 1) * 2.0f - 1.0f;
+        return OctahedralDecode(p);
+    }
+
+    void setupQuad()
+    {
+        float corners[] = {
+                -1.0f, -1.0f,
+                 1.0f, -1.0f,
+                -1.0f,  1.0f,
+                 1.0f,  1.0f
+        };
+        glGenBuffers(1, &quadVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+        // the instance stream is bound per draw in Draw() since the ring region moves
+        quadVAO = Format().CreateVAO({ quadVBO, 0 });
+    }
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef INSTANCE_DATA_H
+#define INSTANCE_DATA_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <cstdint>
+#include <cstring>
+
+// Compact per-instance data, 16 bytes instead of a 64 byte mat4.
+// Instances only ever get a translation, a uniform scale and a rotation around the y axis, so the vertex
+// shaders rebuild the model matrix from the position and the two half floats. Per instance color variation
+// is hashed from the position in the shaders and not stored at all.
+struct InstanceData {
+    glm::vec3 position;
+    uint16_t scale; // half float
+    uint16_t yaw;   // half float, radians
+};
+
+// float to IEEE half, values too small for a normal half are flushed to zero
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int)((bits >> 23) & 0xffu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent <= 0)
+        return (uint16_t)sign;
+    if (exponent >= 31)
+        return (uint16_t)(sign | 0x7c00u);
+    // rounding may carry into the exponent, which is exactly what we want
+    return (uint16_t)((sign | ((uint32_t)exponent << 10)) + ((mantissa + 0x1000u) >> 13));
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0)
+        bits = sign; // zero (denormals are never written by FloatToHalf)
+    else if (exponent == 31)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// instance stream drawn together with MeshVertexFormat, right after its locations
+inline const VertexFormat &InstanceVertexFormat()
+{
+    static const VertexFormat format = VertexFormat("instance")
+            .Stream(sizeof(InstanceData), 1)
+            .Attribute("instancePosition", 5, 3, GL_FLOAT, offsetof(InstanceData, position))
+            .Attribute("instanceScaleYaw", 6, 2, GL_HALF_FLOAT, offsetof(InstanceData, scale));
+    return format;
+}
+
+inline InstanceData MakeInstance(const glm::vec3 &position, float scale, float yaw)
+{
+    InstanceData instance;
+    instance.position = position;
+    instance.scale = FloatToHalf(scale);
+    instance.yaw = FloatToHalf(yaw);
+    return instance;
+}
+
+#endif
@@ -0,0 +1,414 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/model.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/gpu_culling.h>
+#include <learnopengl/instance_data.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Vertex buffer that is rewritten every frame.
+// The buffer is split into REGIONS regions used round robin, each one guarded by a fence, so the CPU writes
+// into a region the GPU finished reading frames ago and neither side ever waits on the other. GL 3.3 has no
+// persistent mapping, so the active region is mapped unsynchronized for the duration of the write instead.
+class StreamBuffer
+{
+public:
+    static const int REGIONS = 3;
+
+    unsigned int ID = 0;
+    size_t regionSize = 0;
+
+    explicit StreamBuffer(size_t initialRegionSize = 64 * 1024)
+    {
+        glGenBuffers(1, &ID);
+        allocate(initialRegionSize);
+    }
+
+    // moves to the next region and maps `bytes` of it for writing, returns nullptr when there is nothing to write
+    void *Map(size_t bytes)
+    {
+        current = (current + 1) % REGIONS;
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        if (bytes > regionSize)
+            allocate(std::max(bytes, regionSize * 2));
+        waitForRegion(current);
+
+        mapped = bytes > 0;
+        if (!mapped)
+            return nullptr;
+        return glMapBufferRange(GL_ARRAY_BUFFER, Offset(), bytes,
+                                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    }
+
+    void Unmap()
+    {
+        if (mapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, ID);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = false;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // byte offset of the region written by the last Map()
+    size_t Offset() const
+    {
+        return current * regionSize;
+    }
+
+    // call after the last draw that reads the current region
+    void Fence()
+    {
+        if (fences[current])
+            glDeleteSync(fences[current]);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    int current = 0;
+    bool mapped = false;
+    GLsync fences[REGIONS] = {};
+
+    void allocate(size_t bytes)
+    {
+        // keep region offsets aligned for any attribute type
+        regionSize = (bytes + 255) & ~(size_t)255;
+        // orphaning gives us fresh storage, draws in flight keep reading the old one
+        for (GLsync &fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        glBufferData(GL_ARRAY_BUFFER, regionSize * REGIONS, nullptr, GL_STREAM_DRAW);
+    }
+
+    void waitForRegion(int region)
+    {
+        if (!fences[region])
+            return;
+        GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        glDeleteSync(fences[region]);
+        fences[region] = 0;
+    }
+};
+
+typedef unsigned int InstanceHandle;
+
+// A set of instances of one model that can be added, removed and moved at runtime.
+// Every frame Update() culls the set against the view frustum and streams only the visible instances into
+// the set's own StreamBuffer, Draw() then draws them with one instanced call per mesh. The set owns its
+// vertex arrays, so any number of sets can share the same model.
+// UpdateGpu() is the alternative for very large sets: the instances are uploaded once and culled by a
+// GpuCuller, the CPU doesn't touch them again until the set changes.
+class InstanceSet
+{
+public:
+    unsigned int visibleCount = 0;
+
+    explicit InstanceSet(Model &model) : model(model)
+    {
+        glm::vec3 boundsMin, boundsMax;
+        model.GetBounds(boundsMin, boundsMax);
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        // sphere centered on the y axis so it holds for any rotation around it
+        boundsCenter = glm::vec3(0.0f, center.y, 0.0f);
+        boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f + glm::length(glm::vec2(center.x, center.z));
+
+        // the instance stream is bound per frame in Draw() since the ring region moves
+        for (Mesh &mesh : model.meshes)
+            VAOs.push_back(Format().CreateVAO({ mesh.VBO, 0 }, mesh.EBO));
+    }
+
+    // mesh vertices (locations 0-4) + InstanceData (5-6)
+    static const VertexFormat &Format()
+    {
+        static const VertexFormat format = VertexFormat::Combine(MeshVertexFormat(), InstanceVertexFormat());
+        return format;
+    }
+
+    InstanceHandle Add(const glm::vec3 &position, float scale, float yaw = 0.0f)
+    {
+        InstanceHandle handle;
+        if (!freeHandles.empty()) {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        } else {
+            handle = handleToIndex.size();
+            handleToIndex.push_back(0);
+        }
+        handleToIndex[handle] = instances.size();
+        indexToHandle.push_back(handle);
+        instances.push_back(MakeInstance(position, scale, yaw));
+        version++;
+        return handle;
+    }
+
+    // swaps the last instance into the freed slot so the instances stay densely packed
+    void Remove(InstanceHandle handle)
+    {
+        unsigned int index = handleToIndex[handle];
+        unsigned int last = instances.size() - 1;
+        instances[index] = instances[last];
+        indexToHandle[index] = indexToHandle[last];
+        handleToIndex[indexToHandle[index]] = index;
+        instances.pop_back();
+        indexToHandle.pop_back();
+        freeHandles.push_back(handle);
+        version++;
+    }
+
+    void Move(InstanceHandle handle, const glm::vec3 &position, float scale, float yaw)
+    {
+        instances[handleToIndex[handle]] = MakeInstance(position, scale, yaw);
+        version++;
+    }
+
+    const InstanceData &Get(InstanceHandle handle) const
+    {
+        return instances[handleToIndex[handle]];
+    }
+
+    void Clear()
+    {
+        instances.clear();
+        indexToHandle.clear();
+        handleToIndex.clear();
+        freeHandles.clear();
+        version++;
+    }
+
+    size_t Size() const
+    {
+        return instances.size();
+    }
+
+    // culls the set and streams the visible instances closer than lodDistance into this frame's ring region.
+    // Visible instances past lodDistance are appended to farInstances when given.
+    void Update(const Frustum &frustum, const glm::vec3 &cameraPosition, float lodDistance,
+                vector<InstanceData> *farInstances = nullptr)
+    {
+        float lodDistance2 = lodDistance * lodDistance;
+        visible.clear();
+        for (unsigned int i = 0; i < instances.size(); i++) {
+            const InstanceData &instance = instances[i];
+            float scale = HalfToFloat(instance.scale);
+            if (!frustum.IntersectsSphere(instance.position + boundsCenter * scale, boundsRadius * scale))
+                continue;
+
+            glm::vec3 toCamera = instance.position - cameraPosition;
+            if (farInstances && glm::dot(toCamera, toCamera) >= lodDistance2)
+                farInstances->push_back(instance);
+            else
+                visible.push_back(i);
+        }
+
+        visibleCount = visible.size();
+        InstanceData *out = (InstanceData*)stream.Map(visibleCount * sizeof(InstanceData));
+        for (unsigned int i = 0; i < visibleCount; i++)
+            out[i] = instances[visible[i]];
+        stream.Unmap();
+
+        drawBuffer = stream.ID;
+        drawOffset = stream.Offset();
+        drawingStream = true;
+    }
+
+    // same as Update() but culled on the GPU, the drawn result is one or two frames old.
+    // With farPass the instances past lodDistance are available through GpuFarInstances().
+    void UpdateGpu(const Frustum &frustum, const glm::vec3 &cameraPosition, float lodDistance, bool farPass)
+    {
+        if (!gpuCuller)
+            gpuCuller.reset(new GpuCuller(boundsCenter, boundsRadius));
+        if (uploadedVersion != version) {
+            gpuCuller->Upload(instances);
+            uploadedVersion = version;
+        }
+        gpuCuller->Cull(frustum, cameraPosition, lodDistance, farPass);
+
+        if (!gpuCuller->NearResult(drawBuffer, visibleCount))
+            visibleCount = 0;
+        drawOffset = 0;
+        drawingStream = false;
+    }
+
+    // culls the set against a shadow caster volume (CascadedShadows::DynamicFrustum()) into buffers of its own, so
+    // the camera's result Draw() uses stays untouched. Casters at least lodDistance from the camera are left to
+    // ShadowImpostors(), the rest DrawShadowCasters() draws as meshes (FLT_MAX keeps every caster a mesh).
+    // With gpu a GpuCuller of the casters' own culls them every frame, the result is a frame or two old like
+    // UpdateGpu()'s. On the CPU the lists are only rebuilt when the set, the volume or lodDistance change; the
+    // volume moves when a cached cascade is re-centered, so the split keeps the camera position of the last rebuild.
+    void UpdateShadowCasters(const Frustum &frustum, const glm::vec3 &cameraPosition, float lodDistance, bool gpu)
+    {
+        bool farPass = lodDistance < std::numeric_limits<float>::max();
+        if (gpu) {
+            if (!casterCuller)
+                casterCuller.reset(new GpuCuller(boundsCenter, boundsRadius));
+            if (casterUploadedVersion != version) {
+                casterCuller->Upload(instances);
+                casterUploadedVersion = version;
+            }
+            casterCuller->Cull(frustum, cameraPosition, lodDistance, farPass);
+            casterBuffer = casterFarBuffer = 0;
+            casterOffset = casterFarOffset = 0;
+            if (!casterCuller->NearResult(casterBuffer, casterCount))
+                casterCount = 0;
+            if (!farPass || !casterCuller->FarResult(casterFarBuffer, casterFarCount))
+                casterFarCount = 0;
+            // the CPU lists have to be rebuilt when the CPU path comes back
+            casterVersion = ~0u;
+            return;
+        }
+
+        if (casterVersion == version && casterLodDistance == lodDistance && sameFrustum(frustum, casterFrustum))
+            return;
+        casterVersion = version;
+        casterLodDistance = lodDistance;
+        casterFrustum = frustum;
+
+        float lodDistance2 = lodDistance * lodDistance;
+        casters.clear();
+        farCasters.clear();
+        for (unsigned int i = 0; i < instances.size(); i++) {
+            const InstanceData &instance = instances[i];
+            float scale = HalfToFloat(instance.scale);
+            if (!frustum.IntersectsSphere(instance.position + boundsCenter * scale, boundsRadius * scale))
+                continue;
+            glm::vec3 toCamera = instance.position - cameraPosition;
+            if (farPass && glm::dot(toCamera, toCamera) >= lodDistance2)
+                farCasters.push_back(i);
+            else
+                casters.push_back(i);
+        }
+        // the near casters, then the far ones; drawn until the next rebuild, which orphans the storage so draws
+        // in flight keep reading the old lists
+        vector<InstanceData> upload;
+        upload.reserve(casters.size() + farCasters.size());
+        for (unsigned int index : casters)
+            upload.push_back(instances[index]);
+        for (unsigned int index : farCasters)
+            upload.push_back(instances[index]);
+        if (!casterInstances)
+            glGenBuffers(1, &casterInstances);
+        glBindBuffer(GL_ARRAY_BUFFER, casterInstances);
+        glBufferData(GL_ARRAY_BUFFER, upload.size() * sizeof(InstanceData), upload.empty() ? nullptr : &upload[0],
+                     GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        casterBuffer = casterFarBuffer = casterInstances;
+        casterOffset = 0;
+        casterFarOffset = casters.size() * sizeof(InstanceData);
+        casterCount = casters.size();
+        casterFarCount = farCasters.size();
+    }
+
+    // the near casters as meshes, depth only; called once per cascade
+    void DrawShadowCasters()
+    {
+        if (casterCount == 0)
+            return;
+        for (unsigned int m = 0; m < model.meshes.size(); m++) {
+            glBindVertexArray(VAOs[m]);
+            Format().BindStream(1, casterBuffer, casterOffset);
+            glDrawElementsInstanced(GL_TRIANGLES, model.meshes[m].indices.size(), GL_UNSIGNED_INT, 0, casterCount);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // the far casters for Impostor::Draw(), false when there are none
+    bool ShadowImpostors(unsigned int &buffer, size_t &offset, unsigned int &count) const
+    {
+        buffer = casterFarBuffer;
+        offset = casterFarOffset;
+        count = casterFarCount;
+        return count > 0;
+    }
+
+    size_t ShadowCasterCount() const
+    {
+        return casterCount + casterFarCount;
+    }
+
+    bool GpuFarInstances(unsigned int &buffer, unsigned int &count)
+    {
+        return gpuCuller && gpuCuller->FarResult(buffer, count);
+    }
+
+    void Draw(Shader &shader)
+    {
+        if (visibleCount == 0)
+            return;
+
+        for (unsigned int m = 0; m < model.meshes.size(); m++) {
+            Mesh &mesh = model.meshes[m];
+            mesh.BindTextures(shader);
+
+            glBindVertexArray(VAOs[m]);
+            Format().BindStream(1, drawBuffer, drawOffset);
+            glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0, visibleCount);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glActiveTexture(GL_TEXTURE0);
+        if (drawingStream)
+            stream.Fence();
+    }
+
+private:
+    Model &model;
+    vector<unsigned int> VAOs;
+    StreamBuffer stream;
+
+    glm::vec3 boundsCenter;
+    float boundsRadius;
+
+    // dense instance storage plus the handle indirection that keeps handles valid across removals
+    vector<InstanceData> instances;
+    vector<InstanceHandle> indexToHandle;
+    vector<unsigned int> handleToIndex;
+    vector<InstanceHandle> freeHandles;
+
+    vector<unsigned int> visible;
+    // shadow casters, see UpdateShadowCasters(): the lists of the last CPU rebuild and what the draws read
+    vector<unsigned int> casters, farCasters;
+    unsigned int casterInstances = 0;
+    Frustum casterFrustum;
+    float casterLodDistance = 0.0f;
+    unsigned int casterVersion = ~0u, casterUploadedVersion = ~0u;
+    unsigned int casterBuffer = 0, casterFarBuffer = 0;
+    size_t casterOffset = 0, casterFarOffset = 0;
+    unsigned int casterCount = 0, casterFarCount = 0;
+    std::unique_ptr<GpuCuller> casterCuller;
+
+    // what Draw() reads: this frame's ring region or the newest GPU culling result
+    unsigned int drawBuffer = 0;
+    size_t drawOffset = 0;
+    bool drawingStream = false;
+
+    unsigned int version = 0, uploadedVersion = ~0u;
+    std::unique_ptr<GpuCuller> gpuCuller;
+
+    static bool sameFrustum(const Frustum &a, const Frustum &b)
+    {
+        for (int i = 0; i < 6; i++)
+            if (a.planes[i] != b.planes[i])
+                return false;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef LIGHT_BENCHMARK_H
+#define LIGHT_BENCHMARK_H
+
+#include "imgui.h"
+
+#include <iostream>
+#include <vector>
+
+// Sweeps the point light count from 2 to 1024 (doubling) and measures the clustered lighting cost.
+// Every step runs warmupFrames frames that aren't measured (the GPU timings arrive a few frames late) and then
+// averages framesPerStep frames of light assignment time on the CPU and the GPU scene time samples that arrived
+// in them.
+class LightBenchmark
+{
+public:
+    static const int FIRST_COUNT = 2;
+    static const int LAST_COUNT = 1024;
+
+    int warmupFrames = 30;
+    int framesPerStep = 120;
+
+    struct Result {
+        int lights;
+        float assignMilliseconds;
+        float sceneMilliseconds;
+        float lightsPerCluster;
+    };
+    std::vector<Result> results;
+
+    void Start()
+    {
+        results.clear();
+        lightCount = FIRST_COUNT;
+        frame = 0;
+        running = true;
+        resetStep();
+    }
+
+    bool Running() const
+    {
+        return running;
+    }
+
+    // light count to render this frame with
+    int LightCount() const
+    {
+        return lightCount;
+    }
+
+    // call once per frame while running with the measurements of this frame; `fresh` when sceneMilliseconds
+    // is a new GPU sample
+    void Record(float assignMilliseconds, bool fresh, float sceneMilliseconds, float lightsPerCluster)
+    {
+        frame++;
+        if (frame <= warmupFrames)
+            return;
+        assignSum += assignMilliseconds;
+        if (fresh) {
+            sceneSum += sceneMilliseconds;
+            sceneSamples++;
+        }
+        lightsPerClusterSum += lightsPerCluster;
+        if (frame < warmupFrames + framesPerStep)
+            return;
+
+        results.push_back(Result{ lightCount, assignSum / framesPerStep,
+                                  sceneSamples > 0 ? sceneSum / sceneSamples : 0.0f,
+                                  lightsPerClusterSum / framesPerStep });
+        if (lightCount >= LAST_COUNT) {
+            running = false;
+            print();
+            return;
+        }
+        lightCount *= 2;
+        frame = 0;
+        resetStep();
+    }
+
+    void DrawImGui()
+    {
+        if (running)
+            ImGui::Text("Benchmark: %d svetala...", lightCount);
+        if (results.empty())
+            return;
+        ImGui::Text("%8s %12s %12s %10s", "svetla", "CPU dodela", "GPU scena", "po klast.");
+        for (const Result &result : results)
+            ImGui::Text("%8d %9.3f ms %9.3f ms %10.2f", result.lights, result.assignMilliseconds,
+                        result.sceneMilliseconds, result.lightsPerCluster);
+    }
+
+private:
+    bool running = false;
+    int lightCount = FIRST_COUNT;
+    int frame = 0;
+    float assignSum = 0.0f, sceneSum = 0.0f, lightsPerClusterSum = 0.0f;
+    int sceneSamples = 0;
+
+    void resetStep()
+    {
+        assignSum = sceneSum = lightsPerClusterSum = 0.0f;
+        sceneSamples = 0;
+    }
+
+    void print() const
+    {
+        std::cout << "Clustered lighting benchmark\n"
+                  << "lights  assign(ms)  scene(ms)  lights/cluster\n";
+        for (const Result &result : results)
+            std::cout << result.lights << '\t' << result.assignMilliseconds << '\t' << result.sceneMilliseconds
+                      << '\t' << result.lightsPerCluster << '\n';
+        std::cout << std::flush;
+    }
+};
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef LIGHT_STORE_H
+#define LIGHT_STORE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/clustered_lighting.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define LIGHT_STORE_SSE
+#endif
+
+// Lights of the scene, loaded from a text scene file (resources/scene/lights.txt) instead of being set up in code.
+// Point lights are kept as structure of arrays: positions per axis, the radius and the three packed color +
+// attenuation terms the lighting shaders read, so ClusteredLighting::Update() only has to copy them. Colors and
+// radii never change after loading, only the positions of lights with an animation track do. Animate() evaluates
+// the tracks (looped keyframes, linear or Catmull-Rom) for four lights at a time.
+//
+// Scene file, one entry per line, '#' starts a comment:
+//   track <name> <seconds> <linear|spline>                  followed by its keys: key <x> <y> <z>
+//   point <position> <color> <ambient> <diffuse> <specular> <constant> <linear> <quadratic> [<track> <speed> <phase>]
+//   scatter <count> <seed> <min> <max> <color> <color> <ambient> <diffuse> <specular> <constant> <linear> <quadratic>
+//           [<track> <speed>]                                 random points between min and max, phases random
+//   spot <position> <direction> <color> <ambient> <diffuse> <specular> <constant> <linear> <quadratic>
+//        <inner degrees> <outer degrees>
+// Vectors are three numbers, ambient/diffuse/specular scale the color. Track keys are offsets from the position.
+class LightStore
+{
+public:
+    struct SpotLight {
+        glm::vec3 position;
+        glm::vec3 direction;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        float constant;
+        float linear;
+        float quadratic;
+        float cutOff;
+        float outerCutOff;
+    };
+
+    // statistics of the last Animate()
+    float animateMicroseconds = 0.0f;
+    unsigned int animatedLights = 0;
+
+    // false if the file is missing or malformed, the store is left empty then
+    bool Load(const std::string &path, float threshold)
+    {
+        clear();
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "LightStore: " << path << " missing" << std::endl;
+            return false;
+        }
+        std::map<std::string, int> trackNames;
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(in, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string kind;
+            if (!(fields >> kind))
+                continue;
+            bool ok = true;
+            if (kind == "track") {
+                std::string name, interpolation;
+                Track track;
+                ok = (bool) (fields >> name >> track.seconds >> interpolation) && track.seconds > 0.0f
+                     && (interpolation == "linear" || interpolation == "spline");
+                track.spline = interpolation == "spline";
+                track.firstKey = keyX.size();
+                trackNames[name] = tracks.size();
+                tracks.push_back(track);
+            } else if (kind == "key") {
+                glm::vec3 key;
+                ok = !tracks.empty() && readVec3(fields, key);
+                if (ok) {
+                    keyX.push_back(key.x);
+                    keyY.push_back(key.y);
+                    keyZ.push_back(key.z);
+                    tracks.back().keyCount++;
+                }
+            } else if (kind == "point") {
+                glm::vec3 position;
+                PointLightSource light;
+                ok = readVec3(fields, position) && readTerms(fields, light);
+                int track = -1;
+                float speed = 1.0f, phase = 0.0f;
+                ok = ok && readTrack(fields, trackNames, track, speed, &phase);
+                if (ok)
+                    addPoint(position, light, threshold, track, speed, phase);
+            } else if (kind == "scatter") {
+                int count;
+                unsigned int seed;
+                glm::vec3 low, high, colorA, colorB;
+                PointLightSource light;
+                ok = (bool) (fields >> count >> seed) && readVec3(fields, low) && readVec3(fields, high)
+                     && readVec3(fields, colorA) && readVec3(fields, colorB) && readScales(fields, light);
+                int track = -1;
+                float speed = 1.0f;
+                ok = ok && readTrack(fields, trackNames, track, speed, nullptr);
+                // a fixed seed, so the same count always gives the same scene
+                std::mt19937 generator(seed);
+                std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+                for (int i = 0; ok && i < count; i++) {
+                    glm::vec3 position = low + (high - low) * glm::vec3(unit(generator), unit(generator), unit(generator));
+                    glm::vec3 color = glm::mix(colorA, colorB, unit(generator));
+                    PointLightSource lamp = light;
+                    lamp.ambient *= color;
+                    lamp.diffuse *= color;
+                    lamp.specular *= color;
+                    addPoint(position, lamp, threshold, track, speed, unit(generator));
+                }
+            } else if (kind == "spot") {
+                SpotLight spot;
+                glm::vec3 color, scales;
+                float inner, outer;
+                ok = readVec3(fields, spot.position) && readVec3(fields, spot.direction) && readVec3(fields, color)
+                     && readVec3(fields, scales)
+                     && (bool) (fields >> spot.constant >> spot.linear >> spot.quadratic >> inner >> outer);
+                spot.ambient = color * scales.x;
+                spot.diffuse = color * scales.y;
+                spot.specular = color * scales.z;
+                spot.cutOff = std::cos(glm::radians(inner));
+                spot.outerCutOff = std::cos(glm::radians(outer));
+                if (ok)
+                    spots.push_back(spot);
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                std::cout << "LightStore: " << path << ":" << lineNumber << " can't read '" << line << "'" << std::endl;
+                clear();
+                return false;
+            }
+        }
+        for (const Track &track : tracks)
+            if (track.keyCount < 2) {
+                std::cout << "LightStore: " << path << " has a track with less than 2 keys" << std::endl;
+                clear();
+                return false;
+            }
+        x = baseX;
+        y = baseY;
+        z = baseZ;
+        return true;
+    }
+
+    size_t PointCount() const
+    {
+        return baseX.size();
+    }
+
+    // the first spot light of the scene, nullptr without one
+    const SpotLight *Spot() const
+    {
+        return spots.empty() ? nullptr : &spots[0];
+    }
+
+    // moves the animated lights among the first `count` to where their tracks are at `time` seconds
+    void Animate(float time, size_t count)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t end = std::lower_bound(animated.begin(), animated.end(), (uint32_t) std::min(count, PointCount()))
+                     - animated.begin();
+        float segment[4], weights[4][4], control[3][4][4];
+        for (size_t i = 0; i < end; i += 4) {
+            int lanes = (int) std::min<size_t>(4, end - i);
+            // key position of each lane, the tracks loop: phases are in [0, 1) and time only grows
+            for (int lane = 0; lane < 4; lane++) {
+                uint32_t light = animated[i + std::min(lane, lanes - 1)];
+                const Track &track = tracks[trackOf[light]];
+                float loops = time * speedOf[light] / track.seconds + phaseOf[light];
+                segment[lane] = (loops - std::floor(loops)) * track.keyCount;
+                if (segment[lane] >= track.keyCount)
+                    segment[lane] = 0.0f;
+            }
+            splineWeights(segment, weights);
+            // the four keys around each lane's segment, linear tracks only use the middle two
+            for (int lane = 0; lane < 4; lane++) {
+                uint32_t light = animated[i + std::min(lane, lanes - 1)];
+                const Track &track = tracks[trackOf[light]];
+                int key = std::min((int) segment[lane], track.keyCount - 1);
+                float f = segment[lane] - key;
+                if (!track.spline) {
+                    weights[0][lane] = weights[3][lane] = 0.0f;
+                    weights[1][lane] = 1.0f - f;
+                    weights[2][lane] = f;
+                }
+                for (int k = 0; k < 4; k++) {
+                    unsigned int index = track.firstKey + (key + k - 1 + track.keyCount) % track.keyCount;
+                    control[0][k][lane] = keyX[index] + baseX[light];
+                    control[1][k][lane] = keyY[index] + baseY[light];
+                    control[2][k][lane] = keyZ[index] + baseZ[light];
+                }
+            }
+            float result[3][4];
+            for (int axis = 0; axis < 3; axis++)
+                blend(control[axis], weights, result[axis]);
+            for (int lane = 0; lane < lanes; lane++) {
+                uint32_t light = animated[i + lane];
+                x[light] = result[0][lane];
+                y[light] = result[1][lane];
+                z[light] = result[2][lane];
+            }
+        }
+        animatedLights = end;
+        auto stop = std::chrono::high_resolution_clock::now();
+        animateMicroseconds = std::chrono::duration<float, std::micro>(stop - start).count();
+    }
+
+    // the first `count` point lights as ClusteredLighting reads them
+    PointLightArrays Points(size_t count) const
+    {
+        PointLightArrays arrays;
+        arrays.count = std::min(count, PointCount());
+        if (arrays.count == 0)
+            return arrays;
+        arrays.x = &x[0];
+        arrays.y = &y[0];
+        arrays.z = &z[0];
+        arrays.radius = &radius[0];
+        arrays.terms = &terms[0];
+        return arrays;
+    }
+
+private:
+    struct Track {
+        float seconds = 1.0f;
+        bool spline = true;
+        unsigned int firstKey = 0;
+        int keyCount = 0;
+    };
+
+    // point lights: where they are placed, where they are this frame, and what never changes
+    std::vector<float> baseX, baseY, baseZ;
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    std::vector<glm::vec4> terms;
+    // animation of the lights in `animated` (ascending), the others keep trackOf -1
+    std::vector<int> trackOf;
+    std::vector<float> speedOf, phaseOf;
+    std::vector<uint32_t> animated;
+
+    std::vector<Track> tracks;
+    std::vector<float> keyX, keyY, keyZ;
+    std::vector<SpotLight> spots;
+
+    void clear()
+    {
+        for (std::vector<float> *array : { &baseX, &baseY, &baseZ, &x, &y, &z, &radius, &speedOf, &phaseOf,
+                                           &keyX, &keyY, &keyZ })
+            array->clear();
+        terms.clear();
+        trackOf.clear();
+        animated.clear();
+        tracks.clear();
+        spots.clear();
+    }
+
+    void addPoint(const glm::vec3 &position, const PointLightSource &light, float threshold, int track, float speed,
+                  float phase)
+    {
+        uint32_t index = baseX.size();
+        baseX.push_back(position.x);
+        baseY.push_back(position.y);
+        baseZ.push_back(position.z);
+        radius.push_back(ClusteredLighting::InfluenceRadius(light, threshold));
+        terms.push_back(glm::vec4(light.ambient, light.constant));
+        terms.push_back(glm::vec4(light.diffuse, light.linear));
+        terms.push_back(glm::vec4(light.specular, light.quadratic));
+        trackOf.push_back(track);
+        speedOf.push_back(speed);
+        phaseOf.push_back(phase - std::floor(phase));
+        if (track >= 0)
+            animated.push_back(index);
+    }
+
+    static bool readVec3(std::istream &in, glm::vec3 &value)
+    {
+        return (bool) (in >> value.x >> value.y >> value.z);
+    }
+
+    // ambient, diffuse and specular scales and the attenuation, the color is applied by the caller
+    static bool readScales(std::istream &in, PointLightSource &light)
+    {
+        float ambient, diffuse, specular;
+        if (!(in >> ambient >> diffuse >> specular >> light.constant >> light.linear >> light.quadratic))
+            return false;
+        light.ambient = glm::vec3(ambient);
+        light.diffuse = glm::vec3(diffuse);
+        light.specular = glm::vec3(specular);
+        return true;
+    }
+
+    static bool readTerms(std::istream &in, PointLightSource &light)
+    {
+        glm::vec3 color;
+        if (!readVec3(in, color) || !readScales(in, light))
+            return false;
+        light.ambient *= color;
+        light.diffuse *= color;
+        light.specular *= color;
+        return true;
+    }
+
+    // optional "<track> <speed> [<phase>]" at the end of a line
+    static bool readTrack(std::istream &in, const std::map<std::string, int> &names, int &track, float &speed,
+                          float *phase)
+    {
+        std::string name;
+        if (!(in >> name))
+            return true;
+        auto found = names.find(name);
+        if (found == names.end() || !(in >> speed) || (phase && !(in >> *phase)))
+            return false;
+        track = found->second;
+        return true;
+    }
+
+    // Catmull-Rom weights of the four keys around each lane's position
+    static void splineWeights(const float segment[4], float weights[4][4])
+    {
+#ifdef LIGHT_STORE_SSE
+        __m128 s = _mm_loadu_ps(segment);
+        __m128 f = _mm_sub_ps(s, _mm_cvtepi32_ps(_mm_cvttps_epi32(s)));
+        __m128 f2 = _mm_mul_ps(f, f), f3 = _mm_mul_ps(f2, f);
+        __m128 half = _mm_set1_ps(0.5f);
+        // w0 = (-f + 2f^2 - f^3) / 2, w1 = (2 - 5f^2 + 3f^3) / 2, w2 = (f + 4f^2 - 3f^3) / 2, w3 = (f^3 - f^2) / 2
+        __m128 w0 = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(f2, f2), f), f3);
+        __m128 w1 = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(2.0f), _mm_mul_ps(_mm_set1_ps(5.0f), f2)),
+                               _mm_mul_ps(_mm_set1_ps(3.0f), f3));
+        __m128 w2 = _mm_sub_ps(_mm_add_ps(f, _mm_mul_ps(_mm_set1_ps(4.0f), f2)), _mm_mul_ps(_mm_set1_ps(3.0f), f3));
+        __m128 w3 = _mm_sub_ps(f3, f2);
+        _mm_storeu_ps(weights[0], _mm_mul_ps(w0, half));
+        _mm_storeu_ps(weights[1], _mm_mul_ps(w1, half));
+        _mm_storeu_ps(weights[2], _mm_mul_ps(w2, half));
+        _mm_storeu_ps(weights[3], _mm_mul_ps(w3, half));
+#else
+        for (int lane = 0; lane < 4; lane++) {
+            float f = segment[lane] - (int) segment[lane];
+            float f2 = f * f, f3 = f2 * f;
+            weights[0][lane] = 0.5f * (-f + 2.0f * f2 - f3);
+            weights[1][lane] = 0.5f * (2.0f - 5.0f * f2 + 3.0f * f3);
+            weights[2][lane] = 0.5f * (f + 4.0f * f2 - 3.0f * f3);
+            weights[3][lane] = 0.5f * (f3 - f2);
+        }
+#endif
+    }
+
+    // sum of the weighted keys of one axis, four lanes at once
+    static void blend(const float keys[4][4], const float weights[4][4], float result[4])
+    {
+#ifdef LIGHT_STORE_SSE
+        __m128 sum = _mm_mul_ps(_mm_loadu_ps(keys[0]), _mm_loadu_ps(weights[0]));
+        for (int k = 1; k < 4; k++)
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(keys[k]), _mm_loadu_ps(weights[k])));
+        _mm_storeu_ps(result, sum);
+#else
+        for (int lane = 0; lane < 4; lane++)
+            result[lane] = keys[0][lane] * weights[0][lane] + keys[1][lane] * weights[1][lane]
+                           + keys[2][lane] * weights[2][lane] + keys[3][lane] * weights[3][lane];
+#endif
+    }
+};
+
+#endif
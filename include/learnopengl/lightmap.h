@@ -0,0 +1,237 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/lightmap_file.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/static_scene.h>
+#include <learnopengl/vertex_format.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// second uv set of the lightmapped meshes, unorm16 in its own stream
+inline const VertexFormat &LightmapUVFormat()
+{
+    static const VertexFormat format = VertexFormat("lightmapUV")
+            .Stream(2 * sizeof(uint16_t))
+            .Attribute("lightmapUV", 5, 2, GL_UNSIGNED_SHORT, 0, true);
+    return format;
+}
+
+// the lightmapped static models are never instanced, so the uv set takes the first instance location
+inline const VertexFormat &LightmapVertexFormat()
+{
+    static const VertexFormat format = VertexFormat::Combine(MeshVertexFormat(), LightmapUVFormat());
+    return format;
+}
+
+// Baked lighting of the static scene (tools/lightmap_baker): the directional light with its shadows and the sky
+// and sun bounce light as RGB9_E5 irradiance, plus ambient occlusion for the lights that stay dynamic.
+// The baker splits vertices along its UV charts, so every mesh of a static model gets its own vertex and index
+// buffers here, built from the Model's vertices through the file's remap. Textures stay bound on their own units.
+class Lightmap
+{
+public:
+    static const int IRRADIANCE_UNIT = 8;
+    static const int OCCLUSION_UNIT = 9;
+
+    ~Lightmap()
+    {
+        release();
+    }
+
+    // false if the file is missing or was baked from different models
+    bool Load(const std::string &path, Model *models[STATIC_MODEL_COUNT])
+    {
+        release();
+        LightmapFile file;
+        if (!file.Read(path)) {
+            std::cout << "Lightmap: " << path << " missing or unreadable, run lightmap_baker" << std::endl;
+            return false;
+        }
+        if (file.models.size() != STATIC_MODEL_COUNT) {
+            std::cout << "Lightmap: " << path << " has " << file.models.size() << " models instead of "
+                      << STATIC_MODEL_COUNT << std::endl;
+            return false;
+        }
+        for (int m = 0; m < STATIC_MODEL_COUNT; m++) {
+            const LightmapFile::Model &bakedModel = file.models[m];
+            Model &model = *models[m];
+            if (bakedModel.meshes.size() != model.meshes.size()) {
+                std::cout << "Lightmap: " << bakedModel.path << " changed since the bake" << std::endl;
+                release();
+                return false;
+            }
+            for (size_t i = 0; i < model.meshes.size(); i++) {
+                const LightmapFile::Mesh &baked = bakedModel.meshes[i];
+                const Mesh &mesh = model.meshes[i];
+                std::vector<Vertex> vertices(baked.remap.size());
+                for (size_t v = 0; v < baked.remap.size(); v++) {
+                    if (baked.remap[v] >= mesh.vertices.size()) {
+                        std::cout << "Lightmap: " << bakedModel.path << " changed since the bake" << std::endl;
+                        release();
+                        return false;
+                    }
+                    vertices[v] = mesh.vertices[baked.remap[v]];
+                }
+                meshes[m].push_back(createMesh(vertices, baked));
+            }
+        }
+        instances = file.instances;
+        lighting = file.lighting;
+
+        irradianceTexture = createTexture(GL_RGB9_E5, file.width, file.height, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV,
+                                          &file.irradiance[0]);
+        occlusionTexture = createTexture(GL_R8, file.width, file.height, GL_RED, GL_UNSIGNED_BYTE, &file.occlusion[0]);
+        width = file.width;
+        height = file.height;
+        loaded = true;
+        return true;
+    }
+
+    bool Loaded() const
+    {
+        return loaded;
+    }
+
+    // the bake only fits objects at the places they were baked at, lit by the sun and skybox it was baked with
+    bool Matches(const std::vector<StaticObject> &objects, const BakedLighting &current) const
+    {
+        if (!loaded || objects.size() != instances.size() || !lighting.Same(current))
+            return false;
+        for (size_t i = 0; i < objects.size(); i++) {
+            if ((uint32_t) objects[i].model != instances[i].model)
+                return false;
+            for (int c = 0; c < 4; c++)
+                if (glm::length(objects[i].transform[c] - instances[i].transform[c]) > 1e-4f)
+                    return false;
+        }
+        return true;
+    }
+
+    void BindTextures() const
+    {
+        glActiveTexture(GL_TEXTURE0 + IRRADIANCE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, irradianceTexture);
+        glActiveTexture(GL_TEXTURE0 + OCCLUSION_UNIT);
+        glBindTexture(GL_TEXTURE_2D, occlusionTexture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    static void SetSamplers(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("lightmapIrradiance", IRRADIANCE_UNIT);
+        shader.setInt("lightmapOcclusion", OCCLUSION_UNIT);
+    }
+
+    // draws object `index` of the static scene with the split meshes and its atlas rect
+    void Draw(Shader &shader, size_t index, Model &model) const
+    {
+        const LightmapFile::Instance &instance = instances[index];
+        shader.setVec4("lightmapScaleOffset", instance.scaleOffset);
+        const std::vector<LightmapMesh> &split = meshes[instance.model];
+        for (size_t i = 0; i < split.size(); i++) {
+            model.meshes[i].BindTextures(shader);
+            glBindVertexArray(split[i].VAO);
+            glDrawElements(GL_TRIANGLES, split[i].indexCount, GL_UNSIGNED_INT, 0);
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // irradiance and occlusion texels
+    size_t TextureBytes() const
+    {
+        return (size_t) width * height * 5;
+    }
+
+    unsigned int Width() const
+    {
+        return width;
+    }
+
+    unsigned int Height() const
+    {
+        return height;
+    }
+
+private:
+    struct LightmapMesh {
+        unsigned int VAO, VBO, uvVBO, EBO;
+        unsigned int indexCount;
+    };
+
+    std::vector<LightmapMesh> meshes[STATIC_MODEL_COUNT];
+    std::vector<LightmapFile::Instance> instances;
+    BakedLighting lighting;
+    unsigned int irradianceTexture = 0, occlusionTexture = 0;
+    unsigned int width = 0, height = 0;
+    bool loaded = false;
+
+    static LightmapMesh createMesh(const std::vector<Vertex> &vertices, const LightmapFile::Mesh &baked)
+    {
+        LightmapMesh mesh;
+        glGenBuffers(1, &mesh.VBO);
+        glGenBuffers(1, &mesh.uvVBO);
+        glGenBuffers(1, &mesh.EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.uvVBO);
+        glBufferData(GL_ARRAY_BUFFER, baked.uv.size() * sizeof(uint16_t), baked.uv.empty() ? NULL : &baked.uv[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, baked.indices.size() * sizeof(uint32_t),
+                     baked.indices.empty() ? NULL : &baked.indices[0], GL_STATIC_DRAW);
+        mesh.VAO = LightmapVertexFormat().CreateVAO({ mesh.VBO, mesh.uvVBO }, mesh.EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        mesh.indexCount = baked.indices.size();
+        return mesh;
+    }
+
+    static unsigned int createTexture(GLenum internalFormat, unsigned int width, unsigned int height, GLenum format,
+                                      GLenum type, const void *data)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        // no mips, the charts are only padded by a couple of texels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    }
+
+    void release()
+    {
+        for (std::vector<LightmapMesh> &split : meshes) {
+            for (LightmapMesh &mesh : split) {
+                glDeleteVertexArrays(1, &mesh.VAO);
+                glDeleteBuffers(1, &mesh.VBO);
+                glDeleteBuffers(1, &mesh.uvVBO);
+                glDeleteBuffers(1, &mesh.EBO);
+            }
+            split.clear();
+        }
+        if (irradianceTexture)
+            glDeleteTextures(1, &irradianceTexture);
+        if (occlusionTexture)
+            glDeleteTextures(1, &occlusionTexture);
+        irradianceTexture = occlusionTexture = 0;
+        instances.clear();
+        loaded = false;
+    }
+};
+
+#endif
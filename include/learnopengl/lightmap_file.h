@@ -0,0 +1,178 @@
+#ifndef LIGHTMAP_FILE_H
+#define LIGHTMAP_FILE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/baked_lighting.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// On disk format of a baked lightmap, written by tools/lightmap_baker and read by Lightmap.
+// The baker splits vertices along its UV charts, so for every mesh of a model the file keeps the new vertex list
+// as indices into the original vertices (remap) plus its second UV set, and the new triangle list. Instances place
+// a model's [0,1] UV square into the atlas with scaleOffset. Texels are shared exponent RGB9_E5 irradiance (the
+// format GL samples directly) and 8 bit ambient occlusion: 5 bytes a texel. The sun and skybox of the bake come first.
+struct LightmapFile
+{
+    static const uint32_t MAGIC = 0x50414d4c; // "LMAP"
+    static const uint32_t VERSION = 2;
+
+    struct Mesh {
+        std::vector<uint32_t> remap;
+        // unorm16 pairs
+        std::vector<uint16_t> uv;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Model {
+        std::string path;
+        std::vector<Mesh> meshes;
+    };
+
+    struct Instance {
+        uint32_t model;
+        glm::mat4 transform;
+        // atlas uv = uv * scaleOffset.xy + scaleOffset.zw
+        glm::vec4 scaleOffset;
+    };
+
+    uint32_t width = 0, height = 0;
+    BakedLighting lighting;
+    std::vector<Model> models;
+    std::vector<Instance> instances;
+    std::vector<uint32_t> irradiance;
+    std::vector<uint8_t> occlusion;
+
+    bool Write(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+        writeValue(out, MAGIC);
+        writeValue(out, VERSION);
+        writeValue(out, width);
+        writeValue(out, height);
+        writeValue(out, lighting.sunDirection);
+        writeValue(out, lighting.sunColor);
+        writeValue(out, lighting.flatAmbient);
+        writeVector(out, std::vector<char>(lighting.skybox.begin(), lighting.skybox.end()));
+        writeValue(out, (uint32_t) models.size());
+        for (const Model &model : models) {
+            writeVector(out, std::vector<char>(model.path.begin(), model.path.end()));
+            writeValue(out, (uint32_t) model.meshes.size());
+            for (const Mesh &mesh : model.meshes) {
+                writeVector(out, mesh.remap);
+                writeVector(out, mesh.uv);
+                writeVector(out, mesh.indices);
+            }
+        }
+        writeValue(out, (uint32_t) instances.size());
+        for (const Instance &instance : instances)
+            writeValue(out, instance);
+        writeVector(out, irradiance);
+        writeVector(out, occlusion);
+        return (bool) out;
+    }
+
+    bool Read(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        uint32_t magic = 0, version = 0, count = 0;
+        if (!readValue(in, magic) || magic != MAGIC || !readValue(in, version) || version != VERSION)
+            return false;
+        readValue(in, width);
+        readValue(in, height);
+        readValue(in, lighting.sunDirection);
+        readValue(in, lighting.sunColor);
+        readValue(in, lighting.flatAmbient);
+        std::vector<char> skybox;
+        readVector(in, skybox);
+        lighting.skybox.assign(skybox.begin(), skybox.end());
+        readValue(in, count);
+        models.assign(count, Model());
+        for (Model &model : models) {
+            std::vector<char> name;
+            readVector(in, name);
+            model.path.assign(name.begin(), name.end());
+            readValue(in, count);
+            model.meshes.assign(count, Mesh());
+            for (Mesh &mesh : model.meshes) {
+                readVector(in, mesh.remap);
+                readVector(in, mesh.uv);
+                readVector(in, mesh.indices);
+            }
+        }
+        readValue(in, count);
+        instances.assign(count, Instance());
+        for (Instance &instance : instances)
+            readValue(in, instance);
+        readVector(in, irradiance);
+        readVector(in, occlusion);
+        return (bool) in && irradiance.size() == (size_t) width * height && occlusion.size() == irradiance.size();
+    }
+
+    // GL_RGB9_E5 as in EXT_texture_shared_exponent
+    static uint32_t PackRGB9E5(glm::vec3 color)
+    {
+        const int MANTISSA_BITS = 9, EXPONENT_BIAS = 15, MAX_EXPONENT = 31;
+        const float maxValue = (float) ((1 << MANTISSA_BITS) - 1) / (1 << MANTISSA_BITS) * (float) (1 << (MAX_EXPONENT - EXPONENT_BIAS));
+        float r = std::min(std::max(color.r, 0.0f), maxValue);
+        float g = std::min(std::max(color.g, 0.0f), maxValue);
+        float b = std::min(std::max(color.b, 0.0f), maxValue);
+        float maxComponent = std::max(r, std::max(g, b));
+        int exponent = std::max(-EXPONENT_BIAS - 1, (int) std::floor(std::log2(std::max(maxComponent, 1e-30f)))) + 1 + EXPONENT_BIAS;
+        float scale = std::ldexp(1.0f, exponent - EXPONENT_BIAS - MANTISSA_BITS);
+        if ((int) std::floor(maxComponent / scale + 0.5f) == (1 << MANTISSA_BITS)) {
+            exponent++;
+            scale *= 2.0f;
+        }
+        uint32_t rs = (uint32_t) std::floor(r / scale + 0.5f);
+        uint32_t gs = (uint32_t) std::floor(g / scale + 0.5f);
+        uint32_t bs = (uint32_t) std::floor(b / scale + 0.5f);
+        return rs | (gs << 9) | (bs << 18) | ((uint32_t) exponent << 27);
+    }
+
+    static glm::vec3 UnpackRGB9E5(uint32_t packed)
+    {
+        float scale = std::ldexp(1.0f, (int) (packed >> 27) - 15 - 9);
+        return glm::vec3(packed & 511, (packed >> 9) & 511, (packed >> 18) & 511) * scale;
+    }
+
+private:
+    template<typename T>
+    static void writeValue(std::ofstream &out, const T &value)
+    {
+        out.write((const char *) &value, sizeof(T));
+    }
+
+    template<typename T>
+    static void writeVector(std::ofstream &out, const std::vector<T> &values)
+    {
+        writeValue(out, (uint32_t) values.size());
+        if (!values.empty())
+            out.write((const char *) &values[0], values.size() * sizeof(T));
+    }
+
+    template<typename T>
+    static bool readValue(std::ifstream &in, T &value)
+    {
+        return (bool) in.read((char *) &value, sizeof(T));
+    }
+
+    template<typename T>
+    static bool readVector(std::ifstream &in, std::vector<T> &values)
+    {
+        uint32_t count = 0;
+        if (!readValue(in, count))
+            return false;
+        values.resize(count);
+        return count == 0 || (bool) in.read((char *) &values[0], count * sizeof(T));
+    }
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
 #include <string>
 #include <vector>
@@ -25,7 +26,27 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
-
+// model vertices take locations 0-4, instance formats start at 5
+inline const VertexFormat &MeshVertexFormat()
+{
+    static const VertexFormat format = VertexFormat("mesh")
+            .Stream(sizeof(Vertex))
+            .Attribute("position", 0, 3, GL_FLOAT, offsetof(Vertex, Position))
+            .Attribute("normal", 1, 3, GL_FLOAT, offsetof(Vertex, Normal))
+            .Attribute("texCoords", 2, 2, GL_FLOAT, offsetof(Vertex, TexCoords))
+            .Attribute("tangent", 3, 3, GL_FLOAT, offsetof(Vertex, Tangent))
+            .Attribute("bitangent", 4, 3, GL_FLOAT, offsetof(Vertex, Bitangent));
+    return format;
+}
+
+// tightly packed positions for depth only passes, 12 bytes a vertex instead of sizeof(Vertex)
+inline const VertexFormat &PositionVertexFormat()
+{
+    static const VertexFormat format = VertexFormat("position")
+            .Stream(sizeof(glm::vec3))
+            .Attribute("position", 0, 3, GL_FLOAT, 0);
+    return format;
+}
 
 struct Texture {
     unsigned int id;
@@ -56,33 +77,7 @@ public:
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
-
+        BindTextures(shader);
 
         // draw mesh
         glBindVertexArray(VAO);
@@ -93,8 +88,16 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
-    // render the mesh
-    void DrawInstanced(Shader &shader, int amount)
+    // render only the positions, for depth only passes (no textures are bound)
+    void DrawDepth()
+    {
+        glBindVertexArray(positionVAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    // binds the mesh textures to consecutive texture units and points the shader samplers at them
+    void BindTextures(Shader &shader)
     {
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
@@ -121,25 +124,21 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-
-        glBindVertexArray(VAO);
-        glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, amount);
-        glBindVertexArray(0);
     }
 
-private:
-    // render data
+    // render data, exposed so other vertex arrays (e.g. instance sets) can reuse the mesh buffers
     unsigned int VBO, EBO;
+    // position only copy of the vertices sharing EBO
+    unsigned int positionVAO, positionVBO;
 
+private:
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
+        // create buffers
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
@@ -149,25 +148,19 @@ private:
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        VAO = MeshVertexFormat().CreateVAO({ VBO }, EBO);
+
+        vector<glm::vec3> positions(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenBuffers(1, &positionVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        positionVAO = PositionVertexFormat().CreateVAO({ positionVBO }, EBO);
     }
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,267 @@
+#ifndef POST_CHAIN_H
+#define POST_CHAIN_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/render_graph.h>
+#include <learnopengl/target_format.h>
+
+#include "imgui.h"
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Post processing as a list of declared stages that are compiled into as few fullscreen passes as possible.
+// Every stage is a GLSL function in resources/shaders/post/. A per-pixel stage maps a color to a color,
+// vec3 Name(vec3 color, vec2 uv). A neighborhood stage also reads around the pixel,
+// vec3 Name(vec3 color, vec2 uv, vec2 texel), through FETCH(uv). FETCH re-runs the stages before it in the same
+// pass on the input texture at that uv, so the stage still fuses. A second neighborhood stage in one pass would
+// re-run the first for every one of its taps, so it starts a new pass with an intermediate (SetFormat()) instead.
+// AddPasses() declares one RenderGraph pass per pass of the enabled stages, each generating its fragment shader
+// and compiling it on first use (through the program binary cache): with at most one neighborhood stage the frame
+// is read once and written once. The intermediates are graph transients at the input's resolution, the last
+// pass writes the output resolution and so also does the upscale when the input is smaller: bilinear, or
+// Catmull-Rom (post/Upscale.glsl) with bicubicUpscale.
+class PostChain
+{
+public:
+    enum Kind {
+        PER_PIXEL,
+        NEIGHBORHOOD
+    };
+
+    struct Stage {
+        std::string name;
+        // function name, also the file resources/shaders/post/<function>.glsl
+        std::string function;
+        Kind kind;
+        bool enabled = false;
+    };
+
+    // texture units of the generated shaders, the input is always on 0
+    static const int BLOOM_UNIT = 1;
+    static const int LUT_UNIT = 2;
+
+    bool bicubicUpscale = true;
+
+    PostChain()
+    {
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    ~PostChain()
+    {
+        for (auto &program : programs)
+            glDeleteProgram(program.second.ID);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    PostChain(const PostChain &) = delete;
+    PostChain &operator=(const PostChain &) = delete;
+
+    // format of the intermediates between passes; with RGBA8 the ones before the tone mapping stay RGBA16F
+    void SetFormat(const TargetFormat &newFormat)
+    {
+        format = &newFormat;
+    }
+
+    // stages run in declaration order
+    void Declare(const std::string &name, const std::string &function, Kind kind)
+    {
+        stages.push_back(Stage{ name, function, kind, false });
+    }
+
+    void Enable(const std::string &function, bool enabled)
+    {
+        for (Stage &stage : stages)
+            if (stage.function == function)
+                stage.enabled = enabled;
+    }
+
+    // declares a pass per plan() entry running the enabled stages on `input` into `output` (the window), the
+    // intermediates between them are graph transients at the input's size. Only the pass with the bloom
+    // composite reads `bloom`, so without it the bloom passes are culled. setUniforms(shader) sets the stages'
+    // parameters on every pass shader (a uniform a pass doesn't have is ignored).
+    void AddPasses(RenderGraph &graph, RenderGraph::Resource input, RenderGraph::Resource bloom,
+                   RenderGraph::Resource output, const std::function<void(Shader &)> &setUniforms)
+    {
+        width = graph.Width(input);
+        height = graph.Height(input);
+        outputWidth = graph.Width(output);
+        outputHeight = graph.Height(output);
+        std::vector<std::vector<const Stage *>> passes = plan();
+        // an intermediate written before the tone mapping holds HDR colors, which RGBA8 would clamp
+        bool toneMapped = !enabled("ToneMap");
+        for (size_t p = 0; p < passes.size(); p++) {
+            bool composite = false;
+            for (const Stage *stage : passes[p]) {
+                composite = composite || stage->function == "BloomComposite";
+                toneMapped = toneMapped || stage->function == "ToneMap";
+            }
+            const TargetFormat &intermediate = toneMapped || format->type != GL_UNSIGNED_BYTE
+                                               ? *format : TargetFormat::Get(TargetFormat::RGBA16F);
+            bool last = p + 1 == passes.size();
+            RenderGraph::Resource target = last ? output : graph.Create("Post " + std::to_string(p), width, height,
+                                                                        intermediate);
+            RenderGraph::Resource passBloom = composite ? bloom : RenderGraph::NONE;
+            bool upscale = last && bicubicUpscale && (outputWidth != width || outputHeight != height);
+            const std::vector<const Stage *> &fused = passes[p];
+
+            graph.AddPass("Post " + std::to_string(p), { input, passBloom }, { target },
+                          [this, &graph, fused, upscale, input, passBloom, target, setUniforms]() {
+                GLint polygonMode[2];
+                glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+                glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+                glDisable(GL_DEPTH_TEST);
+                glDepthMask(GL_FALSE);
+                glBindVertexArray(emptyVAO);
+
+                graph.BindTarget(target);
+                Shader &shader = program(fused, upscale);
+                shader.use();
+                shader.setVec2("sourceTexel", glm::vec2(1.0f / width, 1.0f / height));
+                setUniforms(shader);
+                glActiveTexture(GL_TEXTURE0 + BLOOM_UNIT);
+                glBindTexture(GL_TEXTURE_2D, passBloom != RenderGraph::NONE ? graph.Texture(passBloom) : 0);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.Texture(input));
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+
+                glBindVertexArray(0);
+                glDepthMask(GL_TRUE);
+                glEnable(GL_DEPTH_TEST);
+                glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+            });
+            input = target;
+        }
+    }
+
+    // estimated bytes the passes read and write: the input once, every intermediate twice, the RGBA8 window once
+    size_t Traffic(size_t inputBytes) const
+    {
+        size_t passes = plan().size();
+        return inputBytes + (passes - 1) * 2 * (size_t) width * height * format->bytesPerPixel
+               + (size_t) outputWidth * outputHeight * 4;
+    }
+
+    // the passes the enabled stages compile to, with their fused stages
+    void DrawImGui() const
+    {
+        std::vector<std::vector<const Stage *>> passes = plan();
+        ImGui::Text("Post: %d prolaz(a), %d programa", (int) passes.size(), (int) programs.size());
+        for (size_t p = 0; p < passes.size(); p++) {
+            std::string names;
+            for (const Stage *stage : passes[p])
+                names += (names.empty() ? "" : " + ") + stage->name;
+            ImGui::Text("  %d: %s", (int) p, names.empty() ? "kopija" : names.c_str());
+        }
+    }
+
+private:
+    std::vector<Stage> stages;
+    // generated programs by their stage list
+    std::map<std::string, Shader> programs;
+    unsigned int emptyVAO = 0;
+    // of the last AddPasses()
+    int width = 1, height = 1, outputWidth = 1, outputHeight = 1;
+    const TargetFormat *format = &TargetFormat::Get(TargetFormat::RGBA16F);
+
+    bool enabled(const std::string &function) const
+    {
+        for (const Stage &stage : stages)
+            if (stage.function == function)
+                return stage.enabled;
+        return false;
+    }
+
+    // enabled stages split into passes, a neighborhood stage can't follow another one in the same pass
+    std::vector<std::vector<const Stage *>> plan() const
+    {
+        std::vector<std::vector<const Stage *>> passes(1);
+        bool neighborhood = false;
+        for (const Stage &stage : stages) {
+            if (!stage.enabled)
+                continue;
+            if (stage.kind == NEIGHBORHOOD) {
+                // the stages before it go through the intermediate target
+                if (neighborhood)
+                    passes.push_back(std::vector<const Stage *>());
+                neighborhood = true;
+            }
+            passes.back().push_back(&stage);
+        }
+        return passes;
+    }
+
+    Shader &program(const std::vector<const Stage *> &pass, bool upscale)
+    {
+        std::string key = upscale ? "Upscale " : "";
+        for (const Stage *stage : pass)
+            key += stage->function + " ";
+        auto found = programs.find(key);
+        if (found != programs.end())
+            return found->second;
+
+        std::string vertexCode = Shader::ReadFile("resources/shaders/fullscreen.vs");
+        std::string fragmentCode = generate(pass, upscale);
+        ProgramBinaryCache &cache = ProgramBinaryCache::Get();
+        std::string cacheKey = cache.Key(vertexCode + '\0' + fragmentCode + '\0');
+        unsigned int id = cache.Load(cacheKey);
+        if (!id) {
+            id = Shader::Link(vertexCode, fragmentCode);
+            GLint linked = 0;
+            glGetProgramiv(id, GL_LINK_STATUS, &linked);
+            if (linked)
+                cache.Store(cacheKey, id);
+            else
+                std::cout << "PostChain: generated shader for [" << key << "] doesn't link:\n" << fragmentCode << std::endl;
+        }
+        Shader &shader = programs.emplace(key, Shader(id)).first->second;
+        shader.use();
+        shader.setInt("source", 0);
+        shader.setInt("bloomBlur", BLOOM_UNIT);
+        shader.setInt("colorLut", LUT_UNIT);
+        return shader;
+    }
+
+    // main() calls the stages in order; FETCH of a neighborhood stage evaluates the stages before it at another uv.
+    // An upscaling pass reads the input through Upscale() instead of a bilinear texture().
+    static std::string generate(const std::vector<const Stage *> &pass, bool upscale)
+    {
+        std::string code = "#version 330 core\n"
+                           "// generated by PostChain\n"
+                           "layout (location = 0) out vec4 FragColor;\n"
+                           "in vec2 TexCoords;\n"
+                           "uniform sampler2D source;\n"
+                           "uniform vec2 sourceTexel;\n\n";
+        std::string chain = "texture(source, uv).rgb";
+        if (upscale) {
+            code += Shader::ReadFile("resources/shaders/post/Upscale.glsl") + "\n\n";
+            chain = "Upscale(uv)";
+        }
+        for (size_t i = 0; i < pass.size(); i++) {
+            const Stage &stage = *pass[i];
+            if (stage.kind == NEIGHBORHOOD) {
+                code += "vec3 Fetch" + std::to_string(i) + "(vec2 uv)\n{\n    return " + chain + ";\n}\n";
+                code += "#define FETCH(uv) Fetch" + std::to_string(i) + "(uv)\n";
+            }
+            code += Shader::ReadFile(("resources/shaders/post/" + stage.function + ".glsl").c_str()) + "\n";
+            if (stage.kind == NEIGHBORHOOD)
+                code += "#undef FETCH\n";
+            chain = stage.kind == NEIGHBORHOOD ? stage.function + "(" + chain + ", uv, sourceTexel)"
+                                               : stage.function + "(" + chain + ", uv)";
+            code += "\n";
+        }
+        code += "void main()\n{\n    vec2 uv = TexCoords;\n    FragColor = vec4(" + chain + ", 1.0);\n}\n";
+        return code;
+    }
+};
+
+#endif
@@ -0,0 +1,530 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/target_format.h>
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The screen sized passes of a frame as a graph of passes and the textures they read and write.
+// Every frame the passes are declared again with AddPass(), their resources either imported (textures owned
+// elsewhere, like the scene color or the TAA history, and the window) or created as transient textures the graph
+// owns. Execute() then
+// - culls every pass whose results nothing uses: a pass stays only if it has a side effect, writes an imported
+//   resource or writes something a pass that stays reads (disabling the bloom stage of the post chain leaves
+//   the bloom passes without a reader, so they don't run),
+// - orders the passes by their producer -> consumer dependencies (declaration order where they don't depend on
+//   each other),
+// - gives every transient a pooled texture for the passes between its first and last use. A texture whose
+//   resource is done is free for a later resource of the same size and format in the same frame, so
+//   resources with non-overlapping lifetimes share memory, and the pool persists across frames so nothing is
+//   allocated in a steady state. Textures unused for POOL_FRAMES frames are deleted.
+// - clears a transient before its first write when it was created with clear, otherwise invalidates it (its
+//   old contents are don't-care), and invalidates it again after its last read so a tiler doesn't write it back.
+//   Invalidation needs glInvalidateFramebuffer (GL 4.3 / ARB_invalidate_subdata), without it only the clears run.
+class RenderGraph
+{
+public:
+    typedef int Resource;
+    static const Resource NONE = -1;
+    static const int POOL_FRAMES = 120;
+
+    // load looks up glInvalidateFramebuffer (e.g. glfwGetProcAddress) when the context has it
+    explicit RenderGraph(GLADloadproc load = nullptr)
+    {
+        if (load && supportsInvalidate())
+            invalidateFramebuffer = (InvalidateFramebufferProc) load("glInvalidateFramebuffer");
+    }
+
+    ~RenderGraph()
+    {
+        for (PooledTexture &texture : pool)
+            release(texture);
+    }
+
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    // drops the passes and resources of the last frame, the pooled textures stay
+    void Reset()
+    {
+        resources.clear();
+        passes.clear();
+        order.clear();
+        frame++;
+    }
+
+    // a texture owned elsewhere; framebuffer, if any, is what BindTarget() binds to write it
+    Resource Import(const std::string &name, unsigned int texture, int width, int height,
+                    unsigned int framebuffer = 0)
+    {
+        ResourceInfo resource;
+        resource.name = name;
+        resource.width = width;
+        resource.height = height;
+        resource.imported = true;
+        resource.texture = texture;
+        resource.framebuffer = framebuffer;
+        resources.push_back(resource);
+        return (Resource) resources.size() - 1;
+    }
+
+    // the default framebuffer
+    Resource Backbuffer(int width, int height)
+    {
+        return Import("Prozor", 0, width, height, 0);
+    }
+
+    Resource Create(const std::string &name, int width, int height, const TargetFormat &format, bool clear = false)
+    {
+        ResourceInfo resource;
+        resource.name = name;
+        resource.width = width;
+        resource.height = height;
+        resource.format = &format;
+        resource.clear = clear;
+        resources.push_back(resource);
+        return (Resource) resources.size() - 1;
+    }
+
+    // execute() runs when the pass isn't culled; a pass with a side effect (e.g. a readback) is never culled
+    void AddPass(const std::string &name, const std::vector<Resource> &reads, const std::vector<Resource> &writes,
+                 const std::function<void()> &execute, bool sideEffect = false)
+    {
+        PassInfo pass;
+        pass.name = name;
+        pass.execute = execute;
+        pass.sideEffect = sideEffect;
+        for (Resource resource : reads)
+            if (resource != NONE)
+                pass.reads.push_back(resource);
+        for (Resource resource : writes)
+            if (resource != NONE)
+                pass.writes.push_back(resource);
+        passes.push_back(pass);
+    }
+
+    // culls and orders the declared passes without touching GL, returns Unordered()
+    int Schedule()
+    {
+        cull();
+        sort();
+        return unordered;
+    }
+
+    void Execute(GpuProfiler &profiler)
+    {
+        Schedule();
+        allocate();
+
+        for (size_t step = 0; step < order.size(); step++) {
+            PassInfo &pass = passes[order[step]];
+            for (Resource resource : pass.writes) {
+                ResourceInfo &info = resources[resource];
+                if (info.imported || info.first != (int) step)
+                    continue;
+                if (info.clear) {
+                    BindTarget(resource);
+                    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+                    glClear(GL_COLOR_BUFFER_BIT);
+                } else {
+                    invalidate(info);
+                }
+            }
+
+            profiler.Begin(pass.name);
+            pass.execute();
+            profiler.End();
+
+            for (Resource resource : pass.reads) {
+                ResourceInfo &info = resources[resource];
+                if (!info.imported && info.last == (int) step)
+                    invalidate(info);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // for the passes while they execute
+    unsigned int Texture(Resource resource) const
+    {
+        return resources[resource].texture;
+    }
+
+    int Width(Resource resource) const
+    {
+        return resources[resource].width;
+    }
+
+    int Height(Resource resource) const
+    {
+        return resources[resource].height;
+    }
+
+    // binds the resource as the render target with a viewport over all of it
+    void BindTarget(Resource resource) const
+    {
+        const ResourceInfo &info = resources[resource];
+        glBindFramebuffer(GL_FRAMEBUFFER, info.framebuffer);
+        glViewport(0, 0, info.width, info.height);
+    }
+
+    // passes of the last frame that were in a dependency cycle, 0 for a well formed graph
+    int Unordered() const
+    {
+        return unordered;
+    }
+
+    // bytes of every transient as if each had its own texture
+    size_t VirtualBytes() const
+    {
+        size_t bytes = 0;
+        for (const ResourceInfo &resource : resources)
+            if (!resource.imported && resource.first >= 0)
+                bytes += bytesOf(resource.width, resource.height, resource.format);
+        return bytes;
+    }
+
+    // bytes of the pooled textures the last frame used
+    size_t PhysicalBytes() const
+    {
+        size_t bytes = 0;
+        for (const PooledTexture &texture : pool)
+            if (texture.lastFrame == frame)
+                bytes += bytesOf(texture.width, texture.height, texture.format);
+        return bytes;
+    }
+
+    size_t PoolBytes() const
+    {
+        size_t bytes = 0;
+        for (const PooledTexture &texture : pool)
+            bytes += bytesOf(texture.width, texture.height, texture.format);
+        return bytes;
+    }
+
+    // the last executed frame: passes in their order, the culled ones, the resources and where they lived
+    std::string Dump() const
+    {
+        std::ostringstream out;
+        out << "Render graph, " << order.size() << " of " << passes.size() << " passes"
+            << (invalidateFramebuffer ? "" : ", no invalidation") << '\n';
+        for (size_t step = 0; step < order.size(); step++) {
+            const PassInfo &pass = passes[order[step]];
+            out << "  " << step << ' ' << pass.name << (pass.sideEffect ? " (side effect)" : "") << "\n    reads:";
+            for (Resource resource : pass.reads)
+                out << ' ' << resources[resource].name;
+            out << "\n    writes:";
+            for (Resource resource : pass.writes)
+                out << ' ' << resources[resource].name;
+            out << '\n';
+        }
+        for (const PassInfo &pass : passes)
+            if (!pass.alive)
+                out << "  culled " << pass.name << '\n';
+        if (unordered)
+            out << "  " << unordered << " passes in a dependency cycle, run in declaration order\n";
+        for (const ResourceInfo &resource : resources) {
+            out << "  " << resource.name << ' ' << resource.width << 'x' << resource.height;
+            if (resource.imported)
+                out << " imported\n";
+            else if (resource.first < 0)
+                out << ' ' << resource.format->name << " unused\n";
+            else
+                out << ' ' << resource.format->name << ' ' << bytesOf(resource.width, resource.height, resource.format)
+                    / 1024 << " KB, passes " << resource.first << '-' << resource.last << ", texture #"
+                    << resource.physical << (resource.clear ? ", cleared" : "") << '\n';
+        }
+        size_t virtualBytes = VirtualBytes(), physicalBytes = PhysicalBytes();
+        out << "  transient " << virtualBytes / 1024 << " KB in " << physicalBytes / 1024 << " KB of textures, "
+            << "aliasing saves " << (virtualBytes - physicalBytes) / 1024 << " KB; pool " << pool.size()
+            << " textures, " << PoolBytes() / 1024 << " KB\n";
+        return out.str();
+    }
+
+    void DrawImGui() const
+    {
+        ImGui::Text("Graf: %d/%d prolaza, prolazni %.1f MB u %.1f MB tekstura (usteda %.1f MB), pool %.1f MB",
+                    (int) order.size(), (int) passes.size(), VirtualBytes() / (1024.0f * 1024.0f),
+                    PhysicalBytes() / (1024.0f * 1024.0f), (VirtualBytes() - PhysicalBytes()) / (1024.0f * 1024.0f),
+                    PoolBytes() / (1024.0f * 1024.0f));
+        if (unordered)
+            ImGui::Text("%d prolaza u ciklusu zavisnosti!", unordered);
+        if (ImGui::Button("Ispisi graf"))
+            std::cout << Dump() << std::flush;
+    }
+
+private:
+    typedef void (APIENTRYP InvalidateFramebufferProc)(GLenum target, GLsizei count, const GLenum *attachments);
+
+    struct ResourceInfo {
+        std::string name;
+        int width = 0, height = 0;
+        const TargetFormat *format = nullptr;
+        bool imported = false;
+        bool clear = false;
+        unsigned int texture = 0, framebuffer = 0;
+        // steps of the first and last pass that uses it, -1 when no pass does
+        int first = -1, last = -1;
+        // pool index
+        int physical = -1;
+    };
+
+    struct PassInfo {
+        std::string name;
+        std::vector<Resource> reads, writes;
+        std::function<void()> execute;
+        bool sideEffect = false;
+        bool alive = false;
+    };
+
+    struct PooledTexture {
+        unsigned int texture = 0, framebuffer = 0;
+        int width = 0, height = 0;
+        const TargetFormat *format = nullptr;
+        int lastFrame = 0;
+        // free again from this step of the frame on
+        int busyUntil = -1;
+    };
+
+    std::vector<ResourceInfo> resources;
+    std::vector<PassInfo> passes;
+    // indices of the passes that stay, in execution order
+    std::vector<int> order;
+    std::vector<PooledTexture> pool;
+    int frame = 0;
+    InvalidateFramebufferProc invalidateFramebuffer = nullptr;
+    // passes the last sort() couldn't order
+    int unordered = 0;
+
+    // a loader may hand out an entry point the context doesn't support, so ask the context
+    static bool supportsInvalidate()
+    {
+        GLint major = 0, minor = 0, extensions = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major > 4 || (major == 4 && minor >= 3))
+            return true;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+        for (GLint i = 0; i < extensions; i++) {
+            const char *name = (const char *) glGetStringi(GL_EXTENSIONS, i);
+            if (name && std::string(name) == "GL_ARB_invalidate_subdata")
+                return true;
+        }
+        return false;
+    }
+
+    static size_t bytesOf(int width, int height, const TargetFormat *format)
+    {
+        return (size_t) width * height * format->bytesPerPixel;
+    }
+
+    // backwards from the passes that have to run: whatever they read has to be written. Repeated until nothing
+    // changes, a consumer declared before its producer marks it alive on the next sweep.
+    void cull()
+    {
+        std::vector<bool> needed(resources.size(), false);
+        for (PassInfo &pass : passes)
+            pass.alive = pass.sideEffect;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int p = (int) passes.size() - 1; p >= 0; p--) {
+                PassInfo &pass = passes[p];
+                bool alive = pass.alive;
+                for (Resource resource : pass.writes)
+                    if (resources[resource].imported || needed[resource])
+                        alive = true;
+                if (!alive)
+                    continue;
+                pass.alive = true;
+                for (Resource resource : pass.reads) {
+                    changed = changed || !needed[resource];
+                    needed[resource] = true;
+                }
+            }
+        }
+    }
+
+    // Kahn's algorithm over producer -> consumer edges between the passes that stay, the lowest declared pass
+    // first. A read depends on the last pass declared before it that writes the resource; with no such pass it
+    // depends on the ones declared after it, so a consumer may be declared before its producer, unless the pass
+    // writes the resource itself (Bloom dole reads the levels it writes). A write waits for the earlier writer
+    // and the earlier readers of the resource. Passes left in a cycle run last, in declaration order, and are
+    // counted in Unordered().
+    void sort()
+    {
+        int count = (int) passes.size();
+        std::vector<std::vector<int>> next(count);
+        std::vector<int> incoming(count, 0);
+        std::vector<std::vector<int>> writers(resources.size());
+        for (int p = 0; p < count; p++)
+            if (passes[p].alive)
+                for (Resource resource : passes[p].writes)
+                    writers[resource].push_back(p);
+        std::vector<int> lastWriter(resources.size(), -1);
+        std::vector<std::vector<int>> readers(resources.size());
+        auto edge = [&](int from, int to) {
+            if (from >= 0 && from != to) {
+                next[from].push_back(to);
+                incoming[to]++;
+            }
+        };
+        for (int p = 0; p < count; p++) {
+            if (!passes[p].alive)
+                continue;
+            for (Resource resource : passes[p].reads) {
+                if (lastWriter[resource] >= 0) {
+                    edge(lastWriter[resource], p);
+                    readers[resource].push_back(p);
+                } else if (std::find(passes[p].writes.begin(), passes[p].writes.end(), resource)
+                           == passes[p].writes.end()) {
+                    if (writers[resource].empty() && !resources[resource].imported)
+                        std::cout << "RenderGraph: " << passes[p].name << " reads " << resources[resource].name
+                                  << " that nothing writes" << std::endl;
+                    for (int writer : writers[resource])
+                        edge(writer, p);
+                }
+            }
+            for (Resource resource : passes[p].writes) {
+                edge(lastWriter[resource], p);
+                for (int reader : readers[resource])
+                    edge(reader, p);
+                readers[resource].clear();
+                lastWriter[resource] = p;
+            }
+        }
+
+        order.clear();
+        std::vector<bool> ordered(count, false);
+        std::vector<int> ready;
+        for (int p = 0; p < count; p++)
+            if (passes[p].alive && incoming[p] == 0)
+                ready.push_back(p);
+        while (!ready.empty()) {
+            auto lowest = std::min_element(ready.begin(), ready.end());
+            int p = *lowest;
+            ready.erase(lowest);
+            order.push_back(p);
+            ordered[p] = true;
+            for (int to : next[p])
+                if (--incoming[to] == 0)
+                    ready.push_back(to);
+        }
+        int leftover = 0;
+        for (int p = 0; p < count; p++) {
+            if (passes[p].alive && !ordered[p]) {
+                // once when it starts, not every frame
+                if (unordered == 0)
+                    std::cout << "RenderGraph: " << passes[p].name
+                              << " is in a dependency cycle, run in declaration order" << std::endl;
+                order.push_back(p);
+                leftover++;
+            }
+        }
+        unordered = leftover;
+    }
+
+    // lifetimes in execution steps, then pooled textures for them
+    void allocate()
+    {
+        trim();
+        for (size_t step = 0; step < order.size(); step++) {
+            const PassInfo &pass = passes[order[step]];
+            for (const std::vector<Resource> *list : { &pass.reads, &pass.writes })
+                for (Resource resource : *list) {
+                    ResourceInfo &info = resources[resource];
+                    if (info.first < 0)
+                        info.first = (int) step;
+                    info.last = (int) step;
+                }
+        }
+        for (PooledTexture &texture : pool)
+            texture.busyUntil = -1;
+
+        for (size_t step = 0; step < order.size(); step++) {
+            for (ResourceInfo &info : resources) {
+                if (info.imported || info.first != (int) step)
+                    continue;
+                info.physical = acquire(info, (int) step);
+                PooledTexture &texture = pool[info.physical];
+                texture.busyUntil = info.last;
+                texture.lastFrame = frame;
+                info.texture = texture.texture;
+                info.framebuffer = texture.framebuffer;
+            }
+        }
+    }
+
+    // a free pooled texture of the same size and format, or a new one
+    int acquire(const ResourceInfo &info, int step)
+    {
+        for (size_t i = 0; i < pool.size(); i++) {
+            const PooledTexture &texture = pool[i];
+            if (texture.busyUntil < step && texture.width == info.width && texture.height == info.height
+                && texture.format->internalFormat == info.format->internalFormat)
+                return (int) i;
+        }
+        PooledTexture texture;
+        texture.width = info.width;
+        texture.height = info.height;
+        texture.format = info.format;
+        glGenTextures(1, &texture.texture);
+        glBindTexture(GL_TEXTURE_2D, texture.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, info.format->internalFormat, info.width, info.height, 0, info.format->format,
+                     info.format->type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &texture.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, texture.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Render graph " << info.name << " framebuffer is not complete!"
+                      << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        pool.push_back(texture);
+        return (int) pool.size() - 1;
+    }
+
+    void invalidate(const ResourceInfo &info) const
+    {
+        if (!invalidateFramebuffer)
+            return;
+        GLenum attachment = GL_COLOR_ATTACHMENT0;
+        glBindFramebuffer(GL_FRAMEBUFFER, info.framebuffer);
+        invalidateFramebuffer(GL_FRAMEBUFFER, 1, &attachment);
+    }
+
+    // textures of sizes or formats that went out of use, e.g. after a resize or a disabled effect
+    void trim()
+    {
+        for (size_t i = 0; i < pool.size();) {
+            if (frame - pool[i].lastFrame > POOL_FRAMES) {
+                release(pool[i]);
+                pool.erase(pool.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    static void release(PooledTexture &texture)
+    {
+        glDeleteFramebuffers(1, &texture.framebuffer);
+        glDeleteTextures(1, &texture.texture);
+    }
+};
+
+#endif
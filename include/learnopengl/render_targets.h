@@ -0,0 +1,241 @@
+#ifndef RENDER_TARGETS_H
+#define RENDER_TARGETS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/target_format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+// Size of everything the frame renders into, and the scene framebuffer itself.
+// The window's framebuffer size is the output, the scene is rendered at output * scale and the last post pass
+// scales it back up, so a weaker machine can render fewer pixels than the window has. A new window size or
+// scale is only applied once it hasn't changed for DEBOUNCE seconds, so dragging the window edge doesn't
+// reallocate every target on every mouse move; until then the frame keeps rendering at the old size.
+// Everything else with screen sized targets registers with OnResize() and is reallocated together, also when
+// the color format of a target changes (SetFormat(), applied on the next Update() without waiting).
+class RenderTargets
+{
+public:
+    static constexpr double DEBOUNCE = 0.2;
+    static constexpr float MIN_SCALE = 0.25f;
+
+    // the color targets with a selectable format
+    enum Target {
+        SCENE,
+        BLOOM,
+        POST,
+        TAA_HISTORY,
+        TARGET_COUNT
+    };
+
+    unsigned int framebuffer = 0;
+    // HDR scene color, the bloom and the post chain read it
+    unsigned int colorBuffer = 0;
+    // DEPTH24_STENCIL8 texture, the TAA velocity pass reconstructs positions from it
+    unsigned int depthStencil = 0;
+
+    RenderTargets(int windowWidth, int windowHeight, float scale, const int (&targetFormats)[TARGET_COUNT])
+        : outputWidth(windowWidth), outputHeight(windowHeight), scale(clampScale(scale)),
+          pendingWidth(windowWidth), pendingHeight(windowHeight), pendingScale(this->scale)
+    {
+        for (int i = 0; i < TARGET_COUNT; i++)
+            formats[i] = pendingFormats[i] = allowed((Target) i, targetFormats[i]);
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &colorBuffer);
+        glGenTextures(1, &depthStencil);
+        allocate();
+    }
+
+    ~RenderTargets()
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &colorBuffer);
+        glDeleteTextures(1, &depthStencil);
+    }
+
+    RenderTargets(const RenderTargets &) = delete;
+    RenderTargets &operator=(const RenderTargets &) = delete;
+
+    // resize(renderWidth, renderHeight, outputWidth, outputHeight) runs on every reallocation
+    void OnResize(const std::function<void(int, int, int, int)> &resize)
+    {
+        listeners.push_back(resize);
+        resize(width, height, outputWidth, outputHeight);
+    }
+
+    // from the GLFW framebuffer size callback, a minimized window (0 x 0) keeps the old targets
+    void SetWindowSize(int newWidth, int newHeight, double time)
+    {
+        if (newWidth <= 0 || newHeight <= 0 || (newWidth == pendingWidth && newHeight == pendingHeight))
+            return;
+        pendingWidth = newWidth;
+        pendingHeight = newHeight;
+        changedAt = time;
+    }
+
+    void SetScale(float newScale, double time)
+    {
+        newScale = clampScale(newScale);
+        if (newScale == pendingScale)
+            return;
+        pendingScale = newScale;
+        changedAt = time;
+    }
+
+    // a TargetFormat::Id for `target`, one it doesn't allow falls back to RGBA16F
+    void SetFormat(Target target, int format)
+    {
+        pendingFormats[target] = allowed(target, format);
+    }
+
+    // RGBA8 clamps to [0, 1], only the post chain intermediates may hold tone mapped colors. The scene and the
+    // bloom are HDR and the TAA history is blended in HDR (Compress/Expand in taaResolve.fs need the range).
+    static bool Allows(Target target, int format)
+    {
+        return format >= 0 && format < TargetFormat::COUNT && (format != TargetFormat::RGBA8 || target == POST);
+    }
+
+    const TargetFormat &Format(Target target) const
+    {
+        return TargetFormat::Get(formats[target]);
+    }
+
+    static const char *Name(Target target)
+    {
+        static const char *names[TARGET_COUNT] = { "Scena", "Bloom", "Post", "TAA istorija" };
+        return names[target];
+    }
+
+    // once per frame before rendering, reallocates when a change has settled; true when it did
+    bool Update(double time)
+    {
+        bool formatChanged = !std::equal(formats, formats + TARGET_COUNT, pendingFormats);
+        bool sizeSettled = (pendingWidth != outputWidth || pendingHeight != outputHeight || pendingScale != scale)
+                           && time - changedAt >= DEBOUNCE;
+        if (!formatChanged && !sizeSettled)
+            return false;
+        if (sizeSettled) {
+            outputWidth = pendingWidth;
+            outputHeight = pendingHeight;
+            scale = pendingScale;
+        }
+        std::copy(pendingFormats, pendingFormats + TARGET_COUNT, formats);
+        allocate();
+        for (auto &listener : listeners)
+            listener(width, height, outputWidth, outputHeight);
+        return true;
+    }
+
+    // binds the scene framebuffer with a viewport over all of it
+    void Bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // internal render resolution
+    int Width() const
+    {
+        return width;
+    }
+
+    int Height() const
+    {
+        return height;
+    }
+
+    int OutputWidth() const
+    {
+        return outputWidth;
+    }
+
+    int OutputHeight() const
+    {
+        return outputHeight;
+    }
+
+    float Scale() const
+    {
+        return scale;
+    }
+
+    // of the window, the render size rounds to whole pixels
+    float Aspect() const
+    {
+        return (float) outputWidth / (float) outputHeight;
+    }
+
+    // scene color and depth
+    size_t Bytes() const
+    {
+        return (size_t) width * height * (Format(SCENE).bytesPerPixel + 4);
+    }
+
+    int Allocations() const
+    {
+        return allocations;
+    }
+
+private:
+    std::vector<std::function<void(int, int, int, int)>> listeners;
+    int width = 0, height = 0;
+    int outputWidth, outputHeight;
+    float scale;
+    int pendingWidth, pendingHeight;
+    float pendingScale;
+    double changedAt = 0.0;
+    int formats[TARGET_COUNT], pendingFormats[TARGET_COUNT];
+    int allocations = 0;
+
+    static int allowed(Target target, int format)
+    {
+        return Allows(target, format) ? format : TargetFormat::RGBA16F;
+    }
+
+    static float clampScale(float value)
+    {
+        return value < MIN_SCALE ? MIN_SCALE : (value > 1.0f ? 1.0f : value);
+    }
+
+    void allocate()
+    {
+        width = std::max(1, (int) std::lround(outputWidth * scale));
+        height = std::max(1, (int) std::lround(outputHeight * scale));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        // one color buffer, the bloom takes its bright parts straight from it ("Bloom prag" in Bloom::AddPasses())
+        glBindTexture(GL_TEXTURE_2D, colorBuffer);
+        const TargetFormat &color = Format(SCENE);
+        glTexImage2D(GL_TEXTURE_2D, 0, color.internalFormat, width, height, 0, color.format, color.type, NULL);
+        // linear, the last post pass upscales it to the window
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // clamped as the bloom filters would otherwise sample repeated texture values
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorBuffer, 0);
+
+        glBindTexture(GL_TEXTURE_2D, depthStencil);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL,
+                     GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthStencil, 0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Scene framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        allocations++;
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef RESOLUTION_BENCHMARK_H
+#define RESOLUTION_BENCHMARK_H
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Frame time with and without dynamic resolution under the same varying load.
+// The load is the point light count swinging between minLights and maxLights over periodFrames frames. The
+// FIXED phase renders at scale 1, the DYNAMIC phase lets DynamicResolution pick the scale; both run warmupFrames
+// unmeasured frames and then framesPerPhase frames, and compare the GPU frame time spread and how often the
+// target was missed.
+class ResolutionBenchmark
+{
+public:
+    enum Phase {
+        FIXED,
+        DYNAMIC,
+        DONE
+    };
+
+    int warmupFrames = 60;
+    int framesPerPhase = 900;
+    int periodFrames = 300;
+    int minLights = 16;
+
+    struct Result {
+        const char *name;
+        float mean;
+        float deviation;
+        float worst;
+        // fraction of the samples over the target
+        float missed;
+        float scale;
+    };
+    std::vector<Result> results;
+
+    void Start(int maxLightCount)
+    {
+        maxLights = std::max(minLights, maxLightCount);
+        results.clear();
+        phase = FIXED;
+        frame = 0;
+        samples.clear();
+        scaleSum = 0.0f;
+    }
+
+    bool Running() const
+    {
+        return phase != DONE;
+    }
+
+    Phase Current() const
+    {
+        return phase;
+    }
+
+    // the light count of the load this frame
+    int LightCount() const
+    {
+        float swing = 0.5f - 0.5f * std::cos(frame * 6.2831853f / periodFrames);
+        return minLights + (int) (swing * (maxLights - minLights));
+    }
+
+    // call once per frame while running; `fresh` when frameMilliseconds is a new GPU sample
+    void Record(bool fresh, float frameMilliseconds, float scale, float targetMilliseconds)
+    {
+        frame++;
+        if (frame <= warmupFrames)
+            return;
+        if (fresh) {
+            samples.push_back(frameMilliseconds);
+            scaleSum += scale;
+        }
+        if (frame < warmupFrames + framesPerPhase)
+            return;
+
+        results.push_back(summarize(phase == FIXED ? "fiksna" : "dinamicka", targetMilliseconds));
+        samples.clear();
+        scaleSum = 0.0f;
+        frame = 0;
+        phase = phase == FIXED ? DYNAMIC : DONE;
+        if (phase == DONE)
+            print(targetMilliseconds);
+    }
+
+    void DrawImGui()
+    {
+        if (Running())
+            ImGui::Text("Benchmark: %s rezolucija, %d svetala...", phase == FIXED ? "fiksna" : "dinamicka",
+                        LightCount());
+        if (results.empty())
+            return;
+        ImGui::Text("%10s %9s %9s %9s %8s %6s", "", "prosek", "std.dev", "max", "promasaj", "skala");
+        for (const Result &result : results)
+            ImGui::Text("%10s %6.2f ms %6.2f ms %6.2f ms %7.1f%% %6.2f", result.name, result.mean, result.deviation,
+                        result.worst, result.missed * 100.0f, result.scale);
+    }
+
+private:
+    Phase phase = DONE;
+    int frame = 0;
+    int maxLights = 0;
+    std::vector<float> samples;
+    float scaleSum = 0.0f;
+
+    Result summarize(const char *name, float targetMilliseconds) const
+    {
+        Result result{ name, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        if (samples.empty())
+            return result;
+        for (float sample : samples) {
+            result.mean += sample;
+            result.worst = std::max(result.worst, sample);
+            if (sample > targetMilliseconds)
+                result.missed += 1.0f;
+        }
+        result.mean /= samples.size();
+        for (float sample : samples)
+            result.deviation += (sample - result.mean) * (sample - result.mean);
+        result.deviation = std::sqrt(result.deviation / samples.size());
+        result.missed /= samples.size();
+        result.scale = scaleSum / samples.size();
+        return result;
+    }
+
+    void print(float targetMilliseconds) const
+    {
+        std::cout << "Dynamic resolution benchmark, target " << targetMilliseconds << " ms, " << minLights << " - "
+                  << maxLights << " lights\n"
+                  << "resolution  mean(ms)  deviation(ms)  worst(ms)  missed  scale\n";
+        for (const Result &result : results)
+            std::cout << result.name << '\t' << result.mean << '\t' << result.deviation << '\t' << result.worst
+                      << '\t' << result.missed << '\t' << result.scale << '\n';
+        std::cout << std::flush;
+    }
+};
+
+#endif
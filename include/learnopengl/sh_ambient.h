@@ -0,0 +1,354 @@
+#ifndef SH_AMBIENT_H
+#define SH_AMBIENT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define SH_AMBIENT_SSE
+#endif
+
+// Image based ambient from the skybox: the six cubemap faces are projected onto the 9 coefficients of L2 spherical
+// harmonics, convolved with the cosine lobe and divided by pi, so evaluating them at a normal gives the diffuse
+// ambient light directly (EvalSH() in shared.glsl). Texels are treated as linear radiance, the same way the skybox
+// itself goes through the HDR pass.
+// The projection runs over all face rows on the thread pool, four texels at a time with SSE where available. Results are cached
+// next to the faces in ambient_sh.txt and reused while the face files keep their size and modification time.
+class SkyboxAmbient
+{
+public:
+    // uniform block binding point of "AmbientSH"
+    static const unsigned int BINDING = 0;
+
+    struct Projection {
+        std::string directory;
+        glm::vec3 coefficients[9];
+        int texels = 0;
+        float decodeMilliseconds = 0.0f;
+        float projectMilliseconds = 0.0f;
+        bool fromCache = false;
+    };
+
+    explicit SkyboxAmbient(ThreadPool &pool) : pool(pool)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, BLOCK_SIZE, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+    }
+
+    ~SkyboxAmbient()
+    {
+        glDeleteBuffers(1, &ubo);
+    }
+
+    // coefficients of the skybox in directory (px.png ... nz.png), from the cache unless reproject is set
+    Projection Load(const std::string &directory, bool reproject = false)
+    {
+        Projection projection;
+        projection.directory = directory;
+        std::string signature = filesSignature(directory);
+        if (!reproject && readCache(directory, signature, projection))
+            return projection;
+
+        project(directory, projection);
+        writeCache(directory, signature, projection);
+        return projection;
+    }
+
+    // coefficients from the cache only, false if the skybox was never projected or its faces changed since
+    static bool ReadCached(const std::string &directory, Projection &projection)
+    {
+        projection.directory = directory;
+        return readCache(directory, filesSignature(directory), projection);
+    }
+
+    // weight blends between the flat ambient (0) and the harmonics (1) in the shaders without permutations
+    void Upload(const Projection &projection, float intensity, float weight)
+    {
+        float block[BLOCK_SIZE / sizeof(float)] = {};
+        for (int i = 0; i < 9; i++) {
+            block[i * 4] = projection.coefficients[i].r;
+            block[i * 4 + 1] = projection.coefficients[i].g;
+            block[i * 4 + 2] = projection.coefficients[i].b;
+        }
+        block[36] = intensity;
+        block[37] = weight;
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, BLOCK_SIZE, block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // the 9 L2 basis functions at a unit direction, in the order of the coefficients (and of EvalSH())
+    static void Basis(const glm::vec3 &direction, float basis[9])
+    {
+        basis[0] = 0.282095f;
+        basis[1] = 0.488603f * direction.y;
+        basis[2] = 0.488603f * direction.z;
+        basis[3] = 0.488603f * direction.x;
+        basis[4] = 1.092548f * direction.x * direction.y;
+        basis[5] = 1.092548f * direction.y * direction.z;
+        basis[6] = 0.315392f * (3.0f * direction.z * direction.z - 1.0f);
+        basis[7] = 1.092548f * direction.x * direction.z;
+        basis[8] = 0.546274f * (direction.x * direction.x - direction.y * direction.y);
+    }
+
+    // points the program's AmbientSH block at BINDING, programs without the block are left alone
+    static void BindBlock(const Shader &shader)
+    {
+        unsigned int index = glGetUniformBlockIndex(shader.ID, "AmbientSH");
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.ID, index, BINDING);
+    }
+
+private:
+    // std140: vec4 shCoefficients[9]; vec4 shParams;
+    static const int BLOCK_SIZE = 10 * 4 * sizeof(float);
+    static const int CACHE_VERSION = 1;
+
+    ThreadPool &pool;
+    unsigned int ubo = 0;
+
+    // running sum of a row worker, four lanes with SSE
+#ifdef SH_AMBIENT_SSE
+    typedef __m128 Accumulator;
+#else
+    typedef float Accumulator;
+#endif
+
+    struct Face {
+        unsigned char *data = nullptr;
+        int size = 0;
+        // direction = major + sc * uAxis + tc * vAxis, OpenGL cubemap face orientation
+        glm::vec3 major, uAxis, vAxis;
+    };
+
+    static const char *faceName(int face)
+    {
+        static const char *names[6] = { "px", "nx", "py", "ny", "pz", "nz" };
+        return names[face];
+    }
+
+    void project(const std::string &directory, Projection &projection)
+    {
+        typedef std::chrono::high_resolution_clock Clock;
+        static const glm::vec3 axes[6][3] = {
+            { glm::vec3(1, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0) },
+            { glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, -1, 0) },
+            { glm::vec3(0, 1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1) },
+            { glm::vec3(0, -1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, -1) },
+            { glm::vec3(0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(0, -1, 0) },
+            { glm::vec3(0, 0, -1), glm::vec3(-1, 0, 0), glm::vec3(0, -1, 0) },
+        };
+
+        Clock::time_point start = Clock::now();
+        Face faces[6];
+        pool.ParallelFor(6, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                int width, height, channels;
+                std::string path = directory + "/" + faceName(i) + ".png";
+                faces[i].data = stbi_load(path.c_str(), &width, &height, &channels, 4);
+                if (!faces[i].data || width != height) {
+                    std::cout << "ERROR::SH_AMBIENT:: can't use cubemap face " << path << std::endl;
+                    continue;
+                }
+                faces[i].size = width;
+                faces[i].major = axes[i][0];
+                faces[i].uAxis = axes[i][1];
+                faces[i].vAxis = axes[i][2];
+            }
+        });
+        Clock::time_point decoded = Clock::now();
+
+        // every face row is one item, rows of all faces are spread over the threads together
+        std::vector<int> rowStart(7, 0);
+        for (int i = 0; i < 6; i++)
+            rowStart[i + 1] = rowStart[i] + faces[i].size;
+        double sums[28] = {};
+        std::mutex sumsMutex;
+        pool.ParallelFor(rowStart[6], 32, [&](unsigned int begin, unsigned int end) {
+            Accumulator local[28];
+            for (Accumulator &sum : local)
+                sum = Accumulator();
+            for (unsigned int row = begin; row < end; row++) {
+                int face = 0;
+                while ((int) row >= rowStart[face + 1])
+                    face++;
+                if (faces[face].data)
+                    projectRow(faces[face], row - rowStart[face], local);
+            }
+            std::lock_guard<std::mutex> lock(sumsMutex);
+            for (int i = 0; i < 28; i++) {
+#ifdef SH_AMBIENT_SSE
+                float lanes[4];
+                _mm_storeu_ps(lanes, local[i]);
+                sums[i] += (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+                sums[i] += local[i];
+#endif
+            }
+        });
+        Clock::time_point projected = Clock::now();
+
+        for (Face &face : faces)
+            stbi_image_free(face.data);
+
+        // sums[27] is the total solid angle, which has to come out as 4 pi
+        const double PI = 3.14159265358979323846;
+        double normalization = sums[27] > 0.0 ? 4.0 * PI / sums[27] : 0.0;
+        // cosine lobe convolution per band (pi, 2pi/3, pi/4), divided by pi for a lambertian surface
+        static const double band[9] = { 1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25 };
+        for (int i = 0; i < 9; i++)
+            projection.coefficients[i] = glm::vec3(sums[i * 3], sums[i * 3 + 1], sums[i * 3 + 2])
+                                         * (float) (normalization * band[i]);
+        projection.texels = 0;
+        for (Face &face : faces)
+            projection.texels += face.size * face.size;
+        projection.decodeMilliseconds = std::chrono::duration<float, std::milli>(decoded - start).count();
+        projection.projectMilliseconds = std::chrono::duration<float, std::milli>(projected - decoded).count();
+        projection.fromCache = false;
+    }
+
+    // adds one row of a face to sums: 9 coefficients * rgb, then the solid angle
+    static void projectRow(const Face &face, int y, Accumulator *sums)
+    {
+        float texelSize = 2.0f / face.size;
+        float tc = (y + 0.5f) * texelSize - 1.0f;
+        glm::vec3 rowBase = face.major + tc * face.vAxis;
+#ifndef SH_AMBIENT_SSE
+        const unsigned char *pixel = face.data + (size_t) y * face.size * 4;
+        for (int x = 0; x < face.size; x++, pixel += 4) {
+            float sc = (x + 0.5f) * texelSize - 1.0f;
+            // direction and solid angle of the texel: dw ~ (1 + u^2 + v^2)^-3/2, the constant factor cancels
+            // in the normalization
+            glm::vec3 direction = rowBase + sc * face.uAxis;
+            float invLength = 1.0f / glm::length(direction);
+            float weight = invLength * invLength * invLength;
+            float basis[9];
+            Basis(direction * invLength, basis);
+            glm::vec3 color = glm::vec3(pixel[0], pixel[1], pixel[2]) * (weight / 255.0f);
+            for (int i = 0; i < 9; i++) {
+                sums[i * 3] += basis[i] * color.r;
+                sums[i * 3 + 1] += basis[i] * color.g;
+                sums[i * 3 + 2] += basis[i] * color.b;
+            }
+            sums[27] += weight;
+        }
+#else
+        const __m128 baseX = _mm_set1_ps(rowBase.x), baseY = _mm_set1_ps(rowBase.y), baseZ = _mm_set1_ps(rowBase.z);
+        const __m128 axisX = _mm_set1_ps(face.uAxis.x), axisY = _mm_set1_ps(face.uAxis.y), axisZ = _mm_set1_ps(face.uAxis.z);
+        const __m128 lengthSquaredBase = _mm_set1_ps(1.0f + tc * tc);
+        const __m128 one = _mm_set1_ps(1.0f), three = _mm_set1_ps(3.0f);
+        const __m128 c0 = _mm_set1_ps(0.282095f), c1 = _mm_set1_ps(0.488603f), c2 = _mm_set1_ps(1.092548f);
+        const __m128 c3 = _mm_set1_ps(0.315392f), c4 = _mm_set1_ps(0.546274f);
+        const unsigned char *pixels = face.data + (size_t) y * face.size * 4;
+
+        for (int x = 0; x < face.size; x += 4) {
+            float sc[4], r[4], g[4], b[4], valid[4];
+            for (int lane = 0; lane < 4; lane++) {
+                int px = x + lane;
+                bool inside = px < face.size;
+                const unsigned char *pixel = pixels + (inside ? px : face.size - 1) * 4;
+                sc[lane] = (px + 0.5f) * texelSize - 1.0f;
+                r[lane] = pixel[0] * (1.0f / 255.0f);
+                g[lane] = pixel[1] * (1.0f / 255.0f);
+                b[lane] = pixel[2] * (1.0f / 255.0f);
+                valid[lane] = inside ? 1.0f : 0.0f;
+            }
+            __m128 u = _mm_loadu_ps(sc);
+            // direction and solid angle of the texel: dw ~ (1 + u^2 + v^2)^-3/2, the constant factor cancels
+            // in the normalization
+            __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(lengthSquaredBase, _mm_mul_ps(u, u))));
+            __m128 weight = _mm_mul_ps(_mm_mul_ps(invLength, _mm_mul_ps(invLength, invLength)), _mm_loadu_ps(valid));
+            __m128 dx = _mm_mul_ps(_mm_add_ps(baseX, _mm_mul_ps(u, axisX)), invLength);
+            __m128 dy = _mm_mul_ps(_mm_add_ps(baseY, _mm_mul_ps(u, axisY)), invLength);
+            __m128 dz = _mm_mul_ps(_mm_add_ps(baseZ, _mm_mul_ps(u, axisZ)), invLength);
+
+            __m128 basis[9];
+            basis[0] = c0;
+            basis[1] = _mm_mul_ps(c1, dy);
+            basis[2] = _mm_mul_ps(c1, dz);
+            basis[3] = _mm_mul_ps(c1, dx);
+            basis[4] = _mm_mul_ps(c2, _mm_mul_ps(dx, dy));
+            basis[5] = _mm_mul_ps(c2, _mm_mul_ps(dy, dz));
+            basis[6] = _mm_mul_ps(c3, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(dz, dz)), one));
+            basis[7] = _mm_mul_ps(c2, _mm_mul_ps(dx, dz));
+            basis[8] = _mm_mul_ps(c4, _mm_sub_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+            __m128 wr = _mm_mul_ps(weight, _mm_loadu_ps(r));
+            __m128 wg = _mm_mul_ps(weight, _mm_loadu_ps(g));
+            __m128 wb = _mm_mul_ps(weight, _mm_loadu_ps(b));
+            for (int i = 0; i < 9; i++) {
+                sums[i * 3] = _mm_add_ps(sums[i * 3], _mm_mul_ps(basis[i], wr));
+                sums[i * 3 + 1] = _mm_add_ps(sums[i * 3 + 1], _mm_mul_ps(basis[i], wg));
+                sums[i * 3 + 2] = _mm_add_ps(sums[i * 3 + 2], _mm_mul_ps(basis[i], wb));
+            }
+            sums[27] = _mm_add_ps(sums[27], weight);
+        }
+#endif
+    }
+
+    // changes whenever one of the face files is replaced
+    static std::string filesSignature(const std::string &directory)
+    {
+        std::ostringstream signature;
+        for (int i = 0; i < 6; i++) {
+            struct stat info;
+            std::string path = directory + "/" + faceName(i) + ".png";
+            if (stat(path.c_str(), &info) == 0)
+                signature << info.st_size << ':' << (long long) info.st_mtime << ' ';
+        }
+        return signature.str();
+    }
+
+    static std::string cachePath(const std::string &directory)
+    {
+        return directory + "/ambient_sh.txt";
+    }
+
+    static bool readCache(const std::string &directory, const std::string &signature, Projection &projection)
+    {
+        std::ifstream in(cachePath(directory));
+        int version = 0;
+        std::string cachedSignature;
+        if (!(in >> version) || version != CACHE_VERSION)
+            return false;
+        in.ignore();
+        if (!std::getline(in, cachedSignature) || cachedSignature != signature)
+            return false;
+        in >> projection.texels >> projection.decodeMilliseconds >> projection.projectMilliseconds;
+        for (glm::vec3 &coefficient : projection.coefficients)
+            in >> coefficient.r >> coefficient.g >> coefficient.b;
+        projection.fromCache = true;
+        return (bool) in;
+    }
+
+    static void writeCache(const std::string &directory, const std::string &signature, const Projection &projection)
+    {
+        std::ofstream out(cachePath(directory));
+        out << CACHE_VERSION << '\n'
+            << signature << '\n'
+            << projection.texels << ' ' << projection.decodeMilliseconds << ' ' << projection.projectMilliseconds << '\n';
+        for (const glm::vec3 &coefficient : projection.coefficients)
+            out << coefficient.r << ' ' << coefficient.g << ' ' << coefficient.b << '\n';
+    }
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -16,57 +17,81 @@ public:
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(vertexPath, fragmentPath, geometryPath, std::vector<std::string>())
+    {
+    }
+    // a permutation of the shader: a "#define <define>" line is put right after #version in every stage for each
+    // of the defines (e.g. "SPOT_LIGHT" or "EFFECT 2"), the fragment stage gets the functions of fragmentLibrary
+    // (e.g. resources/shaders/shared.glsl) after them
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath,
+           const std::vector<std::string> &defines, const char* fragmentLibrary = nullptr)
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+        std::string vertexCode = InjectDefines(ReadFile(vertexPath), defines);
+        std::string fragmentCode = InjectDefines(ReadFile(fragmentPath), defines,
+                                                 fragmentLibrary ? ReadFile(fragmentLibrary) : std::string());
+        // if geometry shader path is present, also load a geometry shader
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
+        if(geometryPath != nullptr)
+            geometryCode = InjectDefines(ReadFile(geometryPath), defines);
+        // 2. compile shaders
+        ID = Link(vertexCode, fragmentCode, geometryCode);
+    }
+    // wraps an already linked program
+    // ------------------------------------------------------------------------
+    explicit Shader(unsigned int program) : ID(program)
+    {
+    }
+    // ------------------------------------------------------------------------
+    static std::string ReadFile(const char* path)
+    {
+        std::ifstream file;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
         }
+        return std::string();
+    }
+    // ------------------------------------------------------------------------
+    // library is source put after the defines, so it sees them too
+    static std::string InjectDefines(const std::string &code, const std::vector<std::string> &defines,
+                                     const std::string &library = std::string())
+    {
+        if(defines.empty() && library.empty())
+            return code;
+        // #version has to stay the first line
+        size_t lineEnd = code.find('\n', code.find("#version"));
+        if(lineEnd == std::string::npos)
+            lineEnd = code.size();
+        std::string defineLines;
+        for(const std::string &define : defines)
+            defineLines += "#define " + define + "\n";
+        if(!library.empty())
+            defineLines += library + "\n";
+        std::string result = code.substr(0, lineEnd) + "\n" + defineLines;
+        if(lineEnd < code.size())
+            result += code.substr(lineEnd + 1);
+        return result;
+    }
+    // compiles the stages and links them, an empty geometryCode means no geometry shader
+    // ------------------------------------------------------------------------
+    static unsigned int Link(const std::string &vertexCode, const std::string &fragmentCode,
+                             const std::string &geometryCode = std::string())
+    {
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        bool hasGeometry = !geometryCode.empty();
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -80,7 +105,7 @@ public:
         checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
         unsigned int geometry;
-        if(geometryPath != nullptr)
+        if(hasGeometry)
         {
             const char * gShaderCode = geometryCode.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
@@ -89,19 +114,19 @@ public:
             checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if(hasGeometry)
+            glAttachShader(program, geometry);
+        glLinkProgram(program);
+        checkCompileErrors(program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if(geometryPath != nullptr)
+        if(hasGeometry)
             glDeleteShader(geometry);
-
+        return program;
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -171,7 +196,7 @@ public:
 private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
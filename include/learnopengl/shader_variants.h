@@ -0,0 +1,254 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/shader.h>
+
+#include "imgui.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+// Disk cache of linked program binaries, keyed by a hash of the final sources and the driver.
+// glad is generated for plain GL 3.3 core, so glGetProgramBinary/glProgramBinary are looked up through GLFW and
+// only used when the context has GL_ARB_get_program_binary; without it every permutation is compiled from source.
+// A binary the driver refuses (new driver, different GPU) is dropped and rebuilt from source.
+class ProgramBinaryCache
+{
+public:
+    static ProgramBinaryCache &Get()
+    {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    // call once after the GL context is current
+    void Init(const std::string &cacheDirectory)
+    {
+        directory = cacheDirectory;
+        if (glfwExtensionSupported("GL_ARB_get_program_binary")) {
+            getProgramBinary = (GetProgramBinaryProc) glfwGetProcAddress("glGetProgramBinary");
+            programBinary = (ProgramBinaryProc) glfwGetProcAddress("glProgramBinary");
+        }
+        if (!Available())
+            return;
+        mkdir(directory.c_str(), 0755);
+        // the same sources compile to different binaries on every driver
+        driver = std::string((const char *) glGetString(GL_VENDOR)) + (const char *) glGetString(GL_RENDERER)
+                 + (const char *) glGetString(GL_VERSION);
+    }
+
+    bool Available() const
+    {
+        return getProgramBinary && programBinary;
+    }
+
+    std::string Key(const std::string &sources) const
+    {
+        // FNV-1a, stable between runs unlike std::hash
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : driver + sources) {
+            hash ^= (unsigned char) c;
+            hash *= 1099511628211ull;
+        }
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+        return name;
+    }
+
+    // linked program from the cache, 0 on a miss
+    unsigned int Load(const std::string &key)
+    {
+        if (!Available())
+            return 0;
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file)
+            return 0;
+        GLenum format = 0;
+        file.read((char *) &format, sizeof(format));
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file.eof() || binary.empty())
+            return 0;
+
+        unsigned int program = glCreateProgram();
+        programBinary(program, format, &binary[0], binary.size());
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        loaded++;
+        return program;
+    }
+
+    void Store(const std::string &key, unsigned int program)
+    {
+        if (!Available())
+            return;
+        GLint length = 0;
+        glGetProgramiv(program, PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        getProgramBinary(program, length, nullptr, &format, &binary[0]);
+        std::ofstream file(path(key), std::ios::binary);
+        file.write((const char *) &format, sizeof(format));
+        file.write(&binary[0], binary.size());
+        stored++;
+    }
+
+    // programs that came from / went to the cache this run
+    int loaded = 0, stored = 0;
+
+private:
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void *, GLsizei);
+    static const GLenum PROGRAM_BINARY_LENGTH = 0x8741;
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    std::string directory;
+    std::string driver;
+
+    std::string path(const std::string &key) const
+    {
+        return directory + "/" + key + ".bin";
+    }
+};
+
+// Compile time permutations of one shader.
+// Get() takes a set of defines, compiles that permutation on first use (or loads it from the program binary cache)
+// and hands back the same Shader from then on. The renderer picks the defines from ProgramState every frame, so a
+// disabled light or effect is compiled out instead of branched over per pixel.
+class ShaderVariants
+{
+public:
+    // called once for every new permutation, for the uniforms that never change (sampler units)
+    std::function<void(Shader &)> onCreate;
+    // file with functions shared between shaders put after the defines of the fragment stage, set before the
+    // first Get()
+    std::string fragmentLibrary;
+
+    ShaderVariants(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath), geometryPath(geometryPath ? geometryPath : "")
+    {
+        all().push_back(this);
+    }
+
+    ~ShaderVariants()
+    {
+        for (auto &variant : variants)
+            glDeleteProgram(variant.second.shader.ID);
+        all().erase(std::find(all().begin(), all().end(), this));
+    }
+
+    ShaderVariants(const ShaderVariants &) = delete;
+    ShaderVariants &operator=(const ShaderVariants &) = delete;
+
+    Shader &Get(const std::vector<std::string> &defines)
+    {
+        std::string key = variantKey(defines);
+        auto found = variants.find(key);
+        if (found == variants.end()) {
+            found = variants.emplace(key, Variant{ build(defines), 0 }).first;
+            if (onCreate) {
+                found->second.shader.use();
+                onCreate(found->second.shader);
+            }
+        }
+        found->second.lastUsedFrame = currentFrame();
+        return found->second.shader;
+    }
+
+    // call once per frame, marks which permutations the overlay shows as in use
+    static void NextFrame()
+    {
+        currentFrame()++;
+    }
+
+    // every permutation built so far, the ones used this frame marked with *
+    static void DrawImGui()
+    {
+        ProgramBinaryCache &cache = ProgramBinaryCache::Get();
+        if (cache.Available())
+            ImGui::Text("Program binary cache: %d ucitano, %d sacuvano", cache.loaded, cache.stored);
+        else
+            ImGui::Text("Program binary cache: nije podrzan");
+        for (ShaderVariants *shader : all()) {
+            for (auto &variant : shader->variants) {
+                bool used = variant.second.lastUsedFrame == currentFrame();
+                ImGui::Text("%s %s [%s]", used ? "*" : " ", shader->fragmentPath.c_str(),
+                            variant.first.empty() ? "-" : variant.first.c_str());
+            }
+        }
+    }
+
+private:
+    struct Variant {
+        Shader shader;
+        unsigned long long lastUsedFrame;
+    };
+
+    std::string vertexPath, fragmentPath, geometryPath;
+    std::map<std::string, Variant> variants;
+
+    static unsigned long long &currentFrame()
+    {
+        static unsigned long long frame = 0;
+        return frame;
+    }
+
+    static std::vector<ShaderVariants *> &all()
+    {
+        static std::vector<ShaderVariants *> list;
+        return list;
+    }
+
+    // the same defines in any order are the same permutation
+    static std::string variantKey(std::vector<std::string> defines)
+    {
+        std::sort(defines.begin(), defines.end());
+        std::string key;
+        for (const std::string &define : defines)
+            key += (key.empty() ? "" : " ") + define;
+        return key;
+    }
+
+    Shader build(const std::vector<std::string> &defines)
+    {
+        std::string vertexCode = Shader::InjectDefines(Shader::ReadFile(vertexPath.c_str()), defines);
+        std::string fragmentCode = Shader::InjectDefines(Shader::ReadFile(fragmentPath.c_str()), defines,
+                                                         fragmentLibrary.empty() ? std::string()
+                                                         : Shader::ReadFile(fragmentLibrary.c_str()));
+        std::string geometryCode;
+        if (!geometryPath.empty())
+            geometryCode = Shader::InjectDefines(Shader::ReadFile(geometryPath.c_str()), defines);
+
+        ProgramBinaryCache &cache = ProgramBinaryCache::Get();
+        std::string cacheKey = cache.Key(vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+        unsigned int program = cache.Load(cacheKey);
+        if (!program) {
+            program = Shader::Link(vertexCode, fragmentCode, geometryCode);
+            GLint linked = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            if (linked)
+                cache.Store(cacheKey, program);
+        }
+        return Shader(program);
+    }
+};
+
+#endif
@@ -0,0 +1,274 @@
+#ifndef SSAO_H
+#define SSAO_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/deferred.h>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// Screen space ambient occlusion at half resolution.
+// The input is a half resolution view space normal + linear depth target: the forward path draws the static
+// geometry into it (BeginGeometryPass()), the deferred path takes one texel of every 2x2 block of the G-buffer
+// (DownsampleGBuffer()). Compute() runs the occlusion with a small hemisphere kernel rotated by a 4x4 noise tile,
+// then a separable depth aware blur; the result keeps the depth next to the occlusion (RG16F) so the lighting
+// shaders do a joint bilateral upsample against their own full resolution depth (UpsampleSSAO() in shared.glsl)
+// instead of a separate full resolution pass. Every pass has its own GpuProfiler scope.
+class Ssao
+{
+public:
+    static const int MAX_SAMPLES = 32;
+    static const int TEXTURE_UNIT = 13;
+    // linear depth of the pixels nothing was drawn to, never occluded (fits half floats)
+    static constexpr float EMPTY_DEPTH = 60000.0f;
+
+    int sampleCount = 16;
+    float radius = 0.5f;
+    float bias = 0.025f;
+    float power = 1.5f;
+    // relative depth difference at which the blur stops mixing taps
+    float sharpness = 0.1f;
+
+    Shader geometryShader;
+
+    Ssao(int width, int height)
+        : geometryShader("resources/shaders/ssaoGeometry.vs", "resources/shaders/ssaoGeometry.fs"),
+          downsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/ssaoDownsample.fs"),
+          ssaoShader("resources/shaders/fullscreen.vs", "resources/shaders/ssao.fs"),
+          blurShader("resources/shaders/fullscreen.vs", "resources/shaders/ssaoBlur.fs")
+    {
+        glGenFramebuffers(1, &normalDepthFBO);
+        glGenTextures(1, &normalDepth);
+        glGenRenderbuffers(1, &depthRBO);
+        glGenFramebuffers(2, aoFBO);
+        glGenTextures(2, ao);
+        glGenVertexArrays(1, &emptyVAO);
+        Resize(width, height);
+
+        // random rotations around the normal, tiled over the screen
+        std::default_random_engine generator(7);
+        std::uniform_real_distribution<float> random(-1.0f, 1.0f);
+        float rotations[16 * 2];
+        for (float &value : rotations)
+            value = random(generator);
+        glGenTextures(1, &noise);
+        glBindTexture(GL_TEXTURE_2D, noise);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, 4, 4, 0, GL_RG, GL_FLOAT, rotations);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        downsampleShader.use();
+        downsampleShader.setInt("gNormal", 0);
+        downsampleShader.setInt("gDepth", 1);
+        downsampleShader.setFloat("emptyDepth", EMPTY_DEPTH);
+        ssaoShader.use();
+        ssaoShader.setInt("normalDepth", 0);
+        ssaoShader.setInt("noise", 1);
+        ssaoShader.setFloat("emptyDepth", EMPTY_DEPTH);
+        blurShader.use();
+        blurShader.setInt("image", 0);
+    }
+
+    ~Ssao()
+    {
+        glDeleteFramebuffers(1, &normalDepthFBO);
+        glDeleteTextures(1, &normalDepth);
+        glDeleteRenderbuffers(1, &depthRBO);
+        glDeleteFramebuffers(2, aoFBO);
+        glDeleteTextures(2, ao);
+        glDeleteTextures(1, &noise);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    void Resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        halfWidth = std::max(1, (width + 1) / 2);
+        halfHeight = std::max(1, (height + 1) / 2);
+
+        allocate(normalDepth, GL_RGBA16F, GL_RGBA);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, halfWidth, halfHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, normalDepthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, normalDepth, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: SSAO normal/depth framebuffer is not complete!" << std::endl;
+
+        for (int i = 0; i < 2; i++) {
+            allocate(ao[i], GL_RG16F, GL_RG);
+            glBindFramebuffer(GL_FRAMEBUFFER, aoFBO[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ao[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: SSAO framebuffer is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // forward path: binds and clears the half resolution target, the caller draws the geometry with geometryShader
+    void BeginGeometryPass(const glm::mat4 &projection, const glm::mat4 &view)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, normalDepthFBO);
+        glViewport(0, 0, halfWidth, halfHeight);
+        glEnable(GL_DEPTH_TEST);
+        glClearColor(0.0f, 0.0f, 1.0f, EMPTY_DEPTH);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        geometryShader.use();
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
+    }
+
+    void EndGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+    }
+
+    // deferred path: the half resolution target from the G-buffer instead of drawing the geometry again
+    void DownsampleGBuffer(const DeferredRenderer &deferred, const glm::mat4 &view, float cameraNear, float cameraFar)
+    {
+        beginFullscreen(normalDepthFBO);
+        downsampleShader.use();
+        downsampleShader.setMat4("view", view);
+        downsampleShader.setFloat("cameraNear", cameraNear);
+        downsampleShader.setFloat("cameraFar", cameraFar);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, deferred.normals);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, deferred.depth);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        endFullscreen();
+    }
+
+    // occlusion and blur, fovY in radians
+    void Compute(GpuProfiler &profiler, const glm::mat4 &projection, float fovY, float aspect, float cameraNear,
+                 float cameraFar)
+    {
+        nearPlane = cameraNear;
+        farPlane = cameraFar;
+        sampleCount = std::max(1, std::min(sampleCount, MAX_SAMPLES));
+        if (sampleCount != kernelSize)
+            buildKernel();
+
+        profiler.Begin("SSAO");
+        beginFullscreen(aoFBO[0]);
+        ssaoShader.use();
+        ssaoShader.setMat4("projection", projection);
+        float tanHalfFov = std::tan(fovY * 0.5f);
+        ssaoShader.setVec2("viewRay", glm::vec2(tanHalfFov * aspect, tanHalfFov));
+        ssaoShader.setInt("sampleCount", sampleCount);
+        ssaoShader.setFloat("radius", radius);
+        ssaoShader.setFloat("bias", bias);
+        ssaoShader.setFloat("power", power);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, normalDepth);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, noise);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        endFullscreen();
+        profiler.End();
+
+        profiler.Begin("SSAO blur");
+        blurShader.use();
+        blurShader.setFloat("sharpness", sharpness);
+        for (int pass = 0; pass < 2; pass++) {
+            beginFullscreen(aoFBO[1 - pass]);
+            blurShader.setVec2("direction", pass == 0 ? glm::vec2(1.0f, 0.0f) : glm::vec2(0.0f, 1.0f));
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, ao[pass]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            endFullscreen();
+        }
+        profiler.End();
+    }
+
+    // the blurred occlusion for a lighting shader with the SSAO define
+    void Bind(Shader &shader) const
+    {
+        shader.setInt("ssaoTexture", TEXTURE_UNIT);
+        shader.setFloat("cameraNear", nearPlane);
+        shader.setFloat("cameraFar", farPlane);
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, ao[0]);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // normal/depth + two occlusion targets
+    size_t Bytes() const
+    {
+        return (size_t) halfWidth * halfHeight * (8 + 3 + 4 + 4);
+    }
+
+private:
+    Shader downsampleShader, ssaoShader, blurShader;
+    unsigned int normalDepthFBO = 0, normalDepth = 0, depthRBO = 0;
+    unsigned int aoFBO[2] = { 0, 0 }, ao[2] = { 0, 0 };
+    unsigned int noise = 0;
+    unsigned int emptyVAO = 0;
+    int width = 0, height = 0, halfWidth = 0, halfHeight = 0;
+    int kernelSize = 0;
+    float nearPlane = 0.1f, farPlane = 100.0f;
+    GLint polygonMode[2];
+
+    // samples in the +z hemisphere, denser close to the center where the occlusion matters most
+    void buildKernel()
+    {
+        std::default_random_engine generator(11);
+        std::uniform_real_distribution<float> random(0.0f, 1.0f);
+        ssaoShader.use();
+        for (int i = 0; i < sampleCount; i++) {
+            glm::vec3 sample(random(generator) * 2.0f - 1.0f, random(generator) * 2.0f - 1.0f, random(generator));
+            sample = glm::normalize(sample) * random(generator);
+            float scale = (float) i / sampleCount;
+            sample *= 0.1f + 0.9f * scale * scale;
+            ssaoShader.setVec3("samples[" + std::to_string(i) + "]", sample);
+        }
+        kernelSize = sampleCount;
+    }
+
+    void allocate(unsigned int texture, GLint internalFormat, GLenum format)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, halfWidth, halfHeight, 0, format, GL_FLOAT, NULL);
+        // read with texelFetch only
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // fullscreen triangle into a half resolution target, filled even in wireframe mode
+    void beginFullscreen(unsigned int fbo)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, halfWidth, halfHeight);
+        glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+    }
+
+    void endFullscreen()
+    {
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glActiveTexture(GL_TEXTURE0);
+    }
+};
+
+#endif
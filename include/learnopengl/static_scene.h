@@ -0,0 +1,70 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+// The models that never move (city, platform and the two bridges) and where they are placed.
+// Shared by drawCity() and the lightmap baker so a bake matches what the renderer draws.
+enum StaticModel {
+    STATIC_CITY,
+    STATIC_PLATFORM,
+    STATIC_BRIDGE,
+    STATIC_MODEL_COUNT
+};
+
+static const char *STATIC_MODEL_PATHS[STATIC_MODEL_COUNT] = {
+    "resources/objects/SH-Cartoon/SH-Cartoon.obj",
+    "resources/objects/StonePlatform_Obj/StonePlatform_B.obj",
+    "resources/objects/Stone_Bridge_Obj/Stone Bridge_Obj.obj",
+};
+
+struct StaticObject {
+    StaticModel model;
+    glm::mat4 transform;
+};
+
+// placement of every static object from the ProgramState settings (the defaults are what the baker uses)
+inline std::vector<StaticObject> StaticScene(glm::vec3 cityPosition = glm::vec3(0.0f), float cityScale = 1.0f,
+                                             glm::vec3 bridgePosition = glm::vec3(0.0f), float bridgeScale = 0.5f)
+{
+    std::vector<StaticObject> objects;
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, cityPosition);
+    model = glm::scale(model, glm::vec3(cityScale));
+    objects.push_back(StaticObject{ STATIC_CITY, model });
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, bridgePosition);
+    objects.push_back(StaticObject{ STATIC_PLATFORM, model });
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, bridgePosition + glm::vec3(-30.0f, -5.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(bridgeScale));
+    objects.push_back(StaticObject{ STATIC_BRIDGE, model });
+
+    model = glm::mat4(1.0f);
+    model = glm::translate(model, bridgePosition + glm::vec3(30.0f, -2.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(bridgeScale));
+    objects.push_back(StaticObject{ STATIC_BRIDGE, model });
+    return objects;
+}
+
+// world space box around an object from its model's local bounds
+inline void WorldBounds(const StaticObject &object, const glm::vec3 &localMin, const glm::vec3 &localMax,
+                        glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    boundsMin = glm::vec3(1e30f);
+    boundsMax = glm::vec3(-1e30f);
+    for (int c = 0; c < 8; c++) {
+        glm::vec3 corner((c & 1) ? localMax.x : localMin.x, (c & 2) ? localMax.y : localMin.y,
+                         (c & 4) ? localMax.z : localMin.z);
+        corner = glm::vec3(object.transform * glm::vec4(corner, 1.0f));
+        boundsMin = glm::min(boundsMin, corner);
+        boundsMax = glm::max(boundsMax, corner);
+    }
+}
+
+#endif
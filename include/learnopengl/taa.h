@@ -0,0 +1,300 @@
+#ifndef TAA_H
+#define TAA_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/render_graph.h>
+#include <learnopengl/target_format.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+
+// Temporal anti-aliasing: every frame renders with the projection moved by a different sub-pixel offset
+// (Halton 2,3) and the frames are accumulated in a history buffer.
+// The velocity pass writes, per pixel, where it was on screen the frame before: the camera motion comes from
+// the scene depth reprojected with last frame's view-projection, and objects that moved since last frame are
+// drawn over it with both their transforms. The resolve reprojects the history with that velocity, clips it
+// to the variance box of the current 3x3 neighborhood (in YCoCg) so stale colors of disoccluded pixels fall out,
+// and blends the current frame in. The blend runs on 1 / (1 + max channel) weighted colors so bright HDR pixels
+// don't flicker. With upsampling the history is at the output resolution and every render resolution sample
+// goes to the output pixels nearest to where the jitter put it, so the output converges to more detail than
+// one frame was shaded at.
+class Taa
+{
+public:
+    static const int JITTER_PHASES = 16;
+
+    // weight of the current frame
+    float blend = 0.1f;
+    // resolve to the output resolution instead of the render resolution
+    bool upsample = true;
+
+    Shader velocityShader, objectVelocityShader, resolveShader;
+
+    Taa()
+        : velocityShader("resources/shaders/fullscreen.vs", "resources/shaders/taaVelocity.fs"),
+          objectVelocityShader("resources/shaders/taaObjectVelocity.vs", "resources/shaders/taaObjectVelocity.fs"),
+          resolveShader("resources/shaders/fullscreen.vs", "resources/shaders/taaResolve.fs")
+    {
+        glGenFramebuffers(1, &objectVelocityFBO);
+        glGenFramebuffers(2, historyFBO);
+        glGenTextures(2, history);
+        glGenVertexArrays(1, &emptyVAO);
+
+        velocityShader.use();
+        velocityShader.setInt("depth", 0);
+        resolveShader.use();
+        resolveShader.setInt("current", 0);
+        resolveShader.setInt("history", 1);
+        resolveShader.setInt("velocity", 2);
+        resolveShader.setInt("depth", 3);
+    }
+
+    ~Taa()
+    {
+        glDeleteFramebuffers(1, &objectVelocityFBO);
+        glDeleteFramebuffers(2, historyFBO);
+        glDeleteTextures(2, history);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+    Taa(const Taa &) = delete;
+    Taa &operator=(const Taa &) = delete;
+
+    // the projection to render this frame with; keeps the unjittered one for the velocity
+    glm::mat4 Jitter(const glm::mat4 &projection, const glm::mat4 &view, int renderWidth, int renderHeight)
+    {
+        phase = phase % JITTER_PHASES + 1;
+        glm::vec2 offset(halton(phase, 2) - 0.5f, halton(phase, 3) - 0.5f);
+        jitter = offset * glm::vec2(2.0f / renderWidth, 2.0f / renderHeight);
+        viewProjection = projection * view;
+        glm::mat4 jittered = projection;
+        // column 2 is multiplied by the view z, and w = -z: subtracting shifts clip x/w and y/w by +jitter
+        jittered[2][0] -= jitter.x;
+        jittered[2][1] -= jitter.y;
+        jitteredProjection = jittered;
+        currentView = view;
+        jitteredViewProjection = jittered * view;
+        return jittered;
+    }
+
+    // format of the history, reallocated (and so reset) by the next AddPasses()
+    void SetHistoryFormat(const TargetFormat &format)
+    {
+        if (&format != historyFormat)
+            historyWidth = historyHeight = 0;
+        historyFormat = &format;
+    }
+
+    // the history doesn't match the scene any more (first frame, TAA switched back on)
+    void Invalidate()
+    {
+        historyValid = false;
+    }
+
+    // declares the velocity and resolve passes that accumulate `color` into the history and returns the history
+    // written this frame, the anti-aliased (and upsampled) scene. The velocity of every pixel of the scene depth
+    // is a graph transient; drawMoved(shader) draws the objects that moved since the last frame with "model"
+    // and "previousModel" set, depth tested against the scene.
+    RenderGraph::Resource AddPasses(RenderGraph &graph, RenderGraph::Resource color, RenderGraph::Resource sceneDepth,
+                                    int outputWidth, int outputHeight, const std::function<void(Shader &)> &drawMoved)
+    {
+        int renderWidth = graph.Width(color), renderHeight = graph.Height(color);
+        if (upsample)
+            allocateHistory(outputWidth, outputHeight);
+        else
+            allocateHistory(renderWidth, renderHeight);
+        velocityWidth = renderWidth;
+        velocityHeight = renderHeight;
+        int read = current, write = 1 - current;
+        RenderGraph::Resource velocity = graph.Create("Brzine", renderWidth, renderHeight, velocityFormat());
+        RenderGraph::Resource previous = graph.Import("TAA istorija " + std::to_string(read), history[read],
+                                                      historyWidth, historyHeight, historyFBO[read]);
+        RenderGraph::Resource next = graph.Import("TAA istorija " + std::to_string(write), history[write],
+                                                  historyWidth, historyHeight, historyFBO[write]);
+
+        graph.AddPass("TAA brzine", { sceneDepth }, { velocity }, [this, &graph, sceneDepth, velocity, drawMoved]() {
+            GLint polygonMode[2];
+            glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+            graph.BindTarget(velocity);
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glBindVertexArray(emptyVAO);
+            velocityShader.use();
+            velocityShader.setMat4("reprojection", previousViewProjection * glm::inverse(jitteredViewProjection));
+            velocityShader.setVec2("jitter", jitter);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(sceneDepth));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glBindVertexArray(0);
+
+            // the same surfaces the scene kept, pulled a little forward against depth fighting
+            attachObjectVelocity(graph.Texture(velocity), graph.Texture(sceneDepth));
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LEQUAL);
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(-1.0f, -1.0f);
+            objectVelocityShader.use();
+            objectVelocityShader.setMat4("projection", jitteredProjection);
+            objectVelocityShader.setMat4("view", currentView);
+            objectVelocityShader.setMat4("currentViewProjection", viewProjection);
+            objectVelocityShader.setMat4("previousViewProjection", previousViewProjection);
+            drawMoved(objectVelocityShader);
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+
+            glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        });
+
+        graph.AddPass("TAA", { color, previous, velocity, sceneDepth }, { next },
+                      [this, &graph, color, previous, velocity, sceneDepth, next, renderWidth, renderHeight]() {
+            GLint polygonMode[2];
+            glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glBindVertexArray(emptyVAO);
+
+            graph.BindTarget(next);
+            resolveShader.use();
+            resolveShader.setVec2("currentSize", glm::vec2(renderWidth, renderHeight));
+            resolveShader.setVec2("jitter", jitter * 0.5f);
+            resolveShader.setFloat("blend", blend);
+            resolveShader.setBool("historyValid", historyValid);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(color));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(previous));
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(velocity));
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_2D, graph.Texture(sceneDepth));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glActiveTexture(GL_TEXTURE0);
+            historyValid = true;
+
+            glBindVertexArray(0);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+            glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+        });
+        current = write;
+        return next;
+    }
+
+    // call at the end of every frame rendered with TAA
+    void EndFrame()
+    {
+        previousViewProjection = viewProjection;
+    }
+
+    int ResultWidth() const
+    {
+        return historyWidth;
+    }
+
+    int ResultHeight() const
+    {
+        return historyHeight;
+    }
+
+    // estimated bytes of the velocity and resolve passes, colorBytes is the size of the scene color they read
+    size_t Traffic(size_t colorBytes) const
+    {
+        size_t pixels = (size_t) velocityWidth * velocityHeight;
+        // velocity: depth in, velocity out; resolve: color, depth and velocity in, history in and out
+        return pixels * (4 + 4) + colorBytes + pixels * (4 + 4)
+               + 2 * (size_t) historyWidth * historyHeight * historyFormat->bytesPerPixel;
+    }
+
+    size_t Bytes() const
+    {
+        return (size_t) velocityWidth * velocityHeight * 4
+               + 2 * (size_t) historyWidth * historyHeight * historyFormat->bytesPerPixel;
+    }
+
+private:
+    unsigned int objectVelocityFBO = 0;
+    unsigned int historyFBO[2] = { 0, 0 }, history[2] = { 0, 0 };
+    unsigned int emptyVAO = 0;
+    // what objectVelocityFBO has attached
+    unsigned int objectVelocity = 0, objectDepth = 0;
+    int velocityWidth = 0, velocityHeight = 0, historyWidth = 0, historyHeight = 0;
+    const TargetFormat *historyFormat = &TargetFormat::Get(TargetFormat::RGBA16F);
+    int current = 0;
+    bool historyValid = false;
+    int phase = 0;
+    // jitter of this frame in NDC
+    glm::vec2 jitter = glm::vec2(0.0f);
+    glm::mat4 jitteredProjection = glm::mat4(1.0f), currentView = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f), jitteredViewProjection = glm::mat4(1.0f);
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+
+    static float halton(int index, int base)
+    {
+        float result = 0.0f, fraction = 1.0f;
+        while (index > 0) {
+            fraction /= base;
+            result += fraction * (index % base);
+            index /= base;
+        }
+        return result;
+    }
+
+    static const TargetFormat &velocityFormat()
+    {
+        static const TargetFormat format = { "RG16F", GL_RG16F, GL_RG, GL_FLOAT, 4 };
+        return format;
+    }
+
+    // the object pass writes the velocity and needs the scene depth to test against, the camera pass samples
+    // it instead; leaves objectVelocityFBO bound
+    void attachObjectVelocity(unsigned int velocity, unsigned int sceneDepth)
+    {
+        // attached every frame, the pool may have recycled a texture name since
+        glBindFramebuffer(GL_FRAMEBUFFER, objectVelocityFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, velocity, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+        if (velocity == objectVelocity && sceneDepth == objectDepth)
+            return;
+        objectVelocity = velocity;
+        objectDepth = sceneDepth;
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: TAA object velocity framebuffer is not complete!" << std::endl;
+    }
+
+    void allocateHistory(int width, int height)
+    {
+        if (width == historyWidth && height == historyHeight)
+            return;
+        historyWidth = width;
+        historyHeight = height;
+        for (int i = 0; i < 2; i++) {
+            glBindTexture(GL_TEXTURE_2D, history[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, historyFormat->internalFormat, width, height, 0, historyFormat->format,
+                         historyFormat->type, NULL);
+            // reprojected with bilinear taps
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glBindFramebuffer(GL_FRAMEBUFFER, historyFBO[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: TAA history framebuffer is not complete!" << std::endl;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        historyValid = false;
+    }
+};
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef TARGET_FORMAT_H
+#define TARGET_FORMAT_H
+
+#include <glad/glad.h>
+
+// Color formats a render target can be allocated with, picked per target through RenderTargets.
+// R11F_G11F_B10F keeps the HDR range in half the bytes of RGBA16F (no sign, no alpha, 5-6 mantissa bits),
+// RGBA8 is for targets that only ever hold [0, 1] colors, RenderTargets::Allows() says which.
+struct TargetFormat {
+    enum Id {
+        RGBA16F,
+        R11F_G11F_B10F,
+        RGBA8,
+        COUNT
+    };
+
+    const char *name;
+    GLint internalFormat;
+    GLenum format;
+    GLenum type;
+    int bytesPerPixel;
+
+    static const TargetFormat &Get(int id)
+    {
+        static const TargetFormat formats[COUNT] = {
+            { "RGBA16F", GL_RGBA16F, GL_RGBA, GL_FLOAT, 8 },
+            { "R11F_G11F_B10F", GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4 },
+            { "RGBA8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+        };
+        return formats[id >= 0 && id < COUNT ? id : RGBA16F];
+    }
+};
+
+#endif
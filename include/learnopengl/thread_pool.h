@@ -0,0 +1,131 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops.
+// ParallelFor() splits [0, count) into chunks, the workers and the calling thread pull chunks until none are
+// left and the call returns once every chunk is done. The workers sleep between calls, so running a loop
+// every frame costs a wake-up instead of creating threads.
+class ThreadPool
+{
+public:
+    // one worker less than the number of cores, the calling thread does its share too
+    explicit ThreadPool(unsigned int workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1)
+    {
+        for (unsigned int i = 0; i < workerCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // threads a loop can run on, including the calling one
+    unsigned int ThreadCount() const
+    {
+        return workers.size() + 1;
+    }
+
+    // calls job(begin, end) for chunks of at most chunkSize items. maxThreads limits how many threads
+    // (including the calling one) take part, 0 means all of them.
+    void ParallelFor(unsigned int count, unsigned int chunkSize,
+                     const std::function<void(unsigned int begin, unsigned int end)> &job, unsigned int maxThreads = 0)
+    {
+        if (count == 0)
+            return;
+        chunkSize = std::max(1u, chunkSize);
+        unsigned int chunks = (count + chunkSize - 1) / chunkSize;
+        unsigned int helpers = std::min<unsigned int>(workers.size(), chunks - 1);
+        if (maxThreads > 0)
+            helpers = std::min(helpers, maxThreads - 1);
+        if (helpers == 0) {
+            job(0, count);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        current = &job;
+        itemCount = count;
+        currentChunkSize = chunkSize;
+        chunkCount = chunks;
+        nextChunk = 0;
+        doneChunks = 0;
+        helpersWanted = helpers;
+        generation++;
+        lock.unlock();
+        wake.notify_all();
+
+        runChunks();
+
+        lock.lock();
+        finished.wait(lock, [this] { return doneChunks == chunkCount && activeHelpers == 0; });
+        // workers that didn't wake up in time have nothing left to do
+        helpersWanted = 0;
+        current = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    bool stopping = false;
+
+    const std::function<void(unsigned int, unsigned int)> *current = nullptr;
+    unsigned int itemCount = 0, currentChunkSize = 1, chunkCount = 0;
+    std::atomic<unsigned int> nextChunk{0};
+    unsigned int doneChunks = 0;
+    unsigned int helpersWanted = 0, activeHelpers = 0;
+    unsigned long long generation = 0;
+
+    void runChunks()
+    {
+        unsigned int done = 0;
+        for (unsigned int chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+            unsigned int begin = chunk * currentChunkSize;
+            (*current)(begin, std::min(itemCount, begin + currentChunkSize));
+            done++;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        doneChunks += done;
+    }
+
+    void workerLoop()
+    {
+        unsigned long long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || (generation != seen && helpersWanted > 0); });
+            if (stopping)
+                return;
+            seen = generation;
+            helpersWanted--;
+            activeHelpers++;
+            lock.unlock();
+
+            runChunks();
+
+            lock.lock();
+            activeHelpers--;
+            finished.notify_all();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One attribute of a vertex stream. Integer attributes are read with glVertexAttribIPointer and have to be
+// int/uint in the shader, everything else (including normalized and half float data) arrives as float.
+struct VertexAttribute {
+    std::string name;
+    unsigned int location;
+    int components;
+    GLenum type;
+    size_t offset;
+    bool normalized;
+    bool integer;
+};
+
+// One buffer binding: stride, divisor (0 per vertex, 1 per instance) and the attributes read from it.
+struct VertexStream {
+    size_t stride;
+    unsigned int divisor;
+    std::vector<VertexAttribute> attributes;
+};
+
+// Declarative description of everything a vertex array reads.
+// Formats are declared once next to the struct they describe and every VAO in the renderer is built from one
+// by CreateVAO(), so an attribute location can only be claimed by one stream. Combining a mesh format with an
+// instance format reports any location both of them use instead of silently overwriting it, and Validate()
+// checks a linked program's active attributes against the format.
+class VertexFormat
+{
+public:
+    std::string name;
+    std::vector<VertexStream> streams;
+
+    explicit VertexFormat(const std::string &name = "") : name(name) {}
+
+    // starts a new stream, the following Attribute() calls belong to it
+    VertexFormat &Stream(size_t stride, unsigned int divisor = 0)
+    {
+        streams.push_back(VertexStream{ stride, divisor, {} });
+        return *this;
+    }
+
+    VertexFormat &Attribute(const std::string &attributeName, unsigned int location, int components, GLenum type,
+                            size_t offset, bool normalized = false)
+    {
+        return add(VertexAttribute{ attributeName, location, components, type, offset, normalized, false });
+    }
+
+    VertexFormat &IntegerAttribute(const std::string &attributeName, unsigned int location, int components, GLenum type,
+                                   size_t offset)
+    {
+        return add(VertexAttribute{ attributeName, location, components, type, offset, false, true });
+    }
+
+    // streams of both formats in one VAO, e.g. mesh vertices + per instance data
+    static VertexFormat Combine(const VertexFormat &first, const VertexFormat &second)
+    {
+        VertexFormat combined(first.name + "+" + second.name);
+        for (const VertexStream &stream : first.streams)
+            combined.streams.push_back(stream);
+        for (const VertexStream &stream : second.streams) {
+            combined.Stream(stream.stride, stream.divisor);
+            for (const VertexAttribute &attribute : stream.attributes)
+                combined.add(attribute);
+        }
+        return combined;
+    }
+
+    // builds a VAO with one buffer per stream. Streams given buffer 0 are only enabled, their data is bound
+    // later with BindStream() (ring buffers whose offset changes every frame).
+    unsigned int CreateVAO(const std::vector<unsigned int> &buffers, unsigned int indexBuffer = 0) const
+    {
+        unsigned int VAO;
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        if (indexBuffer)
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        for (unsigned int s = 0; s < streams.size(); s++) {
+            for (const VertexAttribute &attribute : streams[s].attributes) {
+                glEnableVertexAttribArray(attribute.location);
+                glVertexAttribDivisor(attribute.location, streams[s].divisor);
+            }
+            if (s < buffers.size() && buffers[s])
+                BindStream(s, buffers[s], 0);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return VAO;
+    }
+
+    // points stream `s` of the currently bound VAO at `buffer`, starting `offset` bytes in
+    void BindStream(unsigned int s, unsigned int buffer, size_t offset) const
+    {
+        const VertexStream &stream = streams[s];
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (const VertexAttribute &attribute : stream.attributes) {
+            void *pointer = (void*)(offset + attribute.offset);
+            if (attribute.integer)
+                glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, stream.stride, pointer);
+            else
+                glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+                                      attribute.normalized ? GL_TRUE : GL_FALSE, stream.stride, pointer);
+        }
+    }
+
+    // checks that every active attribute of a linked program is fed by this format with a matching kind
+    // (float vs integer). Unused format attributes are fine, the same mesh format serves many shaders.
+    bool Validate(unsigned int program, const std::string &programName) const
+    {
+        bool valid = true;
+        GLint count = 0;
+        glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+        for (GLint i = 0; i < count; i++) {
+            GLchar attributeName[256];
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(program, i, sizeof(attributeName), nullptr, &size, &type, attributeName);
+            GLint location = glGetAttribLocation(program, attributeName);
+            if (location < 0)
+                continue; // built-ins like gl_VertexID
+
+            int slots = locationCount(type) * size;
+            for (int slot = 0; slot < slots; slot++) {
+                const VertexAttribute *attribute = find(location + slot);
+                if (!attribute) {
+                    std::cout << "ERROR::VERTEX_FORMAT:: " << programName << " reads " << attributeName
+                              << " at location " << location + slot << " which format " << name
+                              << " does not provide" << std::endl;
+                    valid = false;
+                } else if (attribute->integer != isIntegerType(type)) {
+                    std::cout << "ERROR::VERTEX_FORMAT:: " << programName << " reads " << attributeName
+                              << (isIntegerType(type) ? " as integer" : " as float") << " but format " << name
+                              << " provides " << attribute->name << (attribute->integer ? " as integer" : " as float")
+                              << std::endl;
+                    valid = false;
+                }
+            }
+        }
+        return valid;
+    }
+
+private:
+    VertexFormat &add(const VertexAttribute &attribute)
+    {
+        if (find(attribute.location))
+            std::cout << "ERROR::VERTEX_FORMAT:: " << name << " assigns location " << attribute.location
+                      << " to both " << find(attribute.location)->name << " and " << attribute.name << std::endl;
+        else
+            streams.back().attributes.push_back(attribute);
+        return *this;
+    }
+
+    const VertexAttribute *find(unsigned int location) const
+    {
+        for (const VertexStream &stream : streams)
+            for (const VertexAttribute &attribute : stream.attributes)
+                if (attribute.location == location)
+                    return &attribute;
+        return nullptr;
+    }
+
+    static int locationCount(GLenum type)
+    {
+        switch (type) {
+            case GL_FLOAT_MAT2: case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT2x4: return 2;
+            case GL_FLOAT_MAT3: case GL_FLOAT_MAT3x2: case GL_FLOAT_MAT3x4: return 3;
+            case GL_FLOAT_MAT4: case GL_FLOAT_MAT4x2: case GL_FLOAT_MAT4x3: return 4;
+            default: return 1;
+        }
+    }
+
+    static bool isIntegerType(GLenum type)
+    {
+        switch (type) {
+            case GL_INT: case GL_INT_VEC2: case GL_INT_VEC3: case GL_INT_VEC4:
+            case GL_UNSIGNED_INT: case GL_UNSIGNED_INT_VEC2: case GL_UNSIGNED_INT_VEC3: case GL_UNSIGNED_INT_VEC4:
+                return true;
+            default:
+                return false;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,58 @@
+#version 330 core
+// first step of the bloom chain: the full resolution HDR color down to half resolution, keeping only what is
+// above the threshold. The 13 taps form the same five 2x2 boxes as bloomDownsample.fs, but every box is weighted
+// by 1 / (1 + luma) (Karis average), so a single very bright pixel can't dominate the result and flicker as it
+// moves across texels. The threshold has a soft knee, a quadratic ramp instead of a hard cut.
+layout (location = 0) out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexel;
+uniform float threshold;
+// threshold - knee, 2 * knee, 0.25 / knee
+uniform vec3 curve;
+
+float Luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 KarisBox(vec3 a, vec3 b, vec3 c, vec3 d, float weight, inout float total)
+{
+    vec3 box = (a + b + c + d) * 0.25;
+    float w = weight / (1.0 + Luma(box));
+    total += w;
+    return box * w;
+}
+
+void main()
+{
+    vec2 t = sourceTexel;
+    vec3 a = texture(source, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+    float total = 0.0;
+    vec3 color = KarisBox(j, k, l, m, 0.5, total)
+               + KarisBox(a, b, d, e, 0.125, total)
+               + KarisBox(b, c, e, f, 0.125, total)
+               + KarisBox(d, e, g, h, 0.125, total)
+               + KarisBox(e, f, h, i, 0.125, total);
+    color /= total;
+
+    float brightness = max(color.r, max(color.g, color.b));
+    float knee = clamp(brightness - curve.x, 0.0, curve.y);
+    knee = curve.z * knee * knee;
+    FragColor = color * max(knee, brightness - threshold) / max(brightness, 1e-4);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 330 core
+// one step down the bloom chain: 13 bilinear taps forming four overlapping 2x2 boxes around the center box,
+// weighted 0.5 for the center and 0.125 for each corner box (Jimenez, Next Generation Post Processing in Call of
+// Duty: Advanced Warfare). Reading between texels averages 4 of them per tap, so nothing is skipped on the way
+// down and small highlights don't flicker.
+layout (location = 0) out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 sourceTexel;
+
+void main()
+{
+    vec2 t = sourceTexel;
+    vec3 a = texture(source, TexCoords + t * vec2(-2.0,  2.0)).rgb;
+    vec3 b = texture(source, TexCoords + t * vec2( 0.0,  2.0)).rgb;
+    vec3 c = texture(source, TexCoords + t * vec2( 2.0,  2.0)).rgb;
+    vec3 d = texture(source, TexCoords + t * vec2(-2.0,  0.0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + t * vec2( 2.0,  0.0)).rgb;
+    vec3 g = texture(source, TexCoords + t * vec2(-2.0, -2.0)).rgb;
+    vec3 h = texture(source, TexCoords + t * vec2( 0.0, -2.0)).rgb;
+    vec3 i = texture(source, TexCoords + t * vec2( 2.0, -2.0)).rgb;
+    vec3 j = texture(source, TexCoords + t * vec2(-1.0,  1.0)).rgb;
+    vec3 k = texture(source, TexCoords + t * vec2( 1.0,  1.0)).rgb;
+    vec3 l = texture(source, TexCoords + t * vec2(-1.0, -1.0)).rgb;
+    vec3 m = texture(source, TexCoords + t * vec2( 1.0, -1.0)).rgb;
+
+    FragColor = (j + k + l + m) * 0.125
+              + (a + c + g + i) * 0.03125
+              + (b + d + f + h) * 0.0625
+              + e * 0.125;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+// one step up the bloom chain: a 3x3 tent filter of the smaller level, added onto this level by blending
+layout (location = 0) out vec3 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// texel size of the source scaled by the filter radius
+uniform vec2 sourceTexel;
+
+void main()
+{
+    vec2 t = sourceTexel;
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + vec2(-t.x, 0.0)).rgb + texture(source, TexCoords + vec2(t.x, 0.0)).rgb
+             + texture(source, TexCoords + vec2(0.0, -t.y)).rgb + texture(source, TexCoords + vec2(0.0, t.y)).rgb) * 2.0;
+    result += texture(source, TexCoords + vec2(-t.x, -t.y)).rgb + texture(source, TexCoords + vec2(t.x, -t.y)).rgb
+            + texture(source, TexCoords + vec2(-t.x, t.y)).rgb + texture(source, TexCoords + vec2(t.x, t.y)).rgb;
+    FragColor = result / 16.0;
+}
\ No newline at end of file
@@ -1,7 +1,9 @@
 #version 330 core
+// permutations (ShaderVariants): DIR_LIGHT, POINT_LIGHTS, SPOT_LIGHT, SH_AMBIENT, LIGHTMAP, SSAO, SHADOWS (with DIR_LIGHT)
+// LIGHTMAP replaces DIR_LIGHT and SH_AMBIENT with the baked irradiance, they are never defined together
+// EvalSH(), UpsampleSSAO() and ssaoTexture come from shared.glsl
 
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 struct DirLight {
     vec3 direction;
@@ -11,20 +13,6 @@ struct DirLight {
     vec3 specular;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 lightColor;
-};
-
 struct SpotLight {
     vec3 position;
     vec3 direction;
@@ -49,38 +37,125 @@ struct Material {
     float shininess;
 };
 
-#define NR_POINT_LIGHTS 2
-
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+#ifdef LIGHTMAP
+in vec2 LightmapUV;
+
+// baked directional light and sky/bounce light, see Lightmap
+uniform sampler2D lightmapIrradiance;
+uniform sampler2D lightmapOcclusion;
+#endif
+// baked and screen space occlusion darkening the ambient terms, set in main()
+float ambientOcclusion = 1.0;
 
 uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotlight;
 
+// clustered point lights, see ClusteredLighting
+uniform samplerBuffer lightData;     // 4 texels per light: position + radius, ambient + constant,
+                                     // diffuse + linear, specular + quadratic
+uniform usamplerBuffer clusterGrid;  // offset into lightIndices and light count per cluster
+uniform usamplerBuffer lightIndices;
+uniform uvec2 objectLights;          // offset and count of the drawn object's list in lightIndices
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform float clusterNear;
+uniform float clusterSliceScale;
+uniform float cameraNear;
+uniform float cameraFar;
+
 uniform Material material;
 uniform vec3 viewPosition;
 uniform samplerCube skybox;
+#ifdef SHADOWS
+// cascaded shadow maps of the directional light, see CascadedShadows
+uniform sampler2DArrayShadow shadowStatic;
+uniform sampler2DArrayShadow shadowDynamic;
+uniform mat4 lightSpace[3];
+uniform vec3 cascadeSplits;     // view depth where each cascade ends
+uniform vec3 normalOffsets;     // world space normal offset per cascade
+uniform vec3 cameraForward;
+uniform int dynamicCascades;
+uniform vec2 shadowTexel;       // 1 / size of the static and the dynamic maps
+#endif
+
+#ifdef SHADOWS
+// 3x3 PCF taps of one map, every tap is itself a bilinear 2x2 compare
+float SampleShadow(sampler2DArrayShadow maps, vec3 coords, int cascade, float texel)
+{
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(maps, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+    return lit / 9.0;
+}
 
+// how much of the directional light reaches fragPos: the cached static map and the dynamic overlay, the darker wins
+float ShadowFactor(vec3 fragPos, vec3 normal)
+{
+    float depth = dot(fragPos - viewPosition, cameraForward);
+    if (depth >= cascadeSplits.z)
+        return 1.0;
+    int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+    vec3 coords = (lightSpace[cascade] * vec4(fragPos + normal * normalOffsets[cascade], 1.0)).xyz * 0.5 + 0.5;
+    float lit = SampleShadow(shadowStatic, coords, cascade, shadowTexel.x);
+    if (cascade < dynamicCascades)
+        lit = min(lit, SampleShadow(shadowDynamic, coords, cascade, shadowTexel.y));
+    return lit;
+}
+#endif
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow);
+vec3 CalcPointLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor);
+int FindCluster();
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
 {
     vec3 normal = normalize(Normal);
     vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcDirLight(dirLight, normal, viewDir);
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], normal, FragPos, viewDir);
+    vec3 result = vec3(0.0);
+#ifdef LIGHTMAP
+    result += texture(lightmapIrradiance, LightmapUV).rgb * vec3(texture(material.diffuse, TexCoords));
+    ambientOcclusion = texture(lightmapOcclusion, LightmapUV).r;
+#endif
+#ifdef SSAO
+    ambientOcclusion *= UpsampleSSAO(cameraNear * cameraFar / (cameraFar - gl_FragCoord.z * (cameraFar - cameraNear)));
+#endif
+#ifdef SH_AMBIENT
+    // replaces the flat dirLight.ambient
+    result += EvalSH(normal) * vec3(texture(material.diffuse, TexCoords)) * ambientOcclusion;
+#endif
+#ifdef DIR_LIGHT
+    float shadow = 1.0;
+#ifdef SHADOWS
+    shadow = ShadowFactor(FragPos, normal);
+#endif
+    result += CalcDirLight(dirLight, normal, viewDir, shadow);
+#endif
+
+#ifdef POINT_LIGHTS
+    // only the lights whose influence reaches this fragment's cluster
+    vec3 diffuseColor = vec3(texture(material.diffuse, TexCoords));
+    vec3 specularColor = vec3(texture(material.specular, TexCoords));
+    uvec2 cluster = texelFetch(clusterGrid, FindCluster()).xy;
+    // the drawn object's own list holds every light reaching it as well, the shorter one is walked
+    if (objectLights.y < cluster.y)
+        cluster = objectLights;
+    for(uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(int(texelFetch(lightIndices, int(cluster.x + i)).x), normal, FragPos, viewDir,
+                                 diffuseColor, specularColor);
+#endif
+#ifdef SPOT_LIGHT
     result += CalcSpotLight(spotlight, normal, FragPos, viewDir);
+#endif
     FragColor = vec4(result, 1.0);
 }
 
 // calculates the color when using a directional light.
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     // diffuse shading
@@ -89,32 +164,51 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+#ifdef SH_AMBIENT
+    vec3 ambient = vec3(0.0);
+#else
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords)) * ambientOcclusion;
+#endif
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-    return (ambient + diffuse + specular);
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+// index of the cluster the fragment lies in, same layout as ClusteredLighting
+int FindCluster()
+{
+    // linear view depth back from the depth buffer value
+    float depth = cameraNear * cameraFar / (cameraFar - gl_FragCoord.z * (cameraFar - cameraNear));
+    int slice = depth <= clusterNear ? 0 : int(log(depth / clusterNear) * clusterSliceScale);
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterTileSize);
+    ivec3 id = clamp(ivec3(tile, slice), ivec3(0), clusterDims - 1);
+    return (id.z * clusterDims.y + id.y) * clusterDims.x + id.x;
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor, vec3 specularColor)
 {
-        vec3 lightDir = normalize(light.position - fragPos);
-         // diffuse shading
-         float diff = max(dot(normal, lightDir), 0.0);
-         // specular shading
-         vec3 halfwayDir = normalize(lightDir +  viewDir);
-         float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-         // attenuation
-         float distance = length(light.position - fragPos);
-         float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-         // combine results
-         vec3 ambient = (0.3 * light.lightColor) * light.ambient * vec3(texture(material.diffuse, TexCoords));
-         vec3 diffuse =  (0.3 * light.lightColor) * light.lightColor * light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-         vec3 specular =  (0.3 * light.lightColor) *light.lightColor * light.specular * spec * vec3(texture(material.specular, TexCoords));
-         ambient *= attenuation;
-         diffuse *= attenuation;
-         specular *= attenuation;
-         return (ambient + diffuse + specular);
+    vec4 positionRadius = texelFetch(lightData, index * 4);
+    vec4 ambientConstant = texelFetch(lightData, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(lightData, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(lightData, index * 4 + 3);
+
+    vec3 lightDir = normalize(positionRadius.xyz - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    // attenuation, faded out to exactly zero at the radius the light was clustered with
+    float distance = length(positionRadius.xyz - fragPos);
+    float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+    float falloff = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    // combine results
+    vec3 ambient = ambientConstant.rgb * diffuseColor * ambientOcclusion;
+    vec3 diffuse = diffuseLinear.rgb * diff * diffuseColor;
+    vec3 specular = specularQuadratic.rgb * spec * specularColor;
+    return (ambient + diffuse + specular) * attenuation;
 }
 // calculates the color when using a spot light.
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -133,7 +227,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.color * light.ambient * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.color * light.ambient * vec3(texture(material.diffuse, TexCoords)) * ambientOcclusion;
     vec3 diffuse = light.color * light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
     vec3 specular = light.color * light.specular * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation * intensity;
@@ -2,19 +2,34 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+#ifdef LIGHTMAP
+layout (location = 5) in vec2 aLightmapUV;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+#ifdef LIGHTMAP
+out vec2 LightmapUV;
+#endif
+// must match depthPrepass.vs bit for bit, the color pass tests with GL_EQUAL against the pre-pass depth
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef LIGHTMAP
+// where this object's uv square sits in the atlas
+uniform vec4 lightmapScaleOffset;
+#endif
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = aNormal;
     TexCoords = aTexCoords;
+#ifdef LIGHTMAP
+    LightmapUV = aLightmapUV * lightmapScaleOffset.xy + lightmapScaleOffset.zw;
+#endif
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,22 @@
+#version 330 core
+// emits only the visible instances, transform feedback packs them into a compact buffer
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec3 vPosition[];
+flat in uint vScaleYaw[];
+flat in int vVisible[];
+
+// captured interleaved, the same 16 bytes as InstanceData
+out vec3 outPosition;
+flat out uint outScaleYaw;
+
+void main()
+{
+    if (vVisible[0] == 0)
+        return;
+    outPosition = vPosition[0];
+    outScaleYaw = vScaleYaw[0];
+    EmitVertex();
+    EndPrimitive();
+}
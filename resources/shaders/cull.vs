@@ -0,0 +1,48 @@
+#version 330 core
+// every instance is one point, FAR_PASS selects the instances drawn as impostors
+layout (location = 0) in vec3 aPosition;
+layout (location = 1) in uint aScaleYaw; // two packed halfs, scale in the low bits
+
+out vec3 vPosition;
+flat out uint vScaleYaw;
+flat out int vVisible;
+
+uniform vec4 frustumPlanes[6];
+uniform vec3 viewPosition;
+uniform float lodDistance;
+// yaw independent bounding sphere of the model, cullMargin covers the frame the result is late
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+uniform float cullMargin;
+
+// unpackHalf2x16 needs GLSL 4.20, the scale is always a positive normal half
+float halfToFloat(uint h)
+{
+    uint exponent = (h >> 10) & 0x1fu;
+    if (exponent == 0u)
+        return 0.0;
+    return (1.0 + float(h & 0x3ffu) / 1024.0) * exp2(float(int(exponent) - 15));
+}
+
+void main()
+{
+    float scale = halfToFloat(aScaleYaw & 0xffffu);
+    vec3 center = aPosition + boundsCenter * scale;
+    float radius = boundsRadius * scale + cullMargin;
+
+    bool visible = true;
+    for (int i = 0; i < 6; i++)
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+            visible = false;
+
+    vec3 toCamera = aPosition - viewPosition;
+#ifdef FAR_PASS
+    visible = visible && dot(toCamera, toCamera) >= lodDistance * lodDistance;
+#else
+    visible = visible && dot(toCamera, toCamera) < lodDistance * lodDistance;
+#endif
+
+    vVisible = visible ? 1 : 0;
+    vPosition = aPosition;
+    vScaleYaw = aScaleYaw;
+}
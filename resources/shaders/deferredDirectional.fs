@@ -0,0 +1,182 @@
+#version 330 core
+// permutations (ShaderVariants): DIR_LIGHT, SPOT_LIGHT, SH_AMBIENT, SSAO, SHADOWS (with DIR_LIGHT)
+// EvalSH(), UpsampleSSAO() and ssaoTexture come from shared.glsl
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    vec3 color;
+};
+
+struct Material {
+    float shininess;
+};
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform DirLight dirLight;
+uniform SpotLight spotlight;
+uniform Material material;
+uniform vec3 viewPosition;
+uniform mat4 inverseViewProjection;
+#ifdef SHADOWS
+// cascaded shadow maps of the directional light, see CascadedShadows
+uniform sampler2DArrayShadow shadowStatic;
+uniform sampler2DArrayShadow shadowDynamic;
+uniform mat4 lightSpace[3];
+uniform vec3 cascadeSplits;     // view depth where each cascade ends
+uniform vec3 normalOffsets;     // world space normal offset per cascade
+uniform vec3 cameraForward;
+uniform int dynamicCascades;
+uniform vec2 shadowTexel;       // 1 / size of the static and the dynamic maps
+#endif
+#ifdef SSAO
+uniform float cameraNear;
+uniform float cameraFar;
+#endif
+// screen space occlusion darkening the ambient terms, set in main()
+float ambientOcclusion = 1.0;
+#ifdef SHADOWS
+// 3x3 PCF taps of one map, every tap is itself a bilinear 2x2 compare
+float SampleShadow(sampler2DArrayShadow maps, vec3 coords, int cascade, float texel)
+{
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(maps, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+    return lit / 9.0;
+}
+
+// how much of the directional light reaches fragPos: the cached static map and the dynamic overlay, the darker wins
+float ShadowFactor(vec3 fragPos, vec3 normal)
+{
+    float depth = dot(fragPos - viewPosition, cameraForward);
+    if (depth >= cascadeSplits.z)
+        return 1.0;
+    int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+    vec3 coords = (lightSpace[cascade] * vec4(fragPos + normal * normalOffsets[cascade], 1.0)).xyz * 0.5 + 0.5;
+    float lit = SampleShadow(shadowStatic, coords, cascade, shadowTexel.x);
+    if (cascade < dynamicCascades)
+        lit = min(lit, SampleShadow(shadowDynamic, coords, cascade, shadowTexel.y));
+    return lit;
+}
+#endif
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularIntensity, float shadow);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularIntensity);
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, p.y, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here, the skybox fills it later
+    if (depth == 1.0)
+        discard;
+
+    vec4 clipPos = vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPos = inverseViewProjection * clipPos;
+    vec3 fragPos = worldPos.xyz / worldPos.w;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec3 normal = octDecode(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);
+    vec3 viewDir = normalize(viewPosition - fragPos);
+
+    vec3 result = vec3(0.0);
+#ifdef SSAO
+    ambientOcclusion = UpsampleSSAO(cameraNear * cameraFar / (cameraFar - depth * (cameraFar - cameraNear)));
+#endif
+#ifdef SH_AMBIENT
+    // replaces the flat dirLight.ambient
+    result += EvalSH(normal) * albedoSpecular.rgb * ambientOcclusion;
+#endif
+#ifdef DIR_LIGHT
+    float shadow = 1.0;
+#ifdef SHADOWS
+    shadow = ShadowFactor(fragPos, normal);
+#endif
+    result += CalcDirLight(dirLight, normal, viewDir, albedoSpecular.rgb, albedoSpecular.a, shadow);
+#endif
+#ifdef SPOT_LIGHT
+    result += CalcSpotLight(spotlight, normal, fragPos, viewDir, albedoSpecular.rgb, albedoSpecular.a);
+#endif
+    FragColor = vec4(result, 1.0);
+}
+
+// same as cityShader.fs, with the material read from the G-buffer
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 albedo, float specularIntensity, float shadow)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // combine results
+#ifdef SH_AMBIENT
+    vec3 ambient = vec3(0.0);
+#else
+    vec3 ambient = light.ambient * albedo * ambientOcclusion;
+#endif
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularIntensity;
+    return (ambient + (diffuse + specular) * shadow);
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularIntensity)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.color * light.ambient * albedo * ambientOcclusion;
+    vec3 diffuse = light.color * light.diffuse * diff * albedo;
+    vec3 specular = light.color * light.specular * spec * specularIntensity;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
@@ -0,0 +1,108 @@
+#version 330 core
+// permutations (ShaderVariants): SSAO
+// UpsampleSSAO() and ssaoTexture come from shared.glsl
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+struct Material {
+    float shininess;
+};
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+uniform Material material;
+uniform vec3 viewPosition;
+uniform mat4 inverseViewProjection;
+
+// clustered point lights, see ClusteredLighting
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform float clusterNear;
+uniform float clusterSliceScale;
+uniform float cameraNear;
+uniform float cameraFar;
+// screen space occlusion darkening the ambient term, set in main()
+float ambientOcclusion = 1.0;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, p.y, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+float LinearDepth(float depthValue)
+{
+    return cameraNear * cameraFar / (cameraFar - depthValue * (cameraFar - cameraNear));
+}
+
+int FindCluster(float depthValue)
+{
+    float depth = LinearDepth(depthValue);
+    int slice = depth <= clusterNear ? 0 : int(log(depth / clusterNear) * clusterSliceScale);
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterTileSize);
+    ivec3 id = clamp(ivec3(tile, slice), ivec3(0), clusterDims - 1);
+    return (id.z * clusterDims.y + id.y) * clusterDims.x + id.x;
+}
+
+// same as CalcPointLight in cityShader.fs
+vec3 CalcPointLight(int index, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularIntensity)
+{
+    vec4 positionRadius = texelFetch(lightData, index * 4);
+    vec4 ambientConstant = texelFetch(lightData, index * 4 + 1);
+    vec4 diffuseLinear = texelFetch(lightData, index * 4 + 2);
+    vec4 specularQuadratic = texelFetch(lightData, index * 4 + 3);
+
+    vec3 lightDir = normalize(positionRadius.xyz - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+    float distance = length(positionRadius.xyz - fragPos);
+    float attenuation = 1.0 / (ambientConstant.w + diffuseLinear.w * distance + specularQuadratic.w * (distance * distance));
+    float falloff = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+    attenuation *= falloff * falloff;
+    vec3 ambient = ambientConstant.rgb * albedo * ambientOcclusion;
+    vec3 diffuse = diffuseLinear.rgb * diff * albedo;
+    vec3 specular = specularQuadratic.rgb * spec * specularIntensity;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0)
+        discard;
+    uvec2 cluster = texelFetch(clusterGrid, FindCluster(depth)).xy;
+    if (cluster.y == 0u)
+        discard;
+
+    vec4 clipPos = vec4(TexCoords * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 worldPos = inverseViewProjection * clipPos;
+    vec3 fragPos = worldPos.xyz / worldPos.w;
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec3 normal = octDecode(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);
+    vec3 viewDir = normalize(viewPosition - fragPos);
+
+#ifdef SSAO
+    ambientOcclusion = UpsampleSSAO(LinearDepth(depth));
+#endif
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++)
+        result += CalcPointLight(int(texelFetch(lightIndices, int(cluster.x + i)).x), normal, fragPos, viewDir,
+                                 albedoSpecular.rgb, albedoSpecular.a);
+    FragColor = vec4(result, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+layout (location = 0) out vec4 AlbedoSpecular;
+layout (location = 1) out vec2 NormalOct;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+
+    float shininess;
+};
+
+uniform Material material;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit normal to [-1, 1]^2, two 16 bit channels are plenty for lighting
+vec2 octEncode(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    vec2 p = n.xy;
+    if (n.z < 0.0)
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    return p;
+}
+
+void main()
+{
+    // specular maps are grey, a single channel keeps the albedo target at 4 bytes
+    AlbedoSpecular = vec4(texture(material.diffuse, TexCoords).rgb, texture(material.specular, TexCoords).r);
+    NormalOct = octEncode(normalize(Normal)) * 0.5 + 0.5;
+}
@@ -0,0 +1,58 @@
+#version 330 core
+// EvalSH() comes from shared.glsl
+out vec4 FragColor;
+
+in vec4 LocalUV01;
+in vec4 LocalUV23;
+in vec3 WorldPos;
+flat in vec2 BaseFrame;
+flat in vec4 FrameWeights;
+flat in vec3 ViewDir;
+flat in float Radius;
+flat in vec3 Tint;
+flat in vec2 Yaw;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform int framesPerSide;
+
+uniform mat4 projection;
+uniform mat4 view;
+void main()
+{
+    vec2 localUV[4] = vec2[](LocalUV01.xy, LocalUV01.zw, LocalUV23.xy, LocalUV23.zw);
+    vec2 frameOffset[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+
+    vec4 albedo = vec4(0.0);
+    float depth = 0.0;
+    vec3 normal = vec3(0.0);
+    float coverage = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 uv = localUV[i];
+        if (FrameWeights[i] == 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+            continue;
+        vec2 atlasUV = (BaseFrame + frameOffset[i] + uv) / float(framesPerSide);
+        vec4 frameAlbedo = texture(albedoAtlas, atlasUV);
+        albedo += frameAlbedo * FrameWeights[i];
+        vec4 normalDepth = texture(normalDepthAtlas, atlasUV);
+        depth += normalDepth.w * frameAlbedo.a * FrameWeights[i];
+        // transparent texels are zero, so a filtered texel holds coverage * (n * 0.5 + 0.5)
+        normal += (normalDepth.xyz * 2.0 - frameAlbedo.a) * FrameWeights[i];
+        coverage += frameAlbedo.a * FrameWeights[i];
+    }
+    if (albedo.a < 0.5)
+        discard;
+
+    // push the fragment from the billboard plane back to the baked surface so impostors
+    // intersect the terrain and each other like the real trees do
+    float surfaceOffset = (depth / coverage) * 2.0 * Radius - Radius;
+    vec4 clipPos = projection * view * vec4(WorldPos - ViewDir * surfaceOffset, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+
+    // the atlas normals are in model space, rotated by the instance yaw like instanceShader.vs does
+    mat3 rotation = mat3(vec3(Yaw.x, 0.0, -Yaw.y), vec3(0.0, 1.0, 0.0), vec3(Yaw.y, 0.0, Yaw.x));
+    vec3 worldNormal = length(normal) > 1e-4 ? normalize(rotation * normal) : vec3(0.0, 1.0, 0.0);
+    vec3 ambient = mix(vec3(1.0), EvalSH(worldNormal), shParams.y);
+    // transparent atlas texels are black, so the blended color is premultiplied by coverage
+    FragColor = vec4(albedo.rgb / albedo.a * Tint * ambient, 1.0);
+}
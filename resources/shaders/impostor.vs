@@ -0,0 +1,116 @@
+#version 330 core
+// SHADOW_CASTER faces the quad to the light for the dynamic shadow maps (impostorShadow.fs)
+layout (location = 0) in vec2 aCorner;
+layout (location = 1) in vec3 instancePosition;
+layout (location = 2) in vec2 instanceScaleYaw;
+
+// position inside each of the 4 blended frames, two frames per vec4
+out vec4 LocalUV01;
+out vec4 LocalUV23;
+out vec3 WorldPos;
+flat out vec2 BaseFrame;
+flat out vec4 FrameWeights;
+flat out vec3 ViewDir;
+flat out float Radius;
+flat out vec3 Tint;
+// cos and sin of the instance yaw, turns the baked model space normals into world space
+flat out vec2 Yaw;
+
+uniform mat4 projection;
+uniform mat4 view;
+#ifdef SHADOW_CASTER
+uniform vec3 lightDirection;
+#else
+uniform vec3 viewPosition;
+#endif
+
+uniform int framesPerSide;
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// same mapping as Impostor::OctahedralEncode/Decode, y is up
+vec2 octEncode(vec3 n)
+{
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    vec2 p = n.xz;
+    if (n.y < 0.0)
+        p = (1.0 - abs(p.yx)) * signNotZero(p);
+    return p;
+}
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y);
+    if (n.y < 0.0)
+        n.xz = (1.0 - abs(n.zx)) * signNotZero(n.xz);
+    return normalize(n);
+}
+
+// right and up vectors of a camera looking along -direction, matches glm::lookAt in the bake
+void frameBasis(vec3 direction, out vec3 right, out vec3 up)
+{
+    vec3 worldUp = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    right = normalize(cross(worldUp, direction));
+    up = cross(direction, right);
+}
+
+// same hash as instanceShader.vs so the impostor keeps the tint of the real tree
+float instanceHash(vec3 p)
+{
+    return fract(sin(dot(p, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+// offset is in model space, the frames were baked without the instance rotation
+vec2 frameUV(vec2 frame, vec3 offset)
+{
+    vec3 direction = octDecode(frame / float(framesPerSide - 1) * 2.0 - 1.0);
+    vec3 right, up;
+    frameBasis(direction, right, up);
+    return vec2(dot(offset, right), dot(offset, up)) / Radius * 0.5 + 0.5;
+}
+
+void main()
+{
+    float scale = instanceScaleYaw.x;
+    float c = cos(instanceScaleYaw.y);
+    float s = sin(instanceScaleYaw.y);
+    // rotation around y and its inverse
+    mat3 rotation = mat3(vec3(c, 0.0, -s), vec3(0.0, 1.0, 0.0), vec3(s, 0.0, c));
+    mat3 inverseRotation = transpose(rotation);
+    Yaw = vec2(c, s);
+
+    vec3 center = instancePosition + rotation * boundsCenter * scale;
+    Radius = boundsRadius * scale;
+#ifdef SHADOW_CASTER
+    ViewDir = -normalize(lightDirection);
+#else
+    ViewDir = normalize(viewPosition - center);
+#endif
+
+    // the four frames around the model space view direction and their bilinear weights
+    vec3 localViewDir = inverseRotation * ViewDir;
+    vec2 grid = (octEncode(localViewDir) * 0.5 + 0.5) * float(framesPerSide - 1);
+    BaseFrame = clamp(floor(grid), vec2(0.0), vec2(float(framesPerSide - 2)));
+    vec2 f = clamp(grid - BaseFrame, 0.0, 1.0);
+    FrameWeights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+
+    // camera facing quad that covers the bounding sphere
+    vec3 right, up;
+    frameBasis(ViewDir, right, up);
+    vec3 offset = (aCorner.x * right + aCorner.y * up) * Radius;
+    WorldPos = center + offset;
+
+    vec3 localOffset = inverseRotation * offset;
+    LocalUV01 = vec4(frameUV(BaseFrame, localOffset), frameUV(BaseFrame + vec2(1.0, 0.0), localOffset));
+    LocalUV23 = vec4(frameUV(BaseFrame + vec2(0.0, 1.0), localOffset), frameUV(BaseFrame + vec2(1.0, 1.0), localOffset));
+
+    float h = instanceHash(instancePosition);
+    Tint = mix(vec3(0.85, 0.9, 0.8), vec3(1.1, 1.05, 0.95), h);
+
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
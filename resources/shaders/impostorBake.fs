@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalDepth;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in float ViewDepth;
+
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+uniform Material material;
+uniform float depthRange;
+
+void main()
+{
+    vec4 albedo = texture(material.texture_diffuse1, TexCoords);
+    if (albedo.a < 0.5)
+        discard;
+    Albedo = vec4(albedo.rgb, 1.0);
+    NormalDepth = vec4(normalize(Normal) * 0.5 + 0.5, ViewDepth / depthRange);
+}
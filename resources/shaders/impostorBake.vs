@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out float ViewDepth;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec4 viewPos = view * vec4(aPos, 1.0);
+    // linear distance from the eye, the bake camera sits on the bounding sphere
+    ViewDepth = -viewPos.z;
+    TexCoords = aTexCoords;
+    Normal = aNormal;
+    gl_Position = projection * viewPos;
+}
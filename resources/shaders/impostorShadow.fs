@@ -0,0 +1,27 @@
+#version 330 core
+// depth only impostors for the dynamic shadow maps, impostor.vs with SHADOW_CASTER faces the quad to the light.
+// The blended coverage of the four frames cuts the crown out like impostor.fs, the depth stays on the quad.
+in vec4 LocalUV01;
+in vec4 LocalUV23;
+flat in vec2 BaseFrame;
+flat in vec4 FrameWeights;
+
+uniform sampler2D albedoAtlas;
+uniform int framesPerSide;
+
+void main()
+{
+    vec2 localUV[4] = vec2[](LocalUV01.xy, LocalUV01.zw, LocalUV23.xy, LocalUV23.zw);
+    vec2 frameOffset[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0));
+
+    float coverage = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 uv = localUV[i];
+        if (FrameWeights[i] == 0.0 || any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+            continue;
+        vec2 atlasUV = (BaseFrame + frameOffset[i] + uv) / float(framesPerSide);
+        coverage += texture(albedoAtlas, atlasUV).a * FrameWeights[i];
+    }
+    if (coverage < 0.5)
+        discard;
+}
@@ -1,7 +1,10 @@
 #version 330 core
+// EvalSH() comes from shared.glsl
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 Normal;
+flat in vec3 Tint;
 
 uniform sampler2D texture_diffuse;
 
@@ -13,8 +16,10 @@ struct Material {
 };
 
 uniform Material material;
-
 void main()
 {
-  FragColor = texture(texture_diffuse, TexCoords);
-}
\ No newline at end of file
+  vec4 color = texture(texture_diffuse, TexCoords);
+  // unlit unless the skybox ambient is on
+  vec3 ambient = mix(vec3(1.0), EvalSH(normalize(Normal)), shParams.y);
+  FragColor = vec4(color.rgb * Tint * ambient, color.a);
+}
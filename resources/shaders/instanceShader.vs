@@ -2,17 +2,38 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 instanceMatrix;
+layout (location = 5) in vec3 instancePosition;
+layout (location = 6) in vec2 instanceScaleYaw;
 
 out vec2 TexCoords;
 out vec3 Normal;
+flat out vec3 Tint;
 
 uniform mat4 projection;
 uniform mat4 view;
 
+// stable per instance random number, the position is used since culling reorders the instances every frame
+float instanceHash(vec3 p)
+{
+    return fract(sin(dot(p, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
 void main()
 {
+    // rebuild the model matrix: rotation around y, uniform scale and translation
+    float scale = instanceScaleYaw.x;
+    float c = cos(instanceScaleYaw.y);
+    float s = sin(instanceScaleYaw.y);
+    mat4 instanceMatrix = mat4(
+            vec4(c * scale, 0.0, -s * scale, 0.0),
+            vec4(0.0, scale, 0.0, 0.0),
+            vec4(s * scale, 0.0, c * scale, 0.0),
+            vec4(instancePosition, 1.0));
+
     gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0);
     TexCoords = aTexCoords;
-    Normal = aNormal;
+    Normal = mat3(instanceMatrix) * aNormal;
+
+    float h = instanceHash(instancePosition);
+    Tint = mix(vec3(0.85, 0.9, 0.8), vec3(1.1, 1.05, 0.95), h);
 }
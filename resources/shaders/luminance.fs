@@ -0,0 +1,27 @@
+#version 330 core
+// log luminance of the HDR color for AutoExposure, one texel of the reduction target covers many screen pixels,
+// so it averages four bilinear taps spread over its footprint. The mip chain of the target averages the logs,
+// the 1x1 mip ends up as the log of the geometric mean.
+layout (location = 0) out float LogLuminance;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// size of one target texel in uv
+uniform vec2 footprint;
+
+float Luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main()
+{
+    vec2 t = footprint * 0.25;
+    float sum = log(max(Luma(texture(source, TexCoords + vec2(-t.x, -t.y)).rgb), 1e-4))
+              + log(max(Luma(texture(source, TexCoords + vec2( t.x, -t.y)).rgb), 1e-4))
+              + log(max(Luma(texture(source, TexCoords + vec2(-t.x,  t.y)).rgb), 1e-4))
+              + log(max(Luma(texture(source, TexCoords + vec2( t.x,  t.y)).rgb), 1e-4));
+    // clamped so a NaN or an infinite pixel can't poison the whole mean
+    LogLuminance = clamp(sum * 0.25, -10.0, 10.0);
+}
\ No newline at end of file
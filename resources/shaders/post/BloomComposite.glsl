@@ -0,0 +1,8 @@
+// adds the blurred bright parts (Bloom), the mip chain sums one copy per level
+uniform sampler2D bloomBlur;
+uniform float bloomStrength;
+
+vec3 BloomComposite(vec3 color, vec2 uv)
+{
+    return color + texture(bloomBlur, uv).rgb * bloomStrength;
+}
\ No newline at end of file
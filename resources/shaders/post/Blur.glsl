@@ -0,0 +1,11 @@
+// 3x3 blur, the "Blur" effect (EFFECT 1 of the old framebuffer.fs)
+vec3 Blur(vec3 color, vec2 uv, vec2 texel)
+{
+    const float offset = 1.0 / 300.0;
+    vec3 result = color * 4.0;
+    result += (FETCH(uv + vec2(-offset, 0.0)) + FETCH(uv + vec2(offset, 0.0))
+             + FETCH(uv + vec2(0.0, -offset)) + FETCH(uv + vec2(0.0, offset))) * 2.0;
+    result += FETCH(uv + vec2(-offset, -offset)) + FETCH(uv + vec2(offset, -offset))
+            + FETCH(uv + vec2(-offset, offset)) + FETCH(uv + vec2(offset, offset));
+    return result / 16.0;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+// the look and the color grade in one trilinear fetch of the 3D LUT baked by ColorGrading,
+// texel centers so the ends of the [0, 1] range hit the first and the last entry
+uniform sampler3D colorLut;
+uniform float lutSize;
+
+vec3 ColorLut(vec3 color, vec2 uv)
+{
+    vec3 coords = clamp(color, 0.0, 1.0) * ((lutSize - 1.0) / lutSize) + 0.5 / lutSize;
+    return texture(colorLut, coords).rgb;
+}
\ No newline at end of file
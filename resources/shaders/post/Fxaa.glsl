@@ -0,0 +1,31 @@
+// edge antialiasing on the final color in the spirit of FXAA: the luma of the 4 neighbours finds the edge
+// direction, the pixel is blended with two taps along the edge, or four if that stays inside the local range
+uniform float fxaaEdgeThreshold;
+
+float FxaaLuma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+vec3 Fxaa(vec3 color, vec2 uv, vec2 texel)
+{
+    float lumaNW = FxaaLuma(FETCH(uv + vec2(-texel.x, texel.y)));
+    float lumaNE = FxaaLuma(FETCH(uv + vec2(texel.x, texel.y)));
+    float lumaSW = FxaaLuma(FETCH(uv + vec2(-texel.x, -texel.y)));
+    float lumaSE = FxaaLuma(FETCH(uv + vec2(texel.x, -texel.y)));
+    float lumaM = FxaaLuma(color);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(0.0312, lumaMax * fxaaEdgeThreshold))
+        return color;
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * 0.125, 1.0 / 128.0);
+    float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+    direction = clamp(direction * scale, vec2(-8.0), vec2(8.0)) * texel;
+
+    vec3 rgbNear = 0.5 * (FETCH(uv - direction / 6.0) + FETCH(uv + direction / 6.0));
+    vec3 rgbFar = rgbNear * 0.5 + 0.25 * (FETCH(uv - direction * 0.5) + FETCH(uv + direction * 0.5));
+    float lumaFar = FxaaLuma(rgbFar);
+    return lumaFar < lumaMin || lumaFar > lumaMax ? rgbNear : rgbFar;
+}
\ No newline at end of file
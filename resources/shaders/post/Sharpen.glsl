@@ -0,0 +1,9 @@
+// unsharp mask against the 4 direct neighbours
+uniform float sharpenAmount;
+
+vec3 Sharpen(vec3 color, vec2 uv, vec2 texel)
+{
+    vec3 neighbours = FETCH(uv + vec2(-texel.x, 0.0)) + FETCH(uv + vec2(texel.x, 0.0))
+                    + FETCH(uv + vec2(0.0, -texel.y)) + FETCH(uv + vec2(0.0, texel.y));
+    return max(color + (color * 4.0 - neighbours) * sharpenAmount, vec3(0.0));
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+// exposure tone mapping and gamma correction of the HDR color
+uniform float exposure;
+uniform float gamma;
+
+vec3 ToneMap(vec3 color, vec2 uv)
+{
+    vec3 result = vec3(1.0) - exp(-color * exposure);
+    return pow(result, vec3(1.0 / gamma));
+}
\ No newline at end of file
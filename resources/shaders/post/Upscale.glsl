@@ -0,0 +1,28 @@
+// Catmull-Rom upscale of the input to the output resolution, used instead of the bilinear fetch by the last
+// post pass when the scene is rendered below the window size (PostChain::bicubicUpscale). The 4x4 kernel is
+// folded into 5 bilinear taps, its corners are dropped as their weights are tiny.
+vec3 Upscale(vec2 uv)
+{
+    vec2 position = uv / sourceTexel;
+    vec2 center = floor(position - 0.5) + 0.5;
+    vec2 f = position - center;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+    // the middle two taps in one bilinear fetch
+    vec2 w12 = w1 + w2;
+    vec2 t0 = (center - 1.0) * sourceTexel;
+    vec2 t12 = (center + w2 / w12) * sourceTexel;
+    vec2 t3 = (center + 2.0) * sourceTexel;
+
+    float w = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+    vec3 color = texture(source, vec2(t12.x, t0.y)).rgb * (w12.x * w0.y)
+               + texture(source, vec2(t0.x, t12.y)).rgb * (w0.x * w12.y)
+               + texture(source, t12).rgb * (w12.x * w12.y)
+               + texture(source, vec2(t3.x, t12.y)).rgb * (w3.x * w12.y)
+               + texture(source, vec2(t12.x, t3.y)).rgb * (w12.x * w3.y);
+    // the negative lobes can ring below zero at hard edges
+    return max(color / w, 0.0);
+}
\ No newline at end of file
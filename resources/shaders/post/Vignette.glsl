@@ -0,0 +1,9 @@
+// darkens towards the corners
+uniform float vignetteStrength;
+
+vec3 Vignette(vec3 color, vec2 uv)
+{
+    vec2 centered = uv * 2.0 - 1.0;
+    float falloff = clamp(1.0 - dot(centered, centered) * 0.5 * vignetteStrength, 0.0, 1.0);
+    return color * falloff * falloff;
+}
\ No newline at end of file
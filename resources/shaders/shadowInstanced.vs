@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in vec3 instancePosition;
+layout (location = 6) in vec2 instanceScaleYaw;
+
+// depth only instances for the dynamic shadow maps, same instance transform as instanceShader.vs
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    float scale = instanceScaleYaw.x;
+    float c = cos(instanceScaleYaw.y);
+    float s = sin(instanceScaleYaw.y);
+    mat4 instanceMatrix = mat4(
+            vec4(c * scale, 0.0, -s * scale, 0.0),
+            vec4(0.0, scale, 0.0, 0.0),
+            vec4(s * scale, 0.0, c * scale, 0.0),
+            vec4(instancePosition, 1.0));
+
+    gl_Position = projection * view * instanceMatrix * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+// functions shared by the lighting shaders, put after the #version and #define lines of their fragment stage
+// (Shader::InjectDefines(), ShaderVariants::fragmentLibrary)
+
+// image based ambient from the skybox, see SkyboxAmbient
+layout (std140) uniform AmbientSH {
+    vec4 shCoefficients[9];
+    vec4 shParams;          // x: intensity, y: weight against the flat ambient
+};
+
+// diffuse ambient light arriving at a surface with world space normal n, the basis is SkyboxAmbient::Basis()
+vec3 EvalSH(vec3 n)
+{
+    vec3 result = shCoefficients[0].rgb * 0.282095
+                + shCoefficients[1].rgb * 0.488603 * n.y
+                + shCoefficients[2].rgb * 0.488603 * n.z
+                + shCoefficients[3].rgb * 0.488603 * n.x
+                + shCoefficients[4].rgb * 1.092548 * n.x * n.y
+                + shCoefficients[5].rgb * 1.092548 * n.y * n.z
+                + shCoefficients[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0)
+                + shCoefficients[7].rgb * 1.092548 * n.x * n.z
+                + shCoefficients[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+    return max(result, vec3(0.0)) * shParams.x;
+}
+
+#ifdef SSAO
+// half resolution occlusion + linear depth
+uniform sampler2D ssaoTexture;
+
+// joint bilateral upsample of the half resolution occlusion (see Ssao): the 2x2 texels around the pixel weighted
+// bilinearly and by how close their depth is to the pixel's own, so edges keep their own occlusion
+float UpsampleSSAO(float depth)
+{
+    vec2 halfPixel = gl_FragCoord.xy * 0.5 - 0.5;
+    ivec2 base = ivec2(floor(halfPixel));
+    vec2 f = halfPixel - vec2(base);
+    ivec2 size = textureSize(ssaoTexture, 0) - 1;
+    float sum = 0.0;
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 aoDepth = texelFetch(ssaoTexture, clamp(base + offset, ivec2(0), size), 0).xy;
+        float bilinear = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        float weight = (bilinear + 1e-3) / (1e-3 + abs(depth - aoDepth.y) / depth);
+        sum += aoDepth.x * weight;
+        total += weight;
+    }
+    return sum / total;
+}
+#endif
@@ -0,0 +1,49 @@
+#version 330 core
+// ambient occlusion at half resolution: a hemisphere kernel around the normal, rotated per pixel by a tiled
+// 4x4 noise texture so few samples give noise the blur can remove instead of banding
+layout (location = 0) out vec2 AoDepth;
+
+in vec2 TexCoords;
+
+uniform sampler2D normalDepth;
+uniform sampler2D noise;
+
+uniform vec3 samples[32];
+uniform int sampleCount;
+uniform float radius;
+uniform float bias;
+uniform float power;
+uniform float emptyDepth;
+uniform mat4 projection;
+// tan(fov / 2) * aspect, tan(fov / 2): view ray through a pixel at depth 1
+uniform vec2 viewRay;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 center = texelFetch(normalDepth, pixel, 0);
+    if (center.w >= emptyDepth) {
+        AoDepth = vec2(1.0, center.w);
+        return;
+    }
+    vec3 position = vec3((TexCoords * 2.0 - 1.0) * viewRay * center.w, -center.w);
+    vec3 normal = center.xyz;
+
+    // Gram-Schmidt of the random vector against the normal gives the rotated tangent frame
+    vec3 randomVector = vec3(texelFetch(noise, pixel & 3, 0).xy, 0.0);
+    vec3 tangent = normalize(randomVector - normal * dot(randomVector, normal));
+    mat3 TBN = mat3(tangent, cross(normal, tangent), normal);
+
+    ivec2 size = textureSize(normalDepth, 0);
+    float occlusion = 0.0;
+    for (int i = 0; i < sampleCount; i++) {
+        vec3 samplePos = position + TBN * samples[i] * radius;
+        vec4 offset = projection * vec4(samplePos, 1.0);
+        vec2 uv = offset.xy / offset.w * 0.5 + 0.5;
+        float sampleDepth = texelFetch(normalDepth, clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1), 0).w;
+        // occluders far in front of the pixel (silhouettes) fade out instead of darkening it
+        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(center.w - sampleDepth));
+        occlusion += (sampleDepth <= -samplePos.z - bias ? 1.0 : 0.0) * rangeCheck;
+    }
+    AoDepth = vec2(pow(1.0 - occlusion / float(sampleCount), power), center.w);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#version 330 core
+// one direction of a separable depth aware blur of the half resolution occlusion: taps across a depth
+// discontinuity lose their weight, so occlusion doesn't bleed between foreground and background
+layout (location = 0) out vec2 AoDepth;
+
+in vec2 TexCoords;
+
+uniform sampler2D image;
+uniform vec2 direction;
+// relative depth difference at which a tap stops counting
+uniform float sharpness;
+
+const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(image, 0);
+    vec2 center = texelFetch(image, pixel, 0).xy;
+    float sum = center.x * weights[0];
+    float total = weights[0];
+    for (int i = 1; i < 5; i++) {
+        for (int side = -1; side <= 1; side += 2) {
+            vec2 tap = texelFetch(image, clamp(pixel + ivec2(direction) * i * side, ivec2(0), size - 1), 0).xy;
+            float weight = weights[i] * max(0.0, 1.0 - abs(tap.y - center.y) / (center.y * sharpness));
+            sum += tap.x * weight;
+            total += weight;
+        }
+    }
+    AoDepth = vec2(sum / total, center.y);
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+// half resolution view space normal + linear depth from the deferred G-buffer, one texel of every 2x2 block
+layout (location = 0) out vec4 NormalDepth;
+
+in vec2 TexCoords;
+
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 view;
+uniform float cameraNear;
+uniform float cameraFar;
+uniform float emptyDepth;
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p.x, p.y, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 pixel = min(ivec2(gl_FragCoord.xy) * 2, textureSize(gDepth, 0) - 1);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if (depth == 1.0) {
+        NormalDepth = vec4(0.0, 0.0, 1.0, emptyDepth);
+        return;
+    }
+    vec3 normal = octDecode(texelFetch(gNormal, pixel, 0).xy * 2.0 - 1.0);
+    float linearDepth = cameraNear * cameraFar / (cameraFar - depth * (cameraFar - cameraNear));
+    NormalDepth = vec4(normalize(mat3(view) * normal), linearDepth);
+}
\ No newline at end of file
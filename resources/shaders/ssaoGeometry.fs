@@ -0,0 +1,11 @@
+#version 330 core
+// half resolution view space normal + linear depth for the SSAO pass
+layout (location = 0) out vec4 NormalDepth;
+
+in vec3 ViewNormal;
+in float ViewDepth;
+
+void main()
+{
+    NormalDepth = vec4(normalize(ViewNormal), ViewDepth);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 ViewNormal;
+out float ViewDepth;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    ViewNormal = mat3(view) * mat3(model) * aNormal;
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
\ No newline at end of file
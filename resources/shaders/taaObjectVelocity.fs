@@ -0,0 +1,11 @@
+#version 330 core
+// motion of an object that moved since the last frame, over the camera motion of taaVelocity.fs
+layout (location = 0) out vec2 Velocity;
+
+in vec4 CurrentPosition;
+in vec4 PreviousPosition;
+
+void main()
+{
+    Velocity = (CurrentPosition.xy / CurrentPosition.w - PreviousPosition.xy / PreviousPosition.w) * 0.5;
+}
\ No newline at end of file
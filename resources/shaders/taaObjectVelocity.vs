@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// same transform as cityShader.vs, so it lands on the depth the scene pass wrote
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat4 previousModel;
+uniform mat4 view;
+// jittered, like the scene was drawn
+uniform mat4 projection;
+// unjittered, the velocity doesn't contain the jitter
+uniform mat4 currentViewProjection;
+uniform mat4 previousViewProjection;
+
+out vec4 CurrentPosition;
+out vec4 PreviousPosition;
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+    CurrentPosition = currentViewProjection * vec4(FragPos, 1.0);
+    PreviousPosition = previousViewProjection * previousModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#version 330 core
+// TAA resolve, see Taa in taa.h. Runs at the history resolution, which is the output resolution when upsampling.
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D current;
+uniform sampler2D history;
+uniform sampler2D velocity;
+uniform sampler2D depth;
+// render resolution of current, velocity and depth
+uniform vec2 currentSize;
+// this frame's jitter in uv
+uniform vec2 jitter;
+uniform float blend;
+uniform bool historyValid;
+
+// HDR colors are blended as c / (1 + max channel) and brought back after
+vec3 Compress(vec3 color)
+{
+    return color / (1.0 + max(color.r, max(color.g, color.b)));
+}
+
+vec3 Expand(vec3 color)
+{
+    return color / max(1.0 - max(color.r, max(color.g, color.b)), 1e-4);
+}
+
+vec3 ToYCoCg(vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 FromYCoCg(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+// moves the history toward the neighborhood mean until it is inside the box
+vec3 ClipToBox(vec3 history, vec3 boxMin, vec3 boxMax)
+{
+    vec3 center = 0.5 * (boxMax + boxMin);
+    vec3 extent = 0.5 * (boxMax - boxMin) + 1e-5;
+    vec3 offset = history - center;
+    vec3 units = abs(offset / extent);
+    float largest = max(units.x, max(units.y, units.z));
+    return largest > 1.0 ? center + offset / largest : history;
+}
+
+void main()
+{
+    // the scene point of this pixel was rendered jitter further, in render resolution pixels
+    vec2 samplePosition = (TexCoords + jitter) * currentSize;
+    ivec2 last = ivec2(currentSize) - 1;
+    ivec2 center = clamp(ivec2(floor(samplePosition)), ivec2(0), last);
+    vec2 offset = samplePosition - (vec2(center) + 0.5);
+
+    // mean and variance of the 3x3 neighborhood, and its closest depth for the velocity (so edges of
+    // foreground objects carry their own motion)
+    vec3 sum = vec3(0.0), squares = vec3(0.0);
+    float closestDepth = 1.0;
+    ivec2 closest = center;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 p = clamp(center + ivec2(x, y), ivec2(0), last);
+            vec3 c = ToYCoCg(Compress(texelFetch(current, p, 0).rgb));
+            sum += c;
+            squares += c * c;
+            float d = texelFetch(depth, p, 0).r;
+            if (d < closestDepth) {
+                closestDepth = d;
+                closest = p;
+            }
+        }
+    }
+    vec3 mean = sum / 9.0;
+    vec3 deviation = sqrt(max(squares / 9.0 - mean * mean, 0.0));
+    vec3 currentColor = ToYCoCg(Compress(texelFetch(current, center, 0).rgb));
+
+    vec2 previousUV = TexCoords - texelFetch(velocity, closest, 0).rg;
+    vec3 previous = ToYCoCg(Compress(texture(history, previousUV).rgb));
+    previous = ClipToBox(previous, mean - 1.25 * deviation, mean + 1.25 * deviation);
+
+    // a sample far from this pixel's center says less about it; matters most when upsampling
+    float weight = blend * mix(0.25, 1.0, exp(-2.9 * dot(offset, offset)));
+    bool outside = any(lessThan(previousUV, vec2(0.0))) || any(greaterThan(previousUV, vec2(1.0)));
+    if (!historyValid || outside)
+        weight = 1.0;
+
+    vec3 result = mix(previous, currentColor, weight);
+    FragColor = vec4(Expand(FromYCoCg(result)), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+// camera motion of every pixel: its position from the scene depth, projected with last frame's view-projection.
+// The result is unjittered uv now minus uv last frame, the resolve reads the history at uv - velocity.
+layout (location = 0) out vec2 Velocity;
+
+in vec2 TexCoords;
+
+uniform sampler2D depth;
+// previous view-projection * inverse(jittered view-projection of this frame)
+uniform mat4 reprojection;
+// this frame's jitter in NDC
+uniform vec2 jitter;
+
+void main()
+{
+    vec4 position = vec4(TexCoords * 2.0 - 1.0, texture(depth, TexCoords).r * 2.0 - 1.0, 1.0);
+    vec4 previous = reprojection * position;
+    Velocity = ((position.xy - jitter) - previous.xy / previous.w) * 0.5;
+}
\ No newline at end of file
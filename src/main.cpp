@@ -13,6 +13,32 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/impostor.h>
+#include <learnopengl/instancing.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/clustered_lighting.h>
+#include <learnopengl/light_store.h>
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/light_benchmark.h>
+#include <learnopengl/deferred.h>
+#include <learnopengl/depth_prepass.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/sh_ambient.h>
+#include <learnopengl/static_scene.h>
+#include <learnopengl/baked_lighting.h>
+#include <learnopengl/lightmap.h>
+#include <learnopengl/ssao.h>
+#include <learnopengl/cascaded_shadows.h>
+#include <learnopengl/bloom.h>
+#include <learnopengl/render_graph.h>
+#include <learnopengl/post_chain.h>
+#include <learnopengl/color_grading.h>
+#include <learnopengl/auto_exposure.h>
+#include <learnopengl/render_targets.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/resolution_benchmark.h>
+#include <learnopengl/taa.h>
 
 #include <iostream>
 
@@ -27,16 +53,28 @@ void processInput(GLFWwindow *window);
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 unsigned int loadCubemap(vector<std::string> faces);
+vector<std::string> skyboxFaces(int skybox);
 void setLights(Shader lightingShader, float currentFrame);
-void renderQuad();
-
-void drawCity(Shader modelShader, Model cityModel, Model stoneBridge, Model stonePlatformB);
-void drawTrees(Shader modelShader, Model treeModel, int amount);
+const VertexFormat &skyboxFormat();
+
+std::vector<std::string> lightDefines(int pointLightCount, bool lightmapped = false);
+bool lightmapMatches(const Lightmap &lightmap);
+void setPostStages(PostChain &post);
+void checkRenderGraph(Bloom &bloom, PostChain &post, int width, int height);
+void drawSkybox(Shader &skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture,
+                const glm::mat4 &projection, const glm::mat4 &view);
+void drawCity(Shader &modelShader, Model *models[STATIC_MODEL_COUNT], bool depthOnly = false,
+              const Lightmap *lightmap = nullptr, const ClusteredLighting *lighting = nullptr);
+void drawTrees(Shader &modelShader, Shader &impostorShader, InstanceSet &forest, Impostor &treeImpostor,
+               const glm::mat4 &projection, const glm::mat4 &view);
+void resizeForest(InstanceSet &forest, vector<InstanceHandle> &handles, int amount);
+void forestBounds(int amount, glm::vec3 &boundsMin, glm::vec3 &boundsMax);
 
 // settings
 const unsigned int SCR_WIDTH = 1800;
 const unsigned int SCR_HEIGHT = 900;
-
+const float CAMERA_NEAR = 0.1f;
+const float CAMERA_FAR = 100.0f;
 // camera
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -47,17 +85,6 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-struct PointLight {
-    glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
-    float constant;
-    float linear;
-    float quadratic;
-};
-
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -68,7 +95,6 @@ struct ProgramState {
     glm::vec3 bridgePossition = glm::vec3(0.0f);
     float bridgeScale = 0.5f;
     bool wireframe = false;
-    PointLight pointLight;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -76,10 +102,6 @@ struct ProgramState {
     glm::vec3 dirLightAmbient = glm::vec3(0.2f, 0.2f, 0.2f);
     glm::vec3 dirLightDiffuse = glm::vec3(0.5f, 0.5f, 0.5f);
     glm::vec3 dirLightSpecular = glm::vec3(1.0f, 1.0f, 1.0f);
-    glm::vec3 pointLightPosition = glm::vec3(8.5f, 3.2f, 4.5f);
-    glm::vec3 pointLightAmbient = glm::vec3(0.05f, 0.05f, 0.05f);
-    glm::vec3 pointLightDiffuse = glm::vec3(0.94f, 0.98f, 0.78f);
-    glm::vec3 pointLightSpecular = glm::vec3(0.94f, 0.98f, 0.78f);
 
     bool hdr = true;
     float hdrExposure = 1.0f;
@@ -90,10 +112,62 @@ struct ProgramState {
     bool cameraDebug = true;
     bool lightsDebug = false;
 
+    int treeAmount = 50;
+    bool impostorsEnabled = true;
+    float impostorDistance = 60.0f;
+    bool gpuCulling = true;
+
+    int pointLightCount = 2;
+    bool gpuTimings = false;
+    bool deferredShading = false;
+    bool depthPrepass = false;
+    bool dirLightEnabled = true;
+    bool spotlightEnabled = true;
+    int skybox = 0;
+    bool shAmbient = true;
+    float shIntensity = 1.0f;
+    bool lightmapEnabled = true;
+    bool ssaoEnabled = true;
+    float ssaoRadius = 0.5f;
+    int ssaoSamples = 16;
+    float ssaoPower = 1.5f;
+    bool shadowsEnabled = true;
+    bool shadowCaching = true;
+    int bloomLevels = Bloom::MAX_LEVELS;
+    float bloomThreshold = 1.0f;
+    float bloomKnee = 0.5f;
+    bool sharpen = false;
+    float sharpenAmount = 0.3f;
+    bool colorGrade = false;
+    float gradeContrast = 1.1f;
+    float gradeSaturation = 1.2f;
+    bool vignette = false;
+    float vignetteStrength = 0.5f;
+    bool fxaa = true;
+    int colorLook = 0;
+    int lutSize = 32;
+    bool autoExposure = false;
+    float exposureKey = 0.5f;
+    float exposureSpeed = 1.5f;
+    float renderScale = 1.0f;
+    bool dynamicResolution = false;
+    float targetFrameMilliseconds = 16.6f;
+    float minRenderScale = 0.5f;
+    float maxRenderScale = 1.0f;
+    bool bicubicUpscale = true;
+    bool taa = false;
+    bool taaUpsample = true;
+    float taaBlend = 0.1f;
+    // TargetFormat::Id per RenderTargets::Target
+    int targetFormats[RenderTargets::TARGET_COUNT] = { TargetFormat::R11F_G11F_B10F, TargetFormat::R11F_G11F_B10F,
+                                                       TargetFormat::RGBA16F, TargetFormat::RGBA16F };
+
     void SaveToFile(std::string filename);
     void LoadFromFile(std::string filename);
 };
 
+// one value a line in this order, only append new settings: the lightmap baker reads the directional light and the
+// skybox by their position (BakedLighting::ReadProgramState())
 void ProgramState::SaveToFile(std::string filename) {
     std::ofstream out(filename);
     out << clearColor.r << '\n'
@@ -133,7 +207,54 @@ void ProgramState::SaveToFile(std::string filename) {
         << bridgePossition[0] << '\n'
         << bridgePossition[1] << '\n'
         << bridgePossition[2] << '\n'
-        << bridgeScale << '\n';
+        << bridgeScale << '\n'
+        << treeAmount << '\n'
+        << impostorsEnabled << '\n'
+        << impostorDistance << '\n'
+        << gpuCulling << '\n'
+        << pointLightCount << '\n'
+        << gpuTimings << '\n'
+        << deferredShading << '\n'
+        << depthPrepass << '\n'
+        << dirLightEnabled << '\n'
+        << spotlightEnabled << '\n'
+        << skybox << '\n'
+        << shAmbient << '\n'
+        << shIntensity << '\n'
+        << lightmapEnabled << '\n'
+        << ssaoEnabled << '\n'
+        << ssaoRadius << '\n'
+        << ssaoSamples << '\n'
+        << ssaoPower << '\n'
+        << shadowsEnabled << '\n'
+        << shadowCaching << '\n'
+        << bloomLevels << '\n'
+        << bloomThreshold << '\n'
+        << bloomKnee << '\n'
+        << sharpen << '\n'
+        << sharpenAmount << '\n'
+        << colorGrade << '\n'
+        << gradeContrast << '\n'
+        << gradeSaturation << '\n'
+        << vignette << '\n'
+        << vignetteStrength << '\n'
+        << fxaa << '\n'
+        << colorLook << '\n'
+        << lutSize << '\n'
+        << autoExposure << '\n'
+        << exposureKey << '\n'
+        << exposureSpeed << '\n'
+        << renderScale << '\n'
+        << dynamicResolution << '\n'
+        << targetFrameMilliseconds << '\n'
+        << minRenderScale << '\n'
+        << maxRenderScale << '\n'
+        << bicubicUpscale << '\n'
+        << taa << '\n'
+        << taaUpsample << '\n'
+        << taaBlend << '\n';
+    for (int format : targetFormats)
+        out << format << '\n';
 
 }
 
@@ -177,11 +298,86 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> bridgePossition[0]
            >> bridgePossition[1]
            >> bridgePossition[2]
-           >> bridgeScale;
+           >> bridgeScale
+           >> treeAmount
+           >> impostorsEnabled
+           >> impostorDistance
+           >> gpuCulling
+           >> pointLightCount
+           >> gpuTimings
+           >> deferredShading
+           >> depthPrepass
+           >> dirLightEnabled
+           >> spotlightEnabled
+           >> skybox
+           >> shAmbient
+           >> shIntensity
+           >> lightmapEnabled
+           >> ssaoEnabled
+           >> ssaoRadius
+           >> ssaoSamples
+           >> ssaoPower
+           >> shadowsEnabled
+           >> shadowCaching
+           >> bloomLevels
+           >> bloomThreshold
+           >> bloomKnee
+           >> sharpen
+           >> sharpenAmount
+           >> colorGrade
+           >> gradeContrast
+           >> gradeSaturation
+           >> vignette
+           >> vignetteStrength
+           >> fxaa
+           >> colorLook
+           >> lutSize
+           >> autoExposure
+           >> exposureKey
+           >> exposureSpeed
+           >> renderScale
+           >> dynamicResolution
+           >> targetFrameMilliseconds
+           >> minRenderScale
+           >> maxRenderScale
+           >> bicubicUpscale
+           >> taa
+           >> taaUpsample
+           >> taaBlend;
+        for (int i = 0; i < RenderTargets::TARGET_COUNT; i++) {
+            in >> targetFormats[i];
+            if (!RenderTargets::Allows((RenderTargets::Target) i, targetFormats[i]))
+                targetFormats[i] = TargetFormat::RGBA16F;
+        }
+        // "Ruzicasti" used to be an effect, it's a look now
+        if (effectSelected == 2) {
+            effectSelected = 0;
+            colorLook = 1;
+        }
     }
 }
 
 ProgramState *programState;
+GpuProfiler *gpuProfiler;
+ClusteredLighting *clusteredLighting;
+LightStore *lightStore;
+LightBenchmark *lightBenchmark;
+DepthPrepass *depthPrepass;
+SkyboxAmbient *skyboxAmbient;
+vector<SkyboxAmbient::Projection> *skyboxProjections;
+Lightmap *staticLightmap;
+Bloom *bloomChain;
+PostChain *postChain;
+ColorGrading *colorGrading;
+AutoExposure *autoExposure;
+RenderTargets *renderTargets;
+DynamicResolution *dynamicResolution;
+ResolutionBenchmark *resolutionBenchmark;
+Taa *temporalAA;
+RenderGraph *renderGraph;
+// estimated memory traffic of the frame's screen sized passes, for the overlay
+std::vector<std::pair<const char *, size_t>> frameTraffic;
+CascadedShadows *cascadedShadows;
 
 void DrawImGui(ProgramState *programState);
 
@@ -219,6 +415,8 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // linked shader permutations are kept between runs when the driver can hand them out
+    ProgramBinaryCache::Get().Init("shader_cache");
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
@@ -247,11 +445,28 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader screenShader("resources/shaders/framebuffer.vs", "resources/shaders/framebuffer.fs");
-    Shader ourShader("resources/shaders/cityShader.vs", "resources/shaders/cityShader.fs");
+    // permutations picked from ProgramState every frame, see lightDefines()
+    ShaderVariants cityShaders("resources/shaders/cityShader.vs", "resources/shaders/cityShader.fs");
+    cityShaders.fragmentLibrary = "resources/shaders/shared.glsl";
     Shader skyboxShader("resources/shaders/skyboxShader.vs", "resources/shaders/skyboxShader.fs");
-    Shader instanceShader("resources/shaders/instanceShader.vs", "resources/shaders/instanceShader.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    // EvalSH() of the ambient comes from shared.glsl
+    Shader instanceShader("resources/shaders/instanceShader.vs", "resources/shaders/instanceShader.fs", nullptr, {},
+                          "resources/shaders/shared.glsl");
+    Shader impostorShader("resources/shaders/impostor.vs", "resources/shaders/impostor.fs", nullptr, {},
+                          "resources/shaders/shared.glsl");
+
+    // every program has to be fed completely by the vertex format it is drawn with
+    cityShaders.onCreate = [](Shader &shader) {
+        // the lightmap format is the mesh format plus the second uv set only LIGHTMAP variants read
+        LightmapVertexFormat().Validate(shader.ID, "cityShader");
+        SkyboxAmbient::BindBlock(shader);
+        Lightmap::SetSamplers(shader);
+        shader.setInt("material.diffuse", 0);
+        shader.setInt("material.specular", 1);
+    };
+    skyboxFormat().Validate(skyboxShader.ID, "skyboxShader");
+    InstanceSet::Format().Validate(instanceShader.ID, "instanceShader");
+    Impostor::Format().Validate(impostorShader.ID, "impostor");
     // load models
     // -----------
     Model cityModel("resources/objects/SH-Cartoon/SH-Cartoon.obj");
@@ -262,6 +477,13 @@ int main() {
     stoneBridge.SetShaderTextureNamePrefix("material.");
     Model treeModel("resources/objects/Tree/Hand painted Tree.obj");
     treeModel.SetShaderTextureNamePrefix("material.");
+    // in StaticModel order
+    Model *staticModels[STATIC_MODEL_COUNT] = { &cityModel, &stonePlatformB, &stoneBridge };
+
+    // baked directional and bounce light of the static models, see tools/lightmap_baker
+    Lightmap lightmap;
+    lightmap.Load("resources/lightmaps/city.lmap", staticModels);
+    staticLightmap = &lightmap;
 
 
     float skyboxVertices[] = {
@@ -323,8 +545,51 @@ int main() {
 
 
     // Instancing
-    unsigned int amount = 50;
-    treeModel.Instantiate(amount);
+    srand(glfwGetTime());
+    InstanceSet forest(treeModel);
+    vector<InstanceHandle> forestHandles;
+    resizeForest(forest, forestHandles, programState->treeAmount);
+    // Impostors for the far away trees, baked once from 8x8 view directions
+    Impostor treeImpostor(treeModel);
+
+    // Lights, assigned to view space clusters every frame on all cores
+    ThreadPool threadPool;
+    ClusteredLighting lighting(threadPool);
+    clusteredLighting = &lighting;
+    // point and spot lights with their animation, from the scene file
+    LightStore lights;
+    lights.Load("resources/scene/lights.txt", lighting.lightThreshold);
+    lightStore = &lights;
+    LightBenchmark benchmark;
+    lightBenchmark = &benchmark;
+    GpuProfiler profiler;
+    gpuProfiler = &profiler;
+    // the scene framebuffer at the window size times ProgramState::renderScale, reallocated on resize
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    RenderTargets targets(windowWidth, windowHeight, programState->renderScale, programState->targetFormats);
+    renderTargets = &targets;
+    // Deferred shading, switched with ProgramState::deferredShading
+    DeferredRenderer deferred(targets.Width(), targets.Height());
+    MeshVertexFormat().Validate(deferred.geometryShader.ID, "gbuffer");
+    // Depth pre-pass for the forward path, switched with ProgramState::depthPrepass
+    DepthPrepass prepass(targets.Width(), targets.Height());
+    PositionVertexFormat().Validate(prepass.shader.ID, "depthPrepass");
+    depthPrepass = &prepass;
+    // Half resolution ambient occlusion, switched with ProgramState::ssaoEnabled
+    Ssao ssao(targets.Width(), targets.Height());
+    MeshVertexFormat().Validate(ssao.geometryShader.ID, "ssaoGeometry");
+    // Directional light shadows, the static cascades are cached, switched with ProgramState::shadowsEnabled
+    CascadedShadows shadows;
+    PositionVertexFormat().Validate(shadows.casterShader.ID, "shadowCaster");
+    InstanceSet::Format().Validate(shadows.instancedCasterShader.ID, "shadowInstanced");
+    Impostor::Format().Validate(shadows.impostorCasterShader.ID, "impostorShadow");
+    cascadedShadows = &shadows;
+    // local bounds of the static models, placed with the StaticScene transforms every frame for the shadow
+    // range and the per-object light lists
+    glm::vec3 staticBoundsMin[STATIC_MODEL_COUNT], staticBoundsMax[STATIC_MODEL_COUNT];
+    for (int i = 0; i < STATIC_MODEL_COUNT; i++)
+        staticModels[i]->GetBounds(staticBoundsMin[i], staticBoundsMax[i]);
 
     // Culling
     glFrontFace(GL_CW);
@@ -332,98 +597,101 @@ int main() {
     // Quad VAO
     // screen quad VAO
     unsigned int quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
     glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    VertexFormat flatQuadFormat = VertexFormat("flatQuad")
+            .Stream(4 * sizeof(float))
+            .Attribute("aPos", 0, 2, GL_FLOAT, 0)
+            .Attribute("aTexCoords", 1, 2, GL_FLOAT, 2 * sizeof(float));
+    quadVAO = flatQuadFormat.CreateVAO({ quadVBO });
 
     // skybox VAO
     unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)nullptr);
-    glEnableVertexAttribArray(0);
+    skyboxVAO = skyboxFormat().CreateVAO({ skyboxVBO });
 
     // Load skybox textures
-    vector<std::string> faces{
-            FileSystem::getPath("resources/textures/skybox/space2/px.png"),
-            FileSystem::getPath("resources/textures/skybox/space2/nx.png"),
-            FileSystem::getPath("resources/textures/skybox/space2/py.png"),
-            FileSystem::getPath("resources/textures/skybox/space2/ny.png"),
-            FileSystem::getPath("resources/textures/skybox/space2/pz.png"),
-            FileSystem::getPath("resources/textures/skybox/space2/nz.png")
-    };
-
-    unsigned int cubemapTexture = loadCubemap(faces);
-
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    // create 2 floating point color buffers (1 for normal rendering, other for brightness threshold values)
-    unsigned int colorBuffers[2];
-    glGenTextures(2, colorBuffers);
-    for (unsigned int i = 0; i < 2; i++)
-    {
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);  // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        // attach texture to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffers[i], 0);
+    programState->skybox = std::max(0, std::min(programState->skybox, SKYBOX_COUNT - 1));
+    int loadedSkybox = programState->skybox;
+    unsigned int cubemapTexture = loadCubemap(skyboxFaces(loadedSkybox));
+
+    // Ambient light of every bundled skybox as spherical harmonics, projected once and then read from the cache
+    SkyboxAmbient ambient(threadPool);
+    skyboxAmbient = &ambient;
+    vector<SkyboxAmbient::Projection> projections;
+    for (int i = 0; i < SKYBOX_COUNT; i++) {
+        projections.push_back(ambient.Load(FileSystem::getPath(std::string("resources/textures/skybox/") + SKYBOXES[i])));
+        std::cout << "SH ambient " << SKYBOXES[i] << ": " << projections[i].texels << " texels, decode "
+                  << projections[i].decodeMilliseconds << " ms, projection " << projections[i].projectMilliseconds
+                  << " ms" << (projections[i].fromCache ? " (cached)" : "") << std::endl;
     }
+    skyboxProjections = &projections;
+    SkyboxAmbient::BindBlock(instanceShader);
+    SkyboxAmbient::BindBlock(impostorShader);
+
+    // Progressive bloom at half resolution and below, switched with ProgramState::bloom
+    Bloom bloom(targets.Width(), targets.Height());
+    bloomChain = &bloom;
+
+    // post processing stages in the order they apply, see setPostStages()
+    PostChain post;
+    post.Declare("Blur", "Blur", PostChain::NEIGHBORHOOD);
+    post.Declare("Sharpen", "Sharpen", PostChain::NEIGHBORHOOD);
+    post.Declare("Bloom", "BloomComposite", PostChain::PER_PIXEL);
+    post.Declare("Tone mapping", "ToneMap", PostChain::PER_PIXEL);
+    post.Declare("Color LUT", "ColorLut", PostChain::PER_PIXEL);
+    post.Declare("Vignette", "Vignette", PostChain::PER_PIXEL);
+    post.Declare("FXAA", "Fxaa", PostChain::NEIGHBORHOOD);
+    postChain = &post;
+
+    // looks and the contrast/saturation grade baked into the 3D LUT of the ColorLut stage
+    ColorGrading grading;
+    grading.LoadDirectory("resources/luts");
+    colorGrading = &grading;
+
+    // exposure from the mean luminance of the HDR frame, read back a few frames late
+    AutoExposure exposure;
+    autoExposure = &exposure;
+
+    // render scale from the GPU frame time, and its stress test against a fixed scale
+    DynamicResolution resolution;
+    dynamicResolution = &resolution;
+    ResolutionBenchmark resolutionStress;
+    resolutionBenchmark = &resolutionStress;
+    bool resolutionWasDynamic = false;
+    int frameSamples = 0, sceneSamples = 0;
+
+    // the passes after the scene, declared every frame; culls the unused ones and aliases their transient targets
+    RenderGraph graph((GLADloadproc) glfwGetProcAddress);
+    renderGraph = &graph;
+    checkRenderGraph(bloom, post, targets.Width(), targets.Height());
+
+    // temporal anti-aliasing with optional upsampling to the window, switched with ProgramState::taa
+    Taa taa;
+    PositionVertexFormat().Validate(taa.objectVelocityShader.ID, "taaObjectVelocity");
+    temporalAA = &taa;
+    bool taaWasOn = false;
+    // static object transforms of the last frame, the ones that changed get their own velocity
+    std::vector<glm::mat4> previousTransforms;
+
+    targets.OnResize([&](int width, int height, int outputWidth, int outputHeight) {
+        deferred.Resize(width, height);
+        prepass.Resize(width, height);
+        ssao.Resize(width, height);
+        bloom.SetFormat(targets.Format(RenderTargets::BLOOM));
+        bloom.Resize(width, height);
+        post.SetFormat(targets.Format(RenderTargets::POST));
+        taa.SetHistoryFormat(targets.Format(RenderTargets::TAA_HISTORY));
+    });
 
-    // create a renderbuffer object for depth and stencil attachment (we won't be sampling these)
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT); // use a single renderbuffer object for both a depth AND stencil buffer.
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo); // now actually attach it
-    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-    glDrawBuffers(2, attachments);
-    // now that we actually created the framebuffer and added all attachments we want to check if it is actually complete now
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::FRAMEBUFFER:: RBO Framebuffer is not complete!" << endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "ERROR::FRAMEBUFFER:: Pingpong Framebuffer not complete!" << std::endl;
-    }
     // --------------------------------------------------------
 
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
-    ourShader.use();
-    ourShader.setInt("material.diffuse", 0);
-    ourShader.setInt("material.specular", 1);
-    blurShader.use();
-    blurShader.setInt("image", 0);
 
 
     // render loop
@@ -436,100 +704,291 @@ int main() {
         lastFrame = currentFrame;
 
         processInput(window);
+        profiler.BeginFrame();
+        ShaderVariants::NextFrame();
+
+        // the GPU time of a frame a few frames back, only a new sample moves the controller
+        bool freshFrameTime = profiler.Samples("Frejm") != frameSamples;
+        frameSamples = profiler.Samples("Frejm");
+        bool resolutionDynamic = resolutionStress.Running() ? resolutionStress.Current() == ResolutionBenchmark::DYNAMIC
+                                                            : programState->dynamicResolution;
+        resolution.targetMilliseconds = programState->targetFrameMilliseconds;
+        resolution.minScale = programState->minRenderScale;
+        resolution.maxScale = programState->maxRenderScale;
+        if (resolutionDynamic && !resolutionWasDynamic)
+            resolution.Reset(targets.Scale(), currentFrame);
+        else if (resolutionDynamic && freshFrameTime)
+            resolution.Update(profiler.LastMilliseconds("Frejm"), currentFrame);
+        resolutionWasDynamic = resolutionDynamic;
+        if (resolutionStress.Running())
+            resolutionStress.Record(freshFrameTime, profiler.LastMilliseconds("Frejm"), targets.Scale(),
+                                    programState->targetFrameMilliseconds);
+        float renderScale = resolutionDynamic ? resolution.Scale()
+                                              : (resolutionStress.Running() ? 1.0f : programState->renderScale);
+        targets.SetScale(renderScale, currentFrame);
+        for (int i = 0; i < RenderTargets::TARGET_COUNT; i++)
+            targets.SetFormat((RenderTargets::Target) i, programState->targetFormats[i]);
+        targets.Update(currentFrame);
+        profiler.Begin("Frejm");
+
+        if (loadedSkybox != programState->skybox) {
+            glDeleteTextures(1, &cubemapTexture);
+            loadedSkybox = programState->skybox;
+            cubemapTexture = loadCubemap(skyboxFaces(loadedSkybox));
+        }
+        ambient.Upload(projections[loadedSkybox], programState->shIntensity, programState->shAmbient ? 1.0f : 0.0f);
+
+        int lightCount = benchmark.Running() ? benchmark.LightCount()
+                         : (resolutionStress.Running() ? resolutionStress.LightCount() : programState->pointLightCount);
+        lights.Animate(currentFrame, lightCount);
 
         if(programState->wireframe)
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         else
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        // bind to framebuffer and draw scene as we normally would to color texture
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST);
-        // make sure we clear the framebuffer's content
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float )SCR_WIDTH/(float )SCR_HEIGHT, 0.1f, 100.0f);
-        // Skybox shader set
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        glm::mat4 view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // Draw skybox
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
         // view/projection transformations
-        projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        view = programState->camera.GetViewMatrix();
-
-        ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 30.0f);
-        setLights(ourShader, currentFrame);
+        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                targets.Aspect(), CAMERA_NEAR, CAMERA_FAR);
+        glm::mat4 view = programState->camera.GetViewMatrix();
+        bool taaOn = programState->taa;
+        if (taaOn) {
+            if (!taaWasOn)
+                taa.Invalidate();
+            projection = taa.Jitter(projection, view, targets.Width(), targets.Height());
+        }
+        taaWasOn = taaOn;
+        std::vector<StaticObject> staticObjects = StaticScene(programState->cityPosition, programState->cityScale,
+                                                              programState->bridgePossition, programState->bridgeScale);
+        std::vector<glm::vec3> objectMin(staticObjects.size()), objectMax(staticObjects.size());
+        for (size_t i = 0; i < staticObjects.size(); i++)
+            WorldBounds(staticObjects[i], staticBoundsMin[staticObjects[i].model], staticBoundsMax[staticObjects[i].model],
+                        objectMin[i], objectMax[i]);
+        lighting.SetObjects(objectMin, objectMax);
+        lighting.Update(lights.Points(lightCount), view, glm::radians(programState->camera.Zoom), targets.Aspect(),
+                        CAMERA_NEAR, CAMERA_FAR, targets.Width(), targets.Height());
+
+        ssao.sampleCount = programState->ssaoSamples;
+        ssao.radius = programState->ssaoRadius;
+        ssao.power = programState->ssaoPower;
+
+        bool shadowsOn = programState->shadowsEnabled && programState->dirLightEnabled;
+        if (shadowsOn) {
+            glm::vec3 boundsMin, boundsMax;
+            forestBounds(programState->treeAmount, boundsMin, boundsMax);
+            for (size_t i = 0; i < staticObjects.size(); i++) {
+                boundsMin = glm::min(boundsMin, objectMin[i]);
+                boundsMax = glm::max(boundsMax, objectMax[i]);
+            }
+            shadows.caching = programState->shadowCaching;
+            shadows.SetSceneBounds(boundsMin, boundsMax);
+            shadows.Update(programState->camera.Position, programState->camera.Front,
+                           glm::radians(programState->camera.Zoom), targets.Aspect(),
+                           CAMERA_NEAR, programState->dirLightDirection, staticObjects);
+            shadows.RenderStatic(profiler, [&](Shader &shader) { drawCity(shader, staticModels, true); });
+            // the trees past impostorDistance cast as impostors too
+            forest.UpdateShadowCasters(shadows.DynamicFrustum(), programState->camera.Position,
+                                       programState->impostorsEnabled ? programState->impostorDistance
+                                                                      : std::numeric_limits<float>::max(),
+                                       programState->gpuCulling);
+            shadows.RenderDynamic(profiler, [&](Shader &) { forest.DrawShadowCasters(); }, [&](Shader &shader) {
+                unsigned int farBuffer, farCount;
+                size_t farOffset;
+                if (forest.ShadowImpostors(farBuffer, farOffset, farCount))
+                    treeImpostor.Draw(shader, farBuffer, farOffset, farCount);
+            });
+        }
 
-        drawCity(ourShader, cityModel, stoneBridge, stonePlatformB);
+        profiler.Begin("Scena");
+        if (programState->deferredShading) {
+            // city into the G-buffer, then lit by fullscreen passes into the scene framebuffer
+            profiler.Begin("G-buffer");
+            deferred.BeginGeometryPass(projection, view);
+            drawCity(deferred.geometryShader, staticModels);
+            profiler.End();
+
+            if (programState->ssaoEnabled) {
+                profiler.Begin("SSAO normale");
+                ssao.DownsampleGBuffer(deferred, view, CAMERA_NEAR, CAMERA_FAR);
+                profiler.End();
+                ssao.Compute(profiler, projection, glm::radians(programState->camera.Zoom),
+                             targets.Aspect(), CAMERA_NEAR, CAMERA_FAR);
+            }
+
+            profiler.Begin("Deferred svetla");
+            targets.Bind();
+            glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            deferred.CopyDepth(targets.framebuffer);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            Shader &directionalShader = deferred.directionalShaders.Get(lightDefines(lightCount));
+            directionalShader.use();
+            setLights(directionalShader, currentFrame);
+            if (programState->ssaoEnabled)
+                ssao.Bind(directionalShader);
+            if (shadowsOn)
+                shadows.Bind(directionalShader, programState->camera.Front);
+            deferred.DrawDirectional(directionalShader, projection, view, programState->camera.Position);
+            // the point ambient is occluded like the other ambient terms
+            std::vector<std::string> pointDefines;
+            if (programState->ssaoEnabled)
+                pointDefines.push_back("SSAO");
+            Shader &pointShader = deferred.pointShaders.Get(pointDefines);
+            pointShader.use();
+            if (programState->ssaoEnabled)
+                ssao.Bind(pointShader);
+            deferred.DrawPointLights(pointShader, lighting, projection, view, programState->camera.Position);
+            if (programState->wireframe)
+                glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            profiler.End();
+
+            // the sky only shows where the G-buffer depth stayed cleared
+            drawSkybox(skyboxShader, skyboxVAO, cubemapTexture, projection, view);
+        } else {
+            if (programState->ssaoEnabled) {
+                // the occlusion has to be ready before the color pass reads it
+                profiler.Begin("SSAO normale");
+                ssao.BeginGeometryPass(projection, view);
+                drawCity(ssao.geometryShader, staticModels);
+                ssao.EndGeometryPass();
+                profiler.End();
+                ssao.Compute(profiler, projection, glm::radians(programState->camera.Zoom),
+                             targets.Aspect(), CAMERA_NEAR, CAMERA_FAR);
+            }
+
+            // bind to framebuffer and draw scene as we normally would to color texture
+            targets.Bind();
+            glEnable(GL_DEPTH_TEST);
+            // make sure we clear the framebuffer's content
+            glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            if (programState->depthPrepass) {
+                profiler.Begin("Depth pre-pass");
+                prepass.BeginDepthPass(projection, view);
+                drawCity(prepass.shader, staticModels, true);
+                prepass.EndDepthPass();
+                profiler.End();
+            }
+
+            drawSkybox(skyboxShader, skyboxVAO, cubemapTexture, projection, view);
+
+            bool lightmapped = programState->lightmapEnabled && lightmapMatches(lightmap);
+            Shader &ourShader = cityShaders.Get(lightDefines(lightCount, lightmapped));
+            ourShader.use();
+            ourShader.setMat4("projection", projection);
+            ourShader.setMat4("view", view);
+            ourShader.setVec3("viewPosition", programState->camera.Position);
+            ourShader.setFloat("material.shininess", 30.0f);
+            setLights(ourShader, currentFrame);
+            lighting.Bind(ourShader);
+            if (programState->ssaoEnabled)
+                ssao.Bind(ourShader);
+            if (shadowsOn && !lightmapped)
+                shadows.Bind(ourShader, programState->camera.Front);
+
+            prepass.BeginColorPass(programState->depthPrepass);
+            if (lightmapped)
+                lightmap.BindTextures();
+            drawCity(ourShader, staticModels, false, lightmapped ? &lightmap : nullptr, &lighting);
+            prepass.EndColorPass();
+        }
 
-        instanceShader.use();
-        instanceShader.setMat4("projection", projection);
-        instanceShader.setMat4("view", view);
-        drawTrees(instanceShader, treeModel, amount);
+        resizeForest(forest, forestHandles, programState->treeAmount);
+        drawTrees(instanceShader, impostorShader, forest, treeImpostor, projection, view);
 
         // Reset wireframe drawing so that it doesn't try to draw quads
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        profiler.End();
+
+        graph.Reset();
+        RenderGraph::Resource sceneColor = graph.Import("Scena", targets.colorBuffer, targets.Width(),
+                                                        targets.Height(), targets.framebuffer);
+        RenderGraph::Resource sceneDepth = graph.Import("Dubina", targets.depthStencil, targets.Width(),
+                                                        targets.Height());
+        RenderGraph::Resource backbuffer = graph.Backbuffer(targets.OutputWidth(), targets.OutputHeight());
+
+        // anti-aliased (and upsampled) scene in the TAA history, the post chain reads it instead of the scene color
+        RenderGraph::Resource postInput = sceneColor;
+        if (taaOn) {
+            taa.blend = programState->taaBlend;
+            taa.upsample = programState->taaUpsample;
+            postInput = taa.AddPasses(graph, sceneColor, sceneDepth, targets.OutputWidth(), targets.OutputHeight(),
+                                      [&](Shader &shader) {
+                for (size_t i = 0; i < staticObjects.size() && i < previousTransforms.size(); i++) {
+                    if (staticObjects[i].transform == previousTransforms[i])
+                        continue;
+                    shader.setMat4("model", staticObjects[i].transform);
+                    shader.setMat4("previousModel", previousTransforms[i]);
+                    staticModels[staticObjects[i].model]->DrawDepth();
+                }
+            });
+        }
 
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++) {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        // always declared, the graph culls it when the post chain has no BloomComposite stage to read it
+        bloom.levels = programState->bloomLevels;
+        bloom.threshold = programState->bloomThreshold;
+        bloom.knee = programState->bloomKnee;
+        RenderGraph::Resource bloomResult = bloom.AddPasses(graph, sceneColor);
+        bool bloomOn = programState->hdr && programState->bloom;
+
+        bool autoExposureOn = programState->hdr && programState->autoExposure;
+        if (autoExposureOn) {
+            exposure.key = programState->exposureKey;
+            exposure.speed = programState->exposureSpeed;
+            exposure.AddPass(graph, sceneColor, deltaTime);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // Bind back to default framebuffer and draw a quad plane with the attached framebuffer color texture
-        // glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST); // disable depth test so screen-space quad isn't discarded due to depth test.
-        // Clear all relevant buffers
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear color to white (not really necessary actually, since we won't be able to see behind the quad anyways)
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // Render the quad plane on default framebuffer
-        screenShader.use();
-        screenShader.setInt("bloom", programState->bloom);
-        screenShader.setInt("hdr", programState->hdr);
-        screenShader.setFloat("exposure", programState->hdrExposure);
-        screenShader.setFloat("gamma", programState->hdrGamma);
-        screenShader.setInt("option", programState->effectSelected);
-        // Bind bloom and non bloom
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-
-        renderQuad();
-        //glBindVertexArray(quadVAO);
-        //glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
-        //glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        // the enabled effects fused into as few fullscreen passes as possible, the last one to the screen
+        setPostStages(post);
+        grading.Bake(programState->colorLook, programState->lutSize, programState->colorGrade,
+                     programState->gradeContrast, programState->gradeSaturation);
+        grading.Bind(PostChain::LUT_UNIT);
+        post.bicubicUpscale = programState->bicubicUpscale;
+        post.AddPasses(graph, postInput, bloomResult, backbuffer, [&](Shader &shader) {
+            shader.setFloat("exposure", autoExposureOn ? exposure.Exposure() : programState->hdrExposure);
+            shader.setFloat("gamma", programState->hdrGamma);
+            shader.setFloat("bloomStrength", bloom.Strength());
+            shader.setFloat("sharpenAmount", programState->sharpenAmount);
+            shader.setFloat("lutSize", (float) grading.Size());
+            shader.setFloat("vignetteStrength", programState->vignetteStrength);
+            shader.setFloat("fxaaEdgeThreshold", 0.125f);
+        });
+        graph.Execute(profiler);
+        glViewport(0, 0, targets.OutputWidth(), targets.OutputHeight());
+        profiler.End();
+
+        if (taaOn)
+            taa.EndFrame();
+        previousTransforms.clear();
+        for (const StaticObject &object : staticObjects)
+            previousTransforms.push_back(object.transform);
+        int sceneWidth = graph.Width(postInput), sceneHeight = graph.Height(postInput);
+
+        // the color is written once and the depth tested and written, overdraw isn't counted
+        size_t scenePixels = (size_t) targets.Width() * targets.Height();
+        size_t sceneBytes = scenePixels * targets.Format(RenderTargets::SCENE).bytesPerPixel;
+        frameTraffic.clear();
+        frameTraffic.push_back({ "Scena", sceneBytes + scenePixels * 4 * 2
+                                          + (programState->deferredShading
+                                             ? 2 * scenePixels * DeferredRenderer::BYTES_PER_PIXEL : 0) });
+        if (bloomOn)
+            frameTraffic.push_back({ "Bloom", bloom.Traffic(sceneBytes) });
+        if (autoExposureOn)
+            frameTraffic.push_back({ "Ekspozicija", sceneBytes });
+        if (taaOn)
+            frameTraffic.push_back({ "TAA", taa.Traffic(sceneBytes) });
+        frameTraffic.push_back({ "Post", post.Traffic(taaOn ? (size_t) sceneWidth * sceneHeight
+                                                              * targets.Format(RenderTargets::TAA_HISTORY).bytesPerPixel
+                                                            : sceneBytes) });
+
+        if (!programState->deferredShading)
+            prepass.EndFrame(deltaTime * 1000.0f, profiler.LastMilliseconds("Scena"));
+        bool freshSceneTime = profiler.Samples("Scena") != sceneSamples;
+        sceneSamples = profiler.Samples("Scena");
+        if (benchmark.Running())
+            benchmark.Record(lighting.assignMilliseconds, freshSceneTime, profiler.LastMilliseconds("Scena"),
+                             lighting.indexCount / (float) ClusteredLighting::CLUSTER_COUNT);
 
 
         if (programState->ImGuiEnabled)
@@ -551,72 +1010,174 @@ int main() {
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteBuffers(1, &quadVBO);
-    glDeleteBuffers(1, &framebuffer);
     glfwTerminate();
     return 0;
 }
-void drawCity(Shader modelShader, Model cityModel, Model stoneBridge, Model stonePlatformB){
-
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, programState->cityPosition); // translate it down so it's at the center of the scene
-    model = glm::scale(model, glm::vec3(programState->cityScale));    // it's a bit too big for our scene, so scale it down
-    modelShader.setMat4("model", model);
-    cityModel.Draw(modelShader);
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(programState->bridgePossition)); // translate it down so it's at the center of the scene
-    model = glm::scale(model, glm::vec3(1.0f));    // it's a bit too big for our scene, so scale it down
-    modelShader.setMat4("model", model);
-    stonePlatformB.Draw(modelShader);
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(programState->bridgePossition + glm::vec3(-30.f, -5.0f, 0.0f))); // translate it down so it's at the center of the scene
-    model = glm::scale(model, glm::vec3(programState->bridgeScale));    // it's a bit too big for our scene, so scale it down
-    modelShader.setMat4("model", model);
-    stoneBridge.Draw(modelShader);
-
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(programState->bridgePossition + glm::vec3(30.f, -2.0f, 0.0f))); // translate it down so it's at the center of the scene
-    model = glm::scale(model, glm::vec3(programState->bridgeScale));    // it's a bit too big for our scene, so scale it down
-    modelShader.setMat4("model", model);
-    stoneBridge.Draw(modelShader);
+// the bake only holds while the static objects stay where they were baked and the sun and skybox are the baked ones
+bool lightmapMatches(const Lightmap &lightmap){
+    BakedLighting lighting;
+    lighting.sunDirection = programState->dirLightDirection;
+    lighting.sunColor = programState->dirLightEnabled ? programState->dirLightDiffuse : glm::vec3(0.0f);
+    lighting.flatAmbient = programState->dirLightAmbient;
+    lighting.skybox = SKYBOXES[programState->skybox];
+    return lightmap.Matches(StaticScene(programState->cityPosition, programState->cityScale,
+                                        programState->bridgePossition, programState->bridgeScale), lighting);
+}
+// defines of the lighting shaders (cityShader.fs, deferredDirectional.fs), disabled lights are compiled out.
+// A lightmapped city has the directional light and the ambient baked in, only the point and spot lights stay.
+// pointLightCount is the count shaded this frame, the benchmarks override ProgramState::pointLightCount.
+std::vector<std::string> lightDefines(int pointLightCount, bool lightmapped){
+    std::vector<std::string> defines;
+    if (lightmapped)
+        defines.push_back("LIGHTMAP");
+    if (programState->dirLightEnabled && !lightmapped)
+        defines.push_back("DIR_LIGHT");
+    if (pointLightCount > 0)
+        defines.push_back("POINT_LIGHTS");
+    if (programState->spotlightEnabled)
+        defines.push_back("SPOT_LIGHT");
+    if (programState->shAmbient && !lightmapped)
+        defines.push_back("SH_AMBIENT");
+    if (programState->ssaoEnabled)
+        defines.push_back("SSAO");
+    if (programState->shadowsEnabled && programState->dirLightEnabled && !lightmapped)
+        defines.push_back("SHADOWS");
+    return defines;
+}
 
+// post processing stages from ProgramState
+void setPostStages(PostChain &post){
+    post.Enable("Blur", programState->effectSelected == 1);
+    post.Enable("Sharpen", programState->sharpen);
+    post.Enable("BloomComposite", programState->hdr && programState->bloom);
+    post.Enable("ToneMap", programState->hdr);
+    // the look and the grade share one LUT fetch, the neutral look without a grade needs none
+    post.Enable("ColorLut", programState->colorLook != 0 || programState->colorGrade);
+    post.Enable("Vignette", programState->vignette);
+    post.Enable("Fxaa", programState->fxaa);
 }
 
-void drawTrees(Shader modelShader, Model treeModel, int amount){
+// the bloom and post passes with every stage on have to sort without a dependency cycle; only declares and
+// schedules them, nothing is drawn
+void checkRenderGraph(Bloom &bloom, PostChain &post, int width, int height){
+    RenderGraph graph;
+    RenderGraph::Resource scene = graph.Import("Scena", 0, width, height);
+    RenderGraph::Resource backbuffer = graph.Backbuffer(width, height);
+    bloom.levels = Bloom::MAX_LEVELS;
+    RenderGraph::Resource bloomResult = bloom.AddPasses(graph, scene);
+    for (const char *stage : { "Blur", "Sharpen", "BloomComposite", "ToneMap", "ColorLut", "Vignette", "Fxaa" })
+        post.Enable(stage, true);
+    post.AddPasses(graph, scene, bloomResult, backbuffer, [](Shader &) {});
+    if (graph.Schedule() != 0)
+        std::cout << "ERROR::RENDER_GRAPH:: the bloom and post passes don't sort\n" << graph.Dump() << std::flush;
+    setPostStages(post);
+}
 
-    treeModel.DrawInstanced(modelShader, amount);
+void drawSkybox(Shader &skyboxShader, unsigned int skyboxVAO, unsigned int cubemapTexture,
+                const glm::mat4 &projection, const glm::mat4 &view){
+    glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+    skyboxShader.use();
+    skyboxShader.setMat4("view", glm::mat4(glm::mat3(view))); // remove translation from the view matrix
+    skyboxShader.setMat4("projection", projection);
+    glBindVertexArray(skyboxVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS); // set depth function back to default
 }
 
-// renderQuad() renders a 1x1 XY quad in NDC
-// -----------------------------------------
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad()
-{
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-                // positions        // texture Coords
-                -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-                -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-                1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-                1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+void drawCity(Shader &modelShader, Model *models[STATIC_MODEL_COUNT], bool depthOnly, const Lightmap *lightmap,
+              const ClusteredLighting *lighting){
+    std::vector<StaticObject> objects = StaticScene(programState->cityPosition, programState->cityScale,
+                                                    programState->bridgePossition, programState->bridgeScale);
+    for (size_t i = 0; i < objects.size(); i++) {
+        Model &model = *models[objects[i].model];
+        modelShader.setMat4("model", objects[i].transform);
+        if (lighting)
+            lighting->BindObject(modelShader, i);
+        if (depthOnly)
+            model.DrawDepth();
+        else if (lightmap)
+            lightmap->Draw(modelShader, i, model);
+        else
+            model.Draw(modelShader);
     }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+}
+
+void drawTrees(Shader &modelShader, Shader &impostorShader, InstanceSet &forest, Impostor &treeImpostor,
+               const glm::mat4 &projection, const glm::mat4 &view){
+    // only the visible trees are drawn, the ones further than impostorDistance go to the impostors
+    Frustum frustum(projection * view);
+    static vector<InstanceData> farTrees;
+    farTrees.clear();
+    float lodDistance = programState->impostorsEnabled ? programState->impostorDistance : std::numeric_limits<float>::max();
+    if (programState->gpuCulling)
+        forest.UpdateGpu(frustum, programState->camera.Position, lodDistance, programState->impostorsEnabled);
+    else
+        forest.Update(frustum, programState->camera.Position, lodDistance, &farTrees);
+
+    modelShader.use();
+    modelShader.setMat4("projection", projection);
+    modelShader.setMat4("view", view);
+    forest.Draw(modelShader);
+
+    impostorShader.use();
+    impostorShader.setMat4("projection", projection);
+    impostorShader.setMat4("view", view);
+    impostorShader.setVec3("viewPosition", programState->camera.Position);
+    unsigned int farBuffer, farCount;
+    if (!programState->gpuCulling) {
+        treeImpostor.UpdateInstances(farTrees);
+        treeImpostor.Draw(impostorShader);
+    } else if (programState->impostorsEnabled && forest.GpuFarInstances(farBuffer, farCount)) {
+        treeImpostor.Draw(impostorShader, farBuffer, 0, farCount);
+    }
+}
+
+// keep the original density of 50 trees per forest when more trees are requested
+void forestArea(int amount, int &spread, int &depth){
+    float density = std::sqrt(std::max(amount, 50) / 50.0f);
+    spread = (int)(80 * density);
+    depth = (int)(51 * density);
+}
+
+// where resizeForest() may place trees, with room for the crowns
+void forestBounds(int amount, glm::vec3 &boundsMin, glm::vec3 &boundsMax){
+    int spread, depth;
+    forestArea(amount, spread, depth);
+    boundsMin = glm::vec3(-15 - spread, -10.0f, -depth / 2 - 5);
+    boundsMax = glm::vec3(15 + spread, 25.0f, depth / 2 + 5);
+}
+
+// adds or removes random trees until the forest has `amount` of them
+void resizeForest(InstanceSet &forest, vector<InstanceHandle> &handles, int amount){
+    int spread, depth;
+    forestArea(amount, spread, depth);
+
+    while (handles.size() < (size_t)amount) {
+        glm::vec3 position;
+        if (handles.size() % 2 == 0)
+            position = glm::vec3(15 + rand() % spread, rand() % 8 - 10, rand() % depth - depth / 2);
+        else
+            position = glm::vec3(-15 - rand() % spread, rand() % 16 - 5, rand() % depth - depth / 2);
+
+        float scale = 0.7f;    // it's a bit too big for our scene, so scale it down
+        float yaw = glm::radians((float)(rand() % 360));
+        handles.push_back(forest.Add(position, scale, yaw));
+    }
+    while (handles.size() > (size_t)amount) {
+        forest.Remove(handles.back());
+        handles.pop_back();
+    }
+}
+
+const VertexFormat &skyboxFormat()
+{
+    static const VertexFormat format = VertexFormat("skybox")
+            .Stream(3 * sizeof(float))
+            .Attribute("aPos", 0, 3, GL_FLOAT, 0);
+    return format;
 }
 
 
@@ -639,9 +1200,10 @@ void processInput(GLFWwindow *window) {
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-    // make sure the viewport matches the new window dimensions; note that width and
-    // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // the targets follow once the size settles; note that width and height will be significantly larger
+    // than specified on retina displays.
+    if (renderTargets)
+        renderTargets->SetWindowSize(width, height, glfwGetTime());
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -687,19 +1249,173 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat3("Pozicija mosta", (float*)&programState->bridgePossition);
         ImGui::DragFloat("Velicina mosta", &programState->bridgeScale, 0.05, 0.1, 20.0);
 
+        ImGui::Text("Drvece");
+        ImGui::InputInt("Broj drveca", &programState->treeAmount, 50, 1000);
+        programState->treeAmount = std::max(1, std::min(programState->treeAmount, 100000));
+        ImGui::Checkbox("Impostori", &programState->impostorsEnabled);
+        ImGui::Checkbox("GPU culling", &programState->gpuCulling);
+        ImGui::DragFloat("Impostor udaljenost", &programState->impostorDistance, 1.0f, 5.0f, 500.0f);
+
+        ImGui::Text("Svetla");
+        ImGui::InputInt("Broj svetala", &programState->pointLightCount, 1, 64);
+        programState->pointLightCount = std::max(0, std::min(programState->pointLightCount, (int) lightStore->PointCount()));
+        ImGui::Checkbox("Directional", &programState->dirLightEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Spotlight", &programState->spotlightEnabled);
+        ImGui::Combo("Skybox", &programState->skybox, SKYBOXES, SKYBOX_COUNT);
+        ImGui::Checkbox("SH ambijent", &programState->shAmbient);
+        ImGui::Checkbox("SSAO", &programState->ssaoEnabled);
+        if (programState->ssaoEnabled) {
+            ImGui::SliderFloat("SSAO radijus", &programState->ssaoRadius, 0.05f, 3.0f);
+            ImGui::SliderInt("SSAO uzorci", &programState->ssaoSamples, 4, Ssao::MAX_SAMPLES);
+            ImGui::SliderFloat("SSAO jacina", &programState->ssaoPower, 0.5f, 4.0f);
+        }
+        ImGui::Checkbox("Senke", &programState->shadowsEnabled);
+        if (programState->shadowsEnabled) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Kesiranje senki", &programState->shadowCaching);
+            cascadedShadows->DrawImGui(*gpuProfiler);
+        }
+        ImGui::Checkbox("Lightmap", &programState->lightmapEnabled);
+        if (!staticLightmap->Loaded())
+            ImGui::Text("Lightmap nije ucitana, pokreni lightmap_baker");
+        else
+            ImGui::Text("Lightmap %ux%u, %.1f MB%s", staticLightmap->Width(), staticLightmap->Height(),
+                        staticLightmap->TextureBytes() / (1024.0f * 1024.0f),
+                        lightmapMatches(*staticLightmap) ? "" : " (grad/most pomereni ili drugo svetlo, ne vazi)");
+        if (programState->shAmbient) {
+            ImGui::SliderFloat("SH intenzitet", &programState->shIntensity, 0.0f, 4.0f);
+            ImGui::Text("%-8s %10s %10s %10s", "skybox", "texela", "dekod.", "projekcija");
+            for (int i = 0; i < SKYBOX_COUNT; i++) {
+                const SkyboxAmbient::Projection &projection = (*skyboxProjections)[i];
+                ImGui::Text("%-8s %10d %7.1f ms %7.1f ms%s", SKYBOXES[i], projection.texels,
+                            projection.decodeMilliseconds, projection.projectMilliseconds,
+                            projection.fromCache ? " (kes)" : "");
+            }
+            if (ImGui::Button("Ponovo projektuj"))
+                for (int i = 0; i < SKYBOX_COUNT; i++)
+                    (*skyboxProjections)[i] = skyboxAmbient->Load((*skyboxProjections)[i].directory, true);
+        }
+        ImGui::Text("Animirana: %u, %.1f us", lightStore->animatedLights, lightStore->animateMicroseconds);
+        ImGui::Text("Vidljiva: %u, dodela: %.3f ms, max po klasteru: %u", clusteredLighting->visibleLights,
+                    clusteredLighting->assignMilliseconds, clusteredLighting->maxLightsPerCluster);
+        ImGui::Text("Po objektu: grad %u, platforma %u, mostovi %u/%u", clusteredLighting->ObjectLightCount(0),
+                    clusteredLighting->ObjectLightCount(1), clusteredLighting->ObjectLightCount(2),
+                    clusteredLighting->ObjectLightCount(3));
+        if (!lightBenchmark->Running() && ImGui::Button("Benchmark svetala"))
+            lightBenchmark->Start();
+        lightBenchmark->DrawImGui();
+        ImGui::Checkbox("GPU vreme", &programState->gpuTimings);
+        ImGui::Checkbox("Dinamicka rezolucija", &programState->dynamicResolution);
+        if (programState->dynamicResolution) {
+            ImGui::SliderFloat("Ciljni frejm (ms)", &programState->targetFrameMilliseconds, 4.0f, 50.0f);
+            ImGui::SliderFloat("Min skala", &programState->minRenderScale, RenderTargets::MIN_SCALE, 1.0f);
+            ImGui::SliderFloat("Max skala", &programState->maxRenderScale, RenderTargets::MIN_SCALE, 1.0f);
+            programState->minRenderScale = std::min(programState->minRenderScale, programState->maxRenderScale);
+            dynamicResolution->DrawImGui();
+        } else
+            ImGui::SliderFloat("Skala renderovanja", &programState->renderScale, RenderTargets::MIN_SCALE, 1.0f);
+        ImGui::Checkbox("Bikubno skaliranje", &programState->bicubicUpscale);
+        if (ImGui::TreeNode("Formati i propusni opseg")) {
+            for (int i = 0; i < RenderTargets::TARGET_COUNT; i++) {
+                const char *name = RenderTargets::Name((RenderTargets::Target) i);
+                if (ImGui::BeginCombo(name, TargetFormat::Get(programState->targetFormats[i]).name)) {
+                    for (int format = 0; format < TargetFormat::COUNT; format++)
+                        if (RenderTargets::Allows((RenderTargets::Target) i, format)
+                            && ImGui::Selectable(TargetFormat::Get(format).name, programState->targetFormats[i] == format))
+                            programState->targetFormats[i] = format;
+                    ImGui::EndCombo();
+                }
+            }
+            size_t total = 0;
+            for (const auto &traffic : frameTraffic) {
+                ImGui::Text("%-12s %7.1f MB", traffic.first, traffic.second / (1024.0f * 1024.0f));
+                total += traffic.second;
+            }
+            ImGui::Text("Ukupno %.1f MB po frejmu, %.2f GB/s pri %.0f FPS", total / (1024.0f * 1024.0f),
+                        total * ImGui::GetIO().Framerate / (1024.0f * 1024.0f * 1024.0f), ImGui::GetIO().Framerate);
+            ImGui::TreePop();
+        }
+        if (ImGui::TreeNode("Render graf")) {
+            renderGraph->DrawImGui();
+            ImGui::TextUnformatted(renderGraph->Dump().c_str());
+            ImGui::TreePop();
+        }
+        ImGui::Checkbox("TAA", &programState->taa);
+        if (programState->taa) {
+            ImGui::Checkbox("TAA do rezolucije prozora", &programState->taaUpsample);
+            ImGui::SliderFloat("TAA udeo novog frejma", &programState->taaBlend, 0.02f, 0.5f);
+            ImGui::Text("TAA: brzine %.3f ms, razresavanje %.3f ms, %.1f MB", gpuProfiler->Milliseconds("TAA brzine"),
+                        gpuProfiler->Milliseconds("TAA"), temporalAA->Bytes() / (1024.0f * 1024.0f));
+        }
+        if (!resolutionBenchmark->Running() && !lightBenchmark->Running() && ImGui::Button("Stres test rezolucije"))
+            resolutionBenchmark->Start((int) lightStore->PointCount());
+        resolutionBenchmark->DrawImGui();
+        ImGui::Text("Render %dx%d -> prozor %dx%d, scena %.1f MB, alokacija %d", renderTargets->Width(),
+                    renderTargets->Height(), renderTargets->OutputWidth(), renderTargets->OutputHeight(),
+                    renderTargets->Bytes() / (1024.0f * 1024.0f), renderTargets->Allocations());
+        ImGui::Checkbox("Deferred shading", &programState->deferredShading);
+        if (programState->deferredShading)
+            ImGui::Text("G-buffer: %d B/px, %.1f MB upis + citanje po frejmu", DeferredRenderer::BYTES_PER_PIXEL,
+                        2.0f * renderTargets->Width() * renderTargets->Height() * DeferredRenderer::BYTES_PER_PIXEL
+                        / (1024.0f * 1024.0f));
+        else {
+            ImGui::Checkbox("Depth pre-pass", &programState->depthPrepass);
+            depthPrepass->DrawImGui();
+        }
 
         ImGui::Text("HDR");
         ImGui::Checkbox("HDR", &programState->hdr);
         if(programState->hdr){
-            ImGui::SliderFloat("HDR Exposure", &programState->hdrExposure, 0.0f, 5.0f);
+            ImGui::Checkbox("Automatska ekspozicija", &programState->autoExposure);
+            if (programState->autoExposure) {
+                ImGui::SliderFloat("Kljuc", &programState->exposureKey, 0.05f, 2.0f);
+                ImGui::SliderFloat("Brzina adaptacije", &programState->exposureSpeed, 0.1f, 10.0f);
+                ImGui::Text("Ekspozicija %.2f, luminansa %.3f (kasni %d fr., preskoceno %d), %.3f ms",
+                            autoExposure->Exposure(), autoExposure->AverageLuminance(), autoExposure->Latency(),
+                            autoExposure->Skipped(), gpuProfiler->Milliseconds("Ekspozicija"));
+            } else
+                ImGui::SliderFloat("HDR Exposure", &programState->hdrExposure, 0.0f, 5.0f);
             ImGui::SliderFloat("HDR Gamma", &programState->hdrGamma, 0.0f, 5.0f);
             ImGui::Checkbox("Bloom", &programState->bloom);
+            if (programState->bloom) {
+                ImGui::SliderFloat("Bloom prag", &programState->bloomThreshold, 0.0f, 5.0f);
+                ImGui::SliderFloat("Bloom koleno", &programState->bloomKnee, 0.0f, 2.0f);
+                ImGui::SliderInt("Bloom nivoi", &programState->bloomLevels, 1, Bloom::MAX_LEVELS);
+                ImGui::Text("Bloom: prag %.3f ms, dole %.3f ms, gore %.3f ms, %.1f MB",
+                            gpuProfiler->Milliseconds("Bloom prag"), gpuProfiler->Milliseconds("Bloom dole"),
+                            gpuProfiler->Milliseconds("Bloom gore"), bloomChain->Bytes() / (1024.0f * 1024.0f));
+            }
         }
         ImGui::Text("Efekti");
         ImGui::Checkbox("Draw Wireframe", &programState->wireframe);
         ImGui::RadioButton("No Effect", &programState->effectSelected, 0);
         ImGui::RadioButton("Blur", &programState->effectSelected, 1);
-        ImGui::RadioButton("Ruzicasti", &programState->effectSelected, 2);
+        ImGui::Checkbox("Sharpen", &programState->sharpen);
+        if (programState->sharpen)
+            ImGui::SliderFloat("Sharpen jacina", &programState->sharpenAmount, 0.0f, 1.0f);
+        ImGui::Checkbox("Color grade", &programState->colorGrade);
+        if (programState->colorGrade) {
+            ImGui::SliderFloat("Kontrast", &programState->gradeContrast, 0.5f, 2.0f);
+            ImGui::SliderFloat("Saturacija", &programState->gradeSaturation, 0.0f, 2.0f);
+        }
+        const std::vector<ColorGrading::Look> &looks = colorGrading->Looks();
+        int look = std::min(programState->colorLook, (int) looks.size() - 1);
+        if (ImGui::BeginCombo("Izgled", looks[look].name.c_str())) {
+            for (int i = 0; i < (int) looks.size(); i++)
+                if (ImGui::Selectable(looks[i].name.c_str(), programState->colorLook == i))
+                    programState->colorLook = i;
+            ImGui::EndCombo();
+        }
+        ImGui::RadioButton("LUT 32", &programState->lutSize, 32);
+        ImGui::SameLine();
+        ImGui::RadioButton("LUT 64", &programState->lutSize, 64);
+        ImGui::Text("LUT %d^3, %d pecenja", colorGrading->Size(), colorGrading->Bakes());
+        ImGui::Checkbox("Vinjeta", &programState->vignette);
+        if (programState->vignette)
+            ImGui::SliderFloat("Vinjeta jacina", &programState->vignetteStrength, 0.0f, 2.0f);
+        ImGui::Checkbox("FXAA", &programState->fxaa);
+        postChain->DrawImGui();
 
         ImGui::End();
     }
@@ -711,6 +1427,15 @@ void DrawImGui(ProgramState *programState) {
         ImGui::DragFloat3("Dir Specular", (float*)&programState->dirLightSpecular, 0.05f, -1.0f, 1.0f);
     }
 
+    if(programState->gpuTimings)
+        gpuProfiler->DrawImGui();
+
+    {
+        ImGui::Begin("Shader permutacije");
+        ShaderVariants::DrawImGui();
+        ImGui::End();
+    }
+
     if(programState->cameraDebug){
         ImGui::Begin("Camera info");
         const Camera& c = programState->camera;
@@ -745,6 +1470,15 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
+// faces of a bundled skybox in the order loadCubemap() expects them
+vector<std::string> skyboxFaces(int skybox) {
+    std::string directory = std::string("resources/textures/skybox/") + SKYBOXES[skybox] + "/";
+    vector<std::string> faces;
+    for (const char *face : { "px", "nx", "py", "ny", "pz", "nz" })
+        faces.push_back(FileSystem::getPath(directory + face + ".png"));
+    return faces;
+}
+
 unsigned int loadCubemap(vector<std::string> faces) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -784,36 +1518,21 @@ void setLights(Shader lightingShader, float currentFrame){
     lightingShader.setVec3("dirLight.diffuse", programState->dirLightDiffuse);
     lightingShader.setVec3("dirLight.specular", programState->dirLightSpecular);
 
-    // point light blue
-    lightingShader.setVec3("pointLights[0].position",  glm::vec3(5.0 * cos(currentFrame), 5.0f * sin(currentFrame), 2.0 * cos(currentFrame)));
-    lightingShader.setVec3("pointLights[0].ambient", glm::vec3(0.5f, 0.5f, 0.5f));
-    lightingShader.setVec3("pointLights[0].diffuse", glm::vec3(0.8f, 0.8f, 0.8f));
-    lightingShader.setVec3("pointLights[0].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-    lightingShader.setFloat("pointLights[0].constant", 0.05f);
-    lightingShader.setFloat("pointLights[0].linear", 0.02f);
-    lightingShader.setFloat("pointLights[0].quadratic", 0.001f);
-    lightingShader.setVec3("pointLights[0].lightColor", glm::vec3(0.0, 0.0, 1.0f));
-
-    // point light red
-    lightingShader.setVec3("pointLights[1].position", glm::vec3 (-5.0 * sin(currentFrame), 3.0f * cos(currentFrame), 4.0 * sin(currentFrame)));
-    lightingShader.setVec3("pointLights[1].ambient", glm::vec3(0.5f, 0.5f, 0.5f));
-    lightingShader.setVec3("pointLights[1].diffuse", glm::vec3(0.8f, 0.8f, 0.8f));
-    lightingShader.setVec3("pointLights[1].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-    lightingShader.setFloat("pointLights[1].constant", 0.05f);
-    lightingShader.setFloat("pointLights[1].linear", 0.02f);
-    lightingShader.setFloat("pointLights[1].quadratic", 0.001f);
-    lightingShader.setVec3("pointLights[1].lightColor", glm::vec3(1.0, 0.0, 0.0f));
-
-    //spotlight
-    lightingShader.setVec3("spotlight.position", glm::vec3 (50.0f, 2.0f, 0.0f));
-    lightingShader.setVec3("spotlight.direction", glm::vec3(0.0f, 0.0f, 0.0f));
-    lightingShader.setFloat("spotlight.cutOff", glm::cos(glm::radians(2.5f)));
-    lightingShader.setFloat("spotlight.outerCutOff", glm::cos(glm::radians(6.5f)));
-    lightingShader.setFloat("spotlight.constant", 0.05f);
-    lightingShader.setFloat("spotlight.linear", 0.01f);
-    lightingShader.setFloat("spotlight.quadratic", 0.09f);
-    lightingShader.setVec3("spotlight.ambient", glm::vec3(0.2f, 0.2f, 0.2f));
-    lightingShader.setVec3("spotlight.diffuse", glm::vec3(0.9f, 0.9f, 0.9f));
-    lightingShader.setVec3("spotlight.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-    lightingShader.setVec3("spotlight.color", glm::vec3(1.0f, 1.0f, 1.0f));
+    //spotlight, the first one of the scene file
+    const LightStore::SpotLight *spot = lightStore->Spot();
+    if (!spot)
+        return;
+    lightingShader.setVec3("spotlight.position", spot->position);
+    lightingShader.setVec3("spotlight.direction", spot->direction);
+    lightingShader.setFloat("spotlight.cutOff", spot->cutOff);
+    lightingShader.setFloat("spotlight.outerCutOff", spot->outerCutOff);
+    lightingShader.setFloat("spotlight.constant", spot->constant);
+    lightingShader.setFloat("spotlight.linear", spot->linear);
+    lightingShader.setFloat("spotlight.quadratic", spot->quadratic);
+    lightingShader.setVec3("spotlight.ambient", spot->ambient);
+    lightingShader.setVec3("spotlight.diffuse", spot->diffuse);
+    lightingShader.setVec3("spotlight.specular", spot->specular);
+    // the color is already part of the terms
+    lightingShader.setVec3("spotlight.color", glm::vec3(1.0f));
 }
+
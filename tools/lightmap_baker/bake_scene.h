@@ -0,0 +1,274 @@
+#ifndef LIGHTMAP_BAKER_BAKE_SCENE_H
+#define LIGHTMAP_BAKER_BAKE_SCENE_H
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// One mesh of a model as the baker sees it: the same vertices and triangles Model loads (same import flags and
+// node order, so the indices line up at runtime) plus the average albedo of its diffuse texture for the bounces.
+// BuildCharts() adds the lightmap vertices: remap into the original vertices, second UV set and triangles.
+struct BakeMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t> indices;
+    glm::vec3 albedo = glm::vec3(0.7f);
+
+    std::vector<uint32_t> remap;
+    std::vector<glm::vec2> uv;
+    std::vector<uint32_t> chartIndices;
+};
+
+struct BakeModel {
+    std::string path;
+    std::vector<BakeMesh> meshes;
+    // texels along a side of the model's UV square, at the density it was charted with
+    int resolution = 0;
+    // surface area in model units
+    float area = 0.0f;
+};
+
+namespace bake {
+
+inline glm::vec3 averageTextureColor(const std::string &path)
+{
+    int width, height, channels;
+    unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 3);
+    if (!data)
+        return glm::vec3(-1.0f);
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    size_t count = 0;
+    // every 4th texel in both directions is plenty for an average
+    for (int y = 0; y < height; y += 4)
+        for (int x = 0; x < width; x += 4) {
+            const unsigned char *texel = data + ((size_t) y * width + x) * 3;
+            for (int c = 0; c < 3; c++)
+                sum[c] += texel[c];
+            count++;
+        }
+    stbi_image_free(data);
+    double scale = 1.0 / (255.0 * std::max<size_t>(count, 1));
+    return glm::vec3(sum[0] * scale, sum[1] * scale, sum[2] * scale);
+}
+
+inline void loadNode(const aiNode *node, const aiScene *scene, const std::string &directory, BakeModel &model)
+{
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        const aiMesh *source = scene->mMeshes[node->mMeshes[i]];
+        BakeMesh mesh;
+        for (unsigned int v = 0; v < source->mNumVertices; v++) {
+            mesh.positions.push_back(glm::vec3(source->mVertices[v].x, source->mVertices[v].y, source->mVertices[v].z));
+            mesh.normals.push_back(source->HasNormals()
+                                   ? glm::vec3(source->mNormals[v].x, source->mNormals[v].y, source->mNormals[v].z)
+                                   : glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+        for (unsigned int f = 0; f < source->mNumFaces; f++)
+            for (unsigned int j = 0; j < source->mFaces[f].mNumIndices; j++)
+                mesh.indices.push_back(source->mFaces[f].mIndices[j]);
+
+        const aiMaterial *material = scene->mMaterials[source->mMaterialIndex];
+        aiString texture;
+        glm::vec3 albedo(-1.0f);
+        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS)
+            albedo = averageTextureColor(directory + '/' + texture.C_Str());
+        if (albedo.x < 0.0f) {
+            aiColor3D color(0.7f, 0.7f, 0.7f);
+            material->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+            albedo = glm::vec3(color.r, color.g, color.b);
+        }
+        mesh.albedo = albedo;
+        model.meshes.push_back(mesh);
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        loadNode(node->mChildren[i], scene, directory, model);
+}
+
+} // namespace bake
+
+inline bool LoadBakeModel(const std::string &path, BakeModel &model)
+{
+    Assimp::Importer importer;
+    // has to match Model::loadModel, the lightmap refers to its vertex indices
+    const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    model.path = path;
+    bake::loadNode(scene->mRootNode, scene, path.substr(0, path.find_last_of('/')), model);
+    model.area = 0.0f;
+    for (const BakeMesh &mesh : model.meshes)
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            glm::vec3 a = mesh.positions[mesh.indices[t]], b = mesh.positions[mesh.indices[t + 1]],
+                      c = mesh.positions[mesh.indices[t + 2]];
+            model.area += 0.5f * glm::length(glm::cross(b - a, c - a));
+        }
+    return true;
+}
+
+// Second UV set for a model at texelsPerUnit.
+// Triangles are grown into charts across shared edges while their normals stay within ~30 degrees of the chart's
+// first triangle, each chart is projected onto its own plane (no overlap for such near planar charts) and the
+// charts are shelf packed into a square with padding texels around every one so bilinear filtering and the
+// dilation of the bake never bleed between them. Vertices used by several charts are split.
+inline void BuildCharts(BakeModel &model, float texelsPerUnit, int padding)
+{
+    const float NORMAL_THRESHOLD = 0.87f;
+
+    struct Chart {
+        int mesh;
+        std::vector<uint32_t> triangles;
+        glm::vec3 tangent, bitangent;
+        glm::vec2 uvMin, uvMax;
+        int width, height;
+        int x = 0, y = 0;
+    };
+    std::vector<Chart> charts;
+    std::vector<std::vector<int>> triangleChart(model.meshes.size());
+
+    for (size_t m = 0; m < model.meshes.size(); m++) {
+        BakeMesh &mesh = model.meshes[m];
+        size_t triangleCount = mesh.indices.size() / 3;
+
+        // the importer doesn't join identical vertices, so neighbours are found through welded positions
+        std::vector<uint32_t> weld(mesh.positions.size());
+        std::unordered_map<uint64_t, uint32_t> welded;
+        const float quantization = 1e4f;
+        for (size_t v = 0; v < mesh.positions.size(); v++) {
+            glm::vec3 p = mesh.positions[v] * quantization;
+            uint64_t key = ((uint64_t) (int64_t) std::floor(p.x) * 73856093ull) ^ ((uint64_t) (int64_t) std::floor(p.y) * 19349663ull)
+                           ^ ((uint64_t) (int64_t) std::floor(p.z) * 83492791ull);
+            weld[v] = welded.emplace(key, (uint32_t) v).first->second;
+        }
+        std::unordered_map<uint64_t, std::vector<uint32_t>> edgeTriangles;
+        std::vector<glm::vec3> faceNormals(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            glm::vec3 a = mesh.positions[mesh.indices[t * 3]], b = mesh.positions[mesh.indices[t * 3 + 1]],
+                      c = mesh.positions[mesh.indices[t * 3 + 2]];
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            faceNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+            for (int e = 0; e < 3; e++) {
+                uint64_t i0 = weld[mesh.indices[t * 3 + e]], i1 = weld[mesh.indices[t * 3 + (e + 1) % 3]];
+                edgeTriangles[(std::min(i0, i1) << 32) | std::max(i0, i1)].push_back(t);
+            }
+        }
+
+        triangleChart[m].assign(triangleCount, -1);
+        std::vector<uint32_t> queue;
+        for (size_t seed = 0; seed < triangleCount; seed++) {
+            if (triangleChart[m][seed] >= 0)
+                continue;
+            Chart chart;
+            chart.mesh = m;
+            int chartIndex = charts.size();
+            glm::vec3 chartNormal = faceNormals[seed];
+            queue.assign(1, seed);
+            triangleChart[m][seed] = chartIndex;
+            while (!queue.empty()) {
+                uint32_t t = queue.back();
+                queue.pop_back();
+                chart.triangles.push_back(t);
+                for (int e = 0; e < 3; e++) {
+                    uint64_t i0 = weld[mesh.indices[t * 3 + e]], i1 = weld[mesh.indices[t * 3 + (e + 1) % 3]];
+                    for (uint32_t neighbour : edgeTriangles[(std::min(i0, i1) << 32) | std::max(i0, i1)]) {
+                        if (triangleChart[m][neighbour] >= 0 || glm::dot(faceNormals[neighbour], chartNormal) < NORMAL_THRESHOLD)
+                            continue;
+                        triangleChart[m][neighbour] = chartIndex;
+                        queue.push_back(neighbour);
+                    }
+                }
+            }
+
+            // plane of the chart from its area weighted normal
+            glm::vec3 normal(0.0f);
+            for (uint32_t t : chart.triangles) {
+                glm::vec3 a = mesh.positions[mesh.indices[t * 3]], b = mesh.positions[mesh.indices[t * 3 + 1]],
+                          c = mesh.positions[mesh.indices[t * 3 + 2]];
+                normal += glm::cross(b - a, c - a);
+            }
+            normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 helper = std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            chart.tangent = glm::normalize(glm::cross(helper, normal));
+            chart.bitangent = glm::cross(normal, chart.tangent);
+            chart.uvMin = glm::vec2(1e30f);
+            chart.uvMax = glm::vec2(-1e30f);
+            for (uint32_t t : chart.triangles)
+                for (int k = 0; k < 3; k++) {
+                    glm::vec3 p = mesh.positions[mesh.indices[t * 3 + k]];
+                    glm::vec2 uv(glm::dot(p, chart.tangent), glm::dot(p, chart.bitangent));
+                    chart.uvMin = glm::min(chart.uvMin, uv);
+                    chart.uvMax = glm::max(chart.uvMax, uv);
+                }
+            glm::vec2 size = (chart.uvMax - chart.uvMin) * texelsPerUnit;
+            chart.width = (int) std::ceil(size.x) + 1 + 2 * padding;
+            chart.height = (int) std::ceil(size.y) + 1 + 2 * padding;
+            charts.push_back(chart);
+        }
+    }
+
+    // shelf packing, tallest charts first
+    std::vector<int> order(charts.size());
+    double totalArea = 0.0;
+    int widest = 0;
+    for (size_t i = 0; i < charts.size(); i++) {
+        order[i] = i;
+        totalArea += (double) charts[i].width * charts[i].height;
+        widest = std::max(widest, charts[i].width);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return charts[a].height > charts[b].height; });
+    int shelfWidth = std::max(widest, (int) std::ceil(std::sqrt(totalArea * 1.15)));
+    int x = 0, y = 0, shelfHeight = 0;
+    for (int i : order) {
+        Chart &chart = charts[i];
+        if (x + chart.width > shelfWidth) {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+        chart.x = x;
+        chart.y = y;
+        x += chart.width;
+        shelfHeight = std::max(shelfHeight, chart.height);
+    }
+    model.resolution = std::max(shelfWidth, y + shelfHeight);
+
+    // split the vertices per chart and write the new uv set
+    for (size_t m = 0; m < model.meshes.size(); m++) {
+        BakeMesh &mesh = model.meshes[m];
+        mesh.remap.clear();
+        mesh.uv.clear();
+        mesh.chartIndices.clear();
+        std::unordered_map<uint64_t, uint32_t> splitVertices;
+        for (size_t t = 0; t < mesh.indices.size() / 3; t++) {
+            const Chart &chart = charts[triangleChart[m][t]];
+            for (int k = 0; k < 3; k++) {
+                uint32_t original = mesh.indices[t * 3 + k];
+                uint64_t key = ((uint64_t) triangleChart[m][t] << 32) | original;
+                auto found = splitVertices.find(key);
+                if (found == splitVertices.end()) {
+                    glm::vec3 p = mesh.positions[original];
+                    glm::vec2 local = (glm::vec2(glm::dot(p, chart.tangent), glm::dot(p, chart.bitangent)) - chart.uvMin)
+                                      * texelsPerUnit;
+                    glm::vec2 texel = glm::vec2(chart.x + padding, chart.y + padding) + local + 0.5f;
+                    found = splitVertices.emplace(key, (uint32_t) mesh.remap.size()).first;
+                    mesh.remap.push_back(original);
+                    mesh.uv.push_back(texel / (float) model.resolution);
+                }
+                mesh.chartIndices.push_back(found->second);
+            }
+        }
+    }
+}
+
+#endif
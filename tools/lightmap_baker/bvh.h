@@ -0,0 +1,331 @@
+#ifndef LIGHTMAP_BAKER_BVH_H
+#define LIGHTMAP_BAKER_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+// World space triangle as the intersection test wants it
+struct BvhTriangle {
+    glm::vec3 v0, edge1, edge2;
+    glm::vec3 normal;
+    glm::vec3 albedo;
+};
+
+// Four rays traced together, one per SSE lane. Lanes that are off (mask) are never reported as hits.
+struct RayPacket {
+    __m128 originX, originY, originZ;
+    __m128 directionX, directionY, directionZ;
+    __m128 tMax;
+    int mask = 0xf;
+
+    void Set(int lane, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance)
+    {
+        ((float *) &originX)[lane] = origin.x;
+        ((float *) &originY)[lane] = origin.y;
+        ((float *) &originZ)[lane] = origin.z;
+        ((float *) &directionX)[lane] = direction.x;
+        ((float *) &directionY)[lane] = direction.y;
+        ((float *) &directionZ)[lane] = direction.z;
+        ((float *) &tMax)[lane] = maxDistance;
+    }
+};
+
+struct PacketHit {
+    float t[4];
+    // -1 for a miss
+    int triangle[4];
+};
+
+// Bounding volume hierarchy over all static triangles, built with binned SAH.
+// Nodes are 32 bytes in depth first order: an inner node's left child follows it, the right one is at 'offset';
+// a leaf's triangles are triangles[offset, offset + count).
+class Bvh
+{
+public:
+    std::vector<BvhTriangle> triangles;
+
+    void Build(std::vector<BvhTriangle> input)
+    {
+        triangles.swap(input);
+        nodes.clear();
+        nodes.reserve(triangles.size() * 2);
+        std::vector<glm::vec3> centroids(triangles.size());
+        for (size_t i = 0; i < triangles.size(); i++) {
+            const BvhTriangle &triangle = triangles[i];
+            centroids[i] = triangle.v0 + (triangle.edge1 + triangle.edge2) / 3.0f;
+        }
+        build(0, triangles.size(), centroids);
+    }
+
+    size_t NodeCount() const
+    {
+        return nodes.size();
+    }
+
+    // closest hit of every ray in the packet
+    void Intersect(const RayPacket &packet, PacketHit &hit) const
+    {
+        __m128 tMax = packet.tMax;
+        __m128i triangle = _mm_set1_epi32(-1);
+        traverse(packet, tMax, [&](const BvhTriangle &candidate, int index, int active) {
+            __m128 t;
+            int hits = intersect(candidate, packet, tMax, t) & active;
+            if (!hits)
+                return 0;
+            __m128 hitMask = laneMask(hits);
+            tMax = _mm_or_ps(_mm_and_ps(hitMask, t), _mm_andnot_ps(hitMask, tMax));
+            triangle = _mm_castps_si128(_mm_or_ps(_mm_and_ps(hitMask, _mm_castsi128_ps(_mm_set1_epi32(index))),
+                                                  _mm_andnot_ps(hitMask, _mm_castsi128_ps(triangle))));
+            return 0;
+        });
+        _mm_storeu_ps(hit.t, tMax);
+        _mm_storeu_si128((__m128i *) hit.triangle, triangle);
+    }
+
+    // lanes of the packet that hit anything before their tMax, stops as soon as all of them did
+    int Occluded(const RayPacket &packet) const
+    {
+        __m128 tMax = packet.tMax;
+        int occluded = 0;
+        traverse(packet, tMax, [&](const BvhTriangle &candidate, int index, int active) {
+            __m128 t;
+            occluded |= intersect(candidate, packet, tMax, t) & active;
+            return occluded;
+        });
+        return occluded & packet.mask;
+    }
+
+    // number of lanes set in a mask of a packet
+    static int LaneCount(int mask)
+    {
+        static const int counts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+        return counts[mask & 0xf];
+    }
+
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        uint32_t offset;
+        glm::vec3 boundsMax;
+        // 0 for inner nodes
+        uint16_t count;
+        uint16_t axis;
+    };
+
+    static const int BINS = 16;
+    static const int LEAF_SIZE = 4;
+
+    std::vector<Node> nodes;
+
+    static __m128 laneMask(int mask)
+    {
+        return _mm_castsi128_ps(_mm_set_epi32(mask & 8 ? -1 : 0, mask & 4 ? -1 : 0, mask & 2 ? -1 : 0, mask & 1 ? -1 : 0));
+    }
+
+    uint32_t build(size_t begin, size_t end, std::vector<glm::vec3> &centroids)
+    {
+        uint32_t index = nodes.size();
+        nodes.push_back(Node());
+        glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (size_t i = begin; i < end; i++) {
+            const BvhTriangle &triangle = triangles[i];
+            glm::vec3 v1 = triangle.v0 + triangle.edge1, v2 = triangle.v0 + triangle.edge2;
+            boundsMin = glm::min(boundsMin, glm::min(triangle.v0, glm::min(v1, v2)));
+            boundsMax = glm::max(boundsMax, glm::max(triangle.v0, glm::max(v1, v2)));
+            centroidMin = glm::min(centroidMin, centroids[i]);
+            centroidMax = glm::max(centroidMax, centroids[i]);
+        }
+        nodes[index].boundsMin = boundsMin;
+        nodes[index].boundsMax = boundsMax;
+
+        size_t count = end - begin;
+        int axis = 0;
+        size_t split = 0;
+        if (count > LEAF_SIZE)
+            split = findSplit(begin, end, centroids, centroidMin, centroidMax, area(boundsMin, boundsMax), axis);
+        if (split == 0) {
+            nodes[index].offset = begin;
+            nodes[index].count = count;
+            return index;
+        }
+
+        build(begin, split, centroids);
+        uint32_t right = build(split, end, centroids);
+        nodes[index].offset = right;
+        nodes[index].count = 0;
+        nodes[index].axis = axis;
+        return index;
+    }
+
+    static float area(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+    {
+        glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+        return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+    }
+
+    // partitions [begin, end) at the cheapest bin boundary, 0 when a leaf is cheaper
+    size_t findSplit(size_t begin, size_t end, std::vector<glm::vec3> &centroids, const glm::vec3 &centroidMin,
+                     const glm::vec3 &centroidMax, float parentArea, int &bestAxis)
+    {
+        float bestCost = (float) (end - begin) * parentArea;
+        int bestBin = -1;
+        bestAxis = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = centroidMax[axis] - centroidMin[axis];
+            if (extent <= 0.0f)
+                continue;
+            glm::vec3 binMin[BINS], binMax[BINS];
+            int binCount[BINS] = {};
+            for (int b = 0; b < BINS; b++) {
+                binMin[b] = glm::vec3(FLT_MAX);
+                binMax[b] = glm::vec3(-FLT_MAX);
+            }
+            float scale = BINS / extent;
+            for (size_t i = begin; i < end; i++) {
+                int b = std::min(BINS - 1, (int) ((centroids[i][axis] - centroidMin[axis]) * scale));
+                const BvhTriangle &triangle = triangles[i];
+                glm::vec3 v1 = triangle.v0 + triangle.edge1, v2 = triangle.v0 + triangle.edge2;
+                binMin[b] = glm::min(binMin[b], glm::min(triangle.v0, glm::min(v1, v2)));
+                binMax[b] = glm::max(binMax[b], glm::max(triangle.v0, glm::max(v1, v2)));
+                binCount[b]++;
+            }
+            // sweep from the right, then from the left evaluating every boundary
+            float rightArea[BINS];
+            int rightCount[BINS];
+            glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+            int sweepCount = 0;
+            for (int b = BINS - 1; b > 0; b--) {
+                sweepMin = glm::min(sweepMin, binMin[b]);
+                sweepMax = glm::max(sweepMax, binMax[b]);
+                sweepCount += binCount[b];
+                rightArea[b] = area(sweepMin, sweepMax);
+                rightCount[b] = sweepCount;
+            }
+            sweepMin = glm::vec3(FLT_MAX);
+            sweepMax = glm::vec3(-FLT_MAX);
+            sweepCount = 0;
+            for (int b = 0; b < BINS - 1; b++) {
+                sweepMin = glm::min(sweepMin, binMin[b]);
+                sweepMax = glm::max(sweepMax, binMax[b]);
+                sweepCount += binCount[b];
+                if (sweepCount == 0 || rightCount[b + 1] == 0)
+                    continue;
+                float cost = sweepCount * area(sweepMin, sweepMax) + rightCount[b + 1] * rightArea[b + 1];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestBin = b;
+                    bestAxis = axis;
+                }
+            }
+        }
+        if (bestBin < 0)
+            return 0;
+
+        float scale = BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+        size_t middle = begin;
+        for (size_t i = begin; i < end; i++) {
+            int b = std::min(BINS - 1, (int) ((centroids[i][bestAxis] - centroidMin[bestAxis]) * scale));
+            if (b <= bestBin) {
+                std::swap(triangles[i], triangles[middle]);
+                std::swap(centroids[i], centroids[middle]);
+                middle++;
+            }
+        }
+        return middle == begin || middle == end ? 0 : middle;
+    }
+
+    // calls leaf(triangle, index, activeLanes) for the triangles of every leaf the packet reaches, a non zero
+    // return value of leaf() are lanes that are done (any hit queries)
+    template<typename Leaf>
+    void traverse(const RayPacket &packet, const __m128 &tMax, Leaf leaf) const
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 inverseX = _mm_div_ps(one, packet.directionX);
+        const __m128 inverseY = _mm_div_ps(one, packet.directionY);
+        const __m128 inverseZ = _mm_div_ps(one, packet.directionZ);
+        const bool negative[3] = { ((float *) &packet.directionX)[0] < 0.0f, ((float *) &packet.directionY)[0] < 0.0f,
+                                   ((float *) &packet.directionZ)[0] < 0.0f };
+        int done = 0;
+
+        uint32_t stack[128];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const Node &node = nodes[stack[--stackSize]];
+            // slab test of all four rays against the node bounds
+            __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.x), packet.originX), inverseX);
+            __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.x), packet.originX), inverseX);
+            __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.y), packet.originY), inverseY);
+            __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.y), packet.originY), inverseY);
+            __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin.z), packet.originZ), inverseZ);
+            __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax.z), packet.originZ), inverseZ);
+            __m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+                                      _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_setzero_ps()));
+            __m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+                                     _mm_min_ps(_mm_max_ps(t0z, t1z), tMax));
+            int active = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & packet.mask & ~done;
+            if (!active)
+                continue;
+
+            if (node.count > 0) {
+                for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+                    done |= leaf(triangles[i], (int) i, active);
+                if ((done & packet.mask) == packet.mask)
+                    return;
+                continue;
+            }
+            // near child last so it is visited first, decided by the first ray's direction
+            uint32_t left = &node - &nodes[0] + 1;
+            if (negative[node.axis]) {
+                stack[stackSize++] = left;
+                stack[stackSize++] = node.offset;
+            } else {
+                stack[stackSize++] = node.offset;
+                stack[stackSize++] = left;
+            }
+        }
+    }
+
+    // Moller-Trumbore of one triangle against the four rays, returns the lanes that hit closer than tMax
+    static int intersect(const BvhTriangle &triangle, const RayPacket &packet, const __m128 &tMax, __m128 &t)
+    {
+        const __m128 e1x = _mm_set1_ps(triangle.edge1.x), e1y = _mm_set1_ps(triangle.edge1.y), e1z = _mm_set1_ps(triangle.edge1.z);
+        const __m128 e2x = _mm_set1_ps(triangle.edge2.x), e2y = _mm_set1_ps(triangle.edge2.y), e2z = _mm_set1_ps(triangle.edge2.z);
+        // p = d x e2
+        __m128 px = _mm_sub_ps(_mm_mul_ps(packet.directionY, e2z), _mm_mul_ps(packet.directionZ, e2y));
+        __m128 py = _mm_sub_ps(_mm_mul_ps(packet.directionZ, e2x), _mm_mul_ps(packet.directionX, e2z));
+        __m128 pz = _mm_sub_ps(_mm_mul_ps(packet.directionX, e2y), _mm_mul_ps(packet.directionY, e2x));
+        __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+        __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+        // s = o - v0
+        __m128 sx = _mm_sub_ps(packet.originX, _mm_set1_ps(triangle.v0.x));
+        __m128 sy = _mm_sub_ps(packet.originY, _mm_set1_ps(triangle.v0.y));
+        __m128 sz = _mm_sub_ps(packet.originZ, _mm_set1_ps(triangle.v0.z));
+        __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+        // q = s x e1
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+        __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.directionX, qx), _mm_mul_ps(packet.directionY, qy)),
+                                         _mm_mul_ps(packet.directionZ, qz)), inverse);
+        t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverse);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 epsilon = _mm_set1_ps(1e-8f);
+        __m128 absDeterminant = _mm_andnot_ps(_mm_set1_ps(-0.0f), determinant);
+        __m128 hit = _mm_and_ps(_mm_cmpgt_ps(absDeterminant, epsilon), _mm_cmpge_ps(u, zero));
+        hit = _mm_and_ps(hit, _mm_cmpge_ps(v, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(t, zero));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(t, tMax));
+        return _mm_movemask_ps(hit);
+    }
+};
+
+#endif
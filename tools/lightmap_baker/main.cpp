@@ -0,0 +1,545 @@
+// Offline lightmap baker for the static part of the scene (city, platform, bridges).
+// Bakes the directional light with soft shadows plus one bounce of sky and sun light into an RGB9_E5 irradiance
+// atlas and an 8 bit ambient occlusion atlas, written to resources/lightmaps/city.lmap for Lightmap to load.
+//
+//   lightmap_baker [--size 2048] [--samples 64] [--skybox space2] [--output resources/lightmaps/city.lmap]
+//                  [--scaling]
+//
+// The sun and the skybox come from resources/program_state.txt (--skybox overrides it), the renderer only uses
+// the bake while it is lit the same way.
+// --scaling bakes again with 1, 2, 4 ... threads (and fewer samples) and prints how the bake scales.
+// Run it from the repository root, like the renderer.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/lightmap_file.h>
+#include <learnopengl/sh_ambient.h>
+#include <learnopengl/static_scene.h>
+#include <learnopengl/thread_pool.h>
+
+#include "bake_scene.h"
+#include "bvh.h"
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct BakeSettings {
+    int size = 2048;
+    int samples = 64;
+    std::string output = "resources/lightmaps/city.lmap";
+    bool scaling = false;
+    BakedLighting lighting;
+    float aoDistance = 2.0f;
+    // angular radius of the sun in radians, for the penumbra
+    float sunRadius = 0.02f;
+};
+
+// everything the bake needs at one atlas texel, valid == false for texels no triangle covers
+struct BakeTexel {
+    glm::vec3 position;
+    glm::vec3 normal;
+    bool valid = false;
+};
+
+struct Sky {
+    // radiance coefficients (the cache keeps them convolved for irradiance)
+    glm::vec3 radiance[9];
+    glm::vec3 irradiance[9];
+    bool harmonics = false;
+    glm::vec3 flat;
+
+    static glm::vec3 evaluate(const glm::vec3 coefficients[9], const glm::vec3 &n)
+    {
+        float y[9];
+        SkyboxAmbient::Basis(n, y);
+        glm::vec3 result(0.0f);
+        for (int i = 0; i < 9; i++)
+            result += coefficients[i] * y[i];
+        return glm::max(result, glm::vec3(0.0f));
+    }
+
+    // radiance arriving from direction
+    glm::vec3 Radiance(const glm::vec3 &direction) const
+    {
+        return harmonics ? evaluate(radiance, direction) : flat;
+    }
+
+    // irradiance / pi on a surface facing normal, what EvalSH() gives the shaders
+    glm::vec3 Irradiance(const glm::vec3 &normal) const
+    {
+        return harmonics ? evaluate(irradiance, normal) : flat;
+    }
+};
+
+// small fast generator, seeded per texel so a bake doesn't depend on how the tiles were scheduled
+struct Random {
+    uint32_t state;
+
+    explicit Random(uint32_t seed) : state(seed * 747796405u + 2891336453u)
+    {
+    }
+
+    float Next()
+    {
+        state = state * 747796405u + 2891336453u;
+        uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (float) ((word >> 22u) ^ word >> 8) / 16777216.0f;
+    }
+};
+
+static void basisFrom(const glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent)
+{
+    glm::vec3 helper = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    tangent = glm::normalize(glm::cross(helper, normal));
+    bitangent = glm::cross(normal, tangent);
+}
+
+static glm::vec3 cosineSample(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent, float u1, float u2)
+{
+    float radius = std::sqrt(u1);
+    float phi = 6.2831853f * u2;
+    return glm::normalize(tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi))
+                          + normal * std::sqrt(std::max(0.0f, 1.0f - u1)));
+}
+
+class Baker
+{
+public:
+    Baker(const BakeSettings &settings, ThreadPool &pool) : settings(settings), pool(pool)
+    {
+    }
+
+    bool Load()
+    {
+        for (int i = 0; i < STATIC_MODEL_COUNT; i++) {
+            std::cout << "loading " << STATIC_MODEL_PATHS[i] << std::endl;
+            if (!LoadBakeModel(STATIC_MODEL_PATHS[i], models[i]))
+                return false;
+        }
+        objects = StaticScene();
+
+        SkyboxAmbient::Projection projection;
+        std::string directory = "resources/textures/skybox/" + settings.lighting.skybox;
+        sky.flat = settings.lighting.flatAmbient;
+        sky.harmonics = SkyboxAmbient::ReadCached(directory, projection);
+        if (sky.harmonics) {
+            static const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+            for (int i = 0; i < 9; i++) {
+                sky.irradiance[i] = projection.coefficients[i];
+                sky.radiance[i] = projection.coefficients[i] / band[i];
+            }
+        } else {
+            std::cout << "no spherical harmonics cached for " << directory
+                      << " (run the renderer with that skybox once), using the flat ambient" << std::endl;
+        }
+        return true;
+    }
+
+    // charts every model and places one rect per object in the atlas, lowering the texel density until they fit
+    void Layout()
+    {
+        float worldArea = 0.0f;
+        for (const StaticObject &object : objects) {
+            float scale = instanceScale(object.transform);
+            worldArea += models[object.model].area * scale * scale;
+        }
+        // charts, padding and the shelves waste a good part of the atlas, start at half of it
+        float density = std::sqrt(0.5f * settings.size * settings.size / std::max(worldArea, 1e-6f));
+        for (;;) {
+            for (int i = 0; i < STATIC_MODEL_COUNT; i++) {
+                float scale = 0.0f;
+                for (const StaticObject &object : objects)
+                    if (object.model == i)
+                        scale = std::max(scale, instanceScale(object.transform));
+                BuildCharts(models[i], density * scale, 2);
+            }
+            if (packInstances())
+                break;
+            density *= 0.85f;
+        }
+        std::cout << "texel density " << density << " texels per unit" << std::endl;
+    }
+
+    // world position and normal of every covered texel
+    void Rasterize()
+    {
+        texels.assign((size_t) settings.size * settings.size, BakeTexel());
+        std::vector<BvhTriangle> triangles;
+        for (size_t o = 0; o < objects.size(); o++) {
+            const StaticObject &object = objects[o];
+            const BakeModel &model = models[object.model];
+            glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(object.transform)));
+            glm::vec2 origin(rects[o].x, rects[o].y);
+            for (const BakeMesh &mesh : model.meshes) {
+                std::vector<glm::vec3> world(mesh.positions.size());
+                for (size_t v = 0; v < world.size(); v++)
+                    world[v] = glm::vec3(object.transform * glm::vec4(mesh.positions[v], 1.0f));
+                for (size_t t = 0; t + 2 < mesh.chartIndices.size(); t += 3) {
+                    uint32_t corners[3] = { mesh.chartIndices[t], mesh.chartIndices[t + 1], mesh.chartIndices[t + 2] };
+                    glm::vec3 p[3], n[3];
+                    glm::vec2 uv[3];
+                    for (int k = 0; k < 3; k++) {
+                        uint32_t original = mesh.remap[corners[k]];
+                        p[k] = world[original];
+                        n[k] = glm::normalize(normalMatrix * mesh.normals[original]);
+                        uv[k] = origin + mesh.uv[corners[k]] * (float) model.resolution;
+                    }
+                    BvhTriangle triangle;
+                    triangle.v0 = p[0];
+                    triangle.edge1 = p[1] - p[0];
+                    triangle.edge2 = p[2] - p[0];
+                    glm::vec3 faceNormal = glm::cross(triangle.edge1, triangle.edge2);
+                    if (glm::length(faceNormal) == 0.0f)
+                        continue;
+                    triangle.normal = glm::normalize(faceNormal);
+                    triangle.albedo = mesh.albedo;
+                    triangles.push_back(triangle);
+                    rasterizeTriangle(p, n, uv);
+                }
+            }
+        }
+        size_t covered = 0;
+        for (const BakeTexel &texel : texels)
+            covered += texel.valid;
+        std::cout << triangles.size() << " triangles, " << covered << " texels covered ("
+                  << 100.0 * covered / texels.size() << "% of the atlas)" << std::endl;
+
+        auto start = std::chrono::steady_clock::now();
+        bvh.Build(triangles);
+        std::cout << "bvh: " << bvh.NodeCount() << " nodes in " << millisecondsSince(start) << " ms" << std::endl;
+    }
+
+    // bakes every tile on up to maxThreads threads (0 for all), returns the milliseconds it took
+    double Bake(int samples, unsigned int maxThreads = 0)
+    {
+        irradiance.assign(texels.size(), glm::vec3(0.0f));
+        occlusion.assign(texels.size(), 1.0f);
+        int tilesX = (settings.size + TILE - 1) / TILE;
+        auto start = std::chrono::steady_clock::now();
+        pool.ParallelFor(tilesX * tilesX, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int tile = begin; tile < end; tile++)
+                bakeTile((tile % tilesX) * TILE, (tile / tilesX) * TILE, samples);
+        }, maxThreads);
+        return millisecondsSince(start);
+    }
+
+    bool Write(const std::string &path)
+    {
+        dilate();
+        dilate();
+
+        LightmapFile file;
+        file.width = file.height = settings.size;
+        file.lighting = settings.lighting;
+        for (int i = 0; i < STATIC_MODEL_COUNT; i++) {
+            LightmapFile::Model model;
+            model.path = models[i].path;
+            for (const BakeMesh &mesh : models[i].meshes) {
+                LightmapFile::Mesh out;
+                out.remap = mesh.remap;
+                out.indices = mesh.chartIndices;
+                for (const glm::vec2 &uv : mesh.uv) {
+                    out.uv.push_back((uint16_t) std::lround(glm::clamp(uv.x, 0.0f, 1.0f) * 65535.0f));
+                    out.uv.push_back((uint16_t) std::lround(glm::clamp(uv.y, 0.0f, 1.0f) * 65535.0f));
+                }
+                model.meshes.push_back(out);
+            }
+            file.models.push_back(model);
+        }
+        for (size_t o = 0; o < objects.size(); o++) {
+            LightmapFile::Instance instance;
+            instance.model = objects[o].model;
+            instance.transform = objects[o].transform;
+            float scale = (float) models[objects[o].model].resolution / settings.size;
+            instance.scaleOffset = glm::vec4(scale, scale, (float) rects[o].x / settings.size,
+                                             (float) rects[o].y / settings.size);
+            file.instances.push_back(instance);
+        }
+        file.irradiance.resize(irradiance.size());
+        file.occlusion.resize(occlusion.size());
+        for (size_t i = 0; i < irradiance.size(); i++) {
+            file.irradiance[i] = LightmapFile::PackRGB9E5(irradiance[i]);
+            file.occlusion[i] = (uint8_t) std::lround(glm::clamp(occlusion[i], 0.0f, 1.0f) * 255.0f);
+        }
+
+        std::string directory = path.substr(0, path.find_last_of('/'));
+        mkdir(directory.c_str(), 0755);
+        return file.Write(path);
+    }
+
+private:
+    static const int TILE = 32;
+
+    struct Rect {
+        int x, y;
+    };
+
+    const BakeSettings &settings;
+    ThreadPool &pool;
+    BakeModel models[STATIC_MODEL_COUNT];
+    std::vector<StaticObject> objects;
+    std::vector<Rect> rects;
+    Sky sky;
+    Bvh bvh;
+    std::vector<BakeTexel> texels;
+    std::vector<glm::vec3> irradiance;
+    std::vector<float> occlusion;
+
+    static double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static float instanceScale(const glm::mat4 &transform)
+    {
+        return glm::length(glm::vec3(transform[0]));
+    }
+
+    bool packInstances()
+    {
+        std::vector<int> order(objects.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return models[objects[a].model].resolution > models[objects[b].model].resolution;
+        });
+        rects.assign(objects.size(), Rect());
+        int x = 0, y = 0, shelfHeight = 0;
+        for (int i : order) {
+            int size = models[objects[i].model].resolution;
+            if (x + size > settings.size) {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+            if (x + size > settings.size || y + size > settings.size)
+                return false;
+            rects[i] = Rect{ x, y };
+            x += size;
+            shelfHeight = std::max(shelfHeight, size);
+        }
+        return true;
+    }
+
+    // marks the texels whose centers lie in the triangle, uv in atlas texels
+    void rasterizeTriangle(const glm::vec3 p[3], const glm::vec3 n[3], const glm::vec2 uv[3])
+    {
+        glm::vec2 low = glm::min(uv[0], glm::min(uv[1], uv[2]));
+        glm::vec2 high = glm::max(uv[0], glm::max(uv[1], uv[2]));
+        float area = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+        if (std::abs(area) < 1e-12f)
+            return;
+        int x0 = std::max(0, (int) std::floor(low.x)), x1 = std::min(settings.size - 1, (int) std::ceil(high.x));
+        int y0 = std::max(0, (int) std::floor(low.y)), y1 = std::min(settings.size - 1, (int) std::ceil(high.y));
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++) {
+                glm::vec2 center(x + 0.5f, y + 0.5f);
+                float w1 = ((center.x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (center.y - uv[0].y)) / area;
+                float w2 = ((uv[1].x - uv[0].x) * (center.y - uv[0].y) - (center.x - uv[0].x) * (uv[1].y - uv[0].y)) / area;
+                float w0 = 1.0f - w1 - w2;
+                // a little outside the edges too, sliver triangles would otherwise leave holes
+                const float EPSILON = -1e-3f;
+                if (w0 < EPSILON || w1 < EPSILON || w2 < EPSILON)
+                    continue;
+                BakeTexel &texel = texels[(size_t) y * settings.size + x];
+                texel.position = p[0] * w0 + p[1] * w1 + p[2] * w2;
+                glm::vec3 normal = n[0] * w0 + n[1] * w1 + n[2] * w2;
+                texel.normal = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+                texel.valid = true;
+            }
+    }
+
+    void bakeTile(int tileX, int tileY, int samples)
+    {
+        glm::vec3 toSun = glm::normalize(-settings.lighting.sunDirection);
+        glm::vec3 sunTangent, sunBitangent;
+        basisFrom(toSun, sunTangent, sunBitangent);
+        const float BIAS = 0.01f;
+        const float FAR = 1e30f;
+
+        for (int y = tileY; y < std::min(tileY + TILE, settings.size); y++)
+            for (int x = tileX; x < std::min(tileX + TILE, settings.size); x++) {
+                size_t index = (size_t) y * settings.size + x;
+                const BakeTexel &texel = texels[index];
+                if (!texel.valid)
+                    continue;
+                Random random((uint32_t) index);
+                glm::vec3 origin = texel.position + texel.normal * BIAS;
+                glm::vec3 tangent, bitangent;
+                basisFrom(texel.normal, tangent, bitangent);
+
+                // direct sun, four jittered rays over the disc of the sun for soft shadow edges
+                glm::vec3 direct(0.0f);
+                float cosine = glm::dot(texel.normal, toSun);
+                if (cosine > 0.0f) {
+                    RayPacket shadow;
+                    for (int lane = 0; lane < 4; lane++) {
+                        glm::vec3 jitter = sunTangent * ((random.Next() * 2.0f - 1.0f) * settings.sunRadius)
+                                           + sunBitangent * ((random.Next() * 2.0f - 1.0f) * settings.sunRadius);
+                        shadow.Set(lane, origin, glm::normalize(toSun + jitter), FAR);
+                    }
+                    int occluded = bvh.Occluded(shadow);
+                    float visible = 1.0f - 0.25f * (float) Bvh::LaneCount(occluded);
+                    direct = settings.lighting.sunColor * cosine * visible;
+                }
+
+                // sky and one bounce over the hemisphere, cosine weighted so the mean is irradiance / pi
+                glm::vec3 indirect(0.0f);
+                int unoccluded = 0;
+                int packets = (samples + 3) / 4;
+                for (int p = 0; p < packets; p++) {
+                    RayPacket packet;
+                    glm::vec3 directions[4];
+                    for (int lane = 0; lane < 4; lane++) {
+                        directions[lane] = cosineSample(texel.normal, tangent, bitangent, random.Next(), random.Next());
+                        packet.Set(lane, origin, directions[lane], FAR);
+                    }
+                    PacketHit hit;
+                    bvh.Intersect(packet, hit);
+
+                    // the surfaces that were hit see the sun through one shadow ray each
+                    RayPacket shadow;
+                    shadow.mask = 0;
+                    glm::vec3 hitNormals[4];
+                    for (int lane = 0; lane < 4; lane++) {
+                        shadow.Set(lane, origin, toSun, 0.0f);
+                        if (hit.triangle[lane] < 0)
+                            continue;
+                        const BvhTriangle &triangle = bvh.triangles[hit.triangle[lane]];
+                        hitNormals[lane] = glm::dot(triangle.normal, directions[lane]) > 0.0f ? -triangle.normal : triangle.normal;
+                        glm::vec3 hitPosition = origin + directions[lane] * hit.t[lane] + hitNormals[lane] * BIAS;
+                        if (glm::dot(hitNormals[lane], toSun) > 0.0f) {
+                            shadow.Set(lane, hitPosition, toSun, FAR);
+                            shadow.mask |= 1 << lane;
+                        }
+                    }
+                    int shadowed = shadow.mask ? bvh.Occluded(shadow) : 0;
+
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (p * 4 + lane >= samples)
+                            break;
+                        if (hit.triangle[lane] < 0) {
+                            indirect += sky.Radiance(directions[lane]);
+                            unoccluded++;
+                            continue;
+                        }
+                        if (hit.t[lane] > settings.aoDistance)
+                            unoccluded++;
+                        const BvhTriangle &triangle = bvh.triangles[hit.triangle[lane]];
+                        glm::vec3 light = sky.Irradiance(hitNormals[lane]);
+                        if (shadow.mask & ~shadowed & (1 << lane))
+                            light += settings.lighting.sunColor * glm::dot(hitNormals[lane], toSun);
+                        indirect += triangle.albedo * light;
+                    }
+                }
+                irradiance[index] = direct + indirect / (float) samples;
+                occlusion[index] = (float) unoccluded / samples;
+            }
+    }
+
+    // fills uncovered texels next to covered ones so bilinear filtering at chart edges doesn't pull in black
+    void dilate()
+    {
+        std::vector<bool> valid(texels.size());
+        for (size_t i = 0; i < texels.size(); i++)
+            valid[i] = texels[i].valid;
+        std::vector<bool> filled = valid;
+        int size = settings.size;
+        for (int y = 0; y < size; y++)
+            for (int x = 0; x < size; x++) {
+                size_t index = (size_t) y * size + x;
+                if (valid[index])
+                    continue;
+                glm::vec3 sum(0.0f);
+                float ao = 0.0f;
+                int count = 0;
+                for (int dy = -1; dy <= 1; dy++)
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = x + dx, ny = y + dy;
+                        if (nx < 0 || ny < 0 || nx >= size || ny >= size || !valid[(size_t) ny * size + nx])
+                            continue;
+                        sum += irradiance[(size_t) ny * size + nx];
+                        ao += occlusion[(size_t) ny * size + nx];
+                        count++;
+                    }
+                if (count == 0)
+                    continue;
+                irradiance[index] = sum / (float) count;
+                occlusion[index] = ao / count;
+                filled[index] = true;
+            }
+        for (size_t i = 0; i < texels.size(); i++)
+            texels[i].valid = filled[i];
+    }
+};
+
+int main(int argc, char **argv)
+{
+    BakeSettings settings;
+    if (!settings.lighting.ReadProgramState("resources/program_state.txt"))
+        std::cout << "no resources/program_state.txt, baking with the default sun and skybox" << std::endl;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--size" && hasValue)
+            settings.size = std::max(64, std::atoi(argv[++i]));
+        else if (argument == "--samples" && hasValue)
+            settings.samples = std::max(4, std::atoi(argv[++i]));
+        else if (argument == "--skybox" && hasValue)
+            settings.lighting.skybox = argv[++i];
+        else if (argument == "--output" && hasValue)
+            settings.output = argv[++i];
+        else if (argument == "--scaling")
+            settings.scaling = true;
+        else {
+            std::cout << "usage: " << argv[0]
+                      << " [--size N] [--samples N] [--skybox name] [--output path] [--scaling]" << std::endl;
+            return argument == "--help" ? 0 : 1;
+        }
+    }
+
+    ThreadPool pool;
+    Baker baker(settings, pool);
+    if (!baker.Load())
+        return 1;
+    baker.Layout();
+    baker.Rasterize();
+
+    if (settings.scaling) {
+        int samples = std::max(8, settings.samples / 4);
+        std::cout << "scaling with " << samples << " samples a texel:" << std::endl;
+        std::printf("%8s %12s %9s %11s\n", "threads", "ms", "speedup", "efficiency");
+        double single = 0.0;
+        for (unsigned int threads = 1;; threads *= 2) {
+            threads = std::min(threads, pool.ThreadCount());
+            double milliseconds = baker.Bake(samples, threads);
+            if (threads == 1)
+                single = milliseconds;
+            std::printf("%8u %12.1f %8.2fx %10.0f%%\n", threads, milliseconds, single / milliseconds,
+                        100.0 * single / milliseconds / threads);
+            if (threads == pool.ThreadCount())
+                break;
+        }
+    }
+
+    std::cout << "baking " << settings.size << "x" << settings.size << " with " << settings.samples
+              << " samples a texel on " << pool.ThreadCount() << " threads, skybox " << settings.lighting.skybox
+              << std::endl;
+    double milliseconds = baker.Bake(settings.samples);
+    std::cout << "baked in " << milliseconds / 1000.0 << " s" << std::endl;
+    if (!baker.Write(settings.output)) {
+        std::cout << "could not write " << settings.output << std::endl;
+        return 1;
+    }
+    std::cout << "wrote " << settings.output << std::endl;
+    return 0;
+}